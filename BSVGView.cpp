@@ -7,14 +7,262 @@
 #define NANOSVG_ALL_COLOR_KEYWORDS
 
 #include "BSVGView.h"
+#include "SVGGradientKernel.h"
+#include "SVGMaskKernel.h"
 
+#include <FindDirectory.h>
+#include <Path.h>
+#include <Window.h>
+
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <new>
 
 static const int32 kMaxGradientDimension = 1024;
 static const int32 kMaxMaskDimension = 2048;
+static const int32 kTileSize = 256;
+static const size_t kDefaultTileCacheLimit = 64 * 1024 * 1024;
+static const size_t kDefaultGradientCacheLimit = 16 * 1024 * 1024;
+static const size_t kDefaultMaskCacheLimit = 32 * 1024 * 1024;
+static const float kPreviewDownsample = 4.0f;
+static const int32 kGridCellSize = 24;
+// A multiple of two cells, so that the pattern repeats seamlessly
+static const int32 kGridPatternSize = 20 * kGridCellSize;
+static const float kDefaultDetailThreshold = 0.5f;
+static const bigtime_t kDefaultSettleInterval = 150000;
+
+static const uint32 kMsgRefineDone = 'svrd';
+static const uint32 kMsgLoadDone = 'svld';
+static const uint32 kMsgSettle = 'svse';
+
+static const size_t kLoadChunkSize = 1024 * 1024;
+
+
+// State shared between the view and a loader thread; whichever of them
+// lets go last deletes it
+struct SVGLoadJob {
+	int32					refCount;
+	int32					canceled;
+	int32					generation;
+	BString					path;
+	BString					units;
+	float					dpi;
+	BString					cacheDirectory;
+	BMessenger				view;
+	BMessenger				target;
+};
+
+
+// Arguments of a refine thread
+struct SVGRefineJob {
+	BSVGView*				view;
+	int32					generation;
+};
+
+
+static void
+release_load_job(SVGLoadJob* job)
+{
+	if (atomic_add(&job->refCount, -1) == 1)
+		delete job;
+}
+
+
+// nsvgParse() needs a C string. Instead of copying the buffer to append a
+// terminator, reuse a trailing NUL or whitespace byte; trailing whitespace
+// after the root element carries no meaning.
+static bool
+terminate_in_place(char* data, size_t length)
+{
+	if (length == 0)
+		return false;
+
+	switch (data[length - 1]) {
+		case '\0':
+			return true;
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			data[length - 1] = '\0';
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+static NSVGimage*
+parse_copy(const char* data, size_t length, const char* units, float dpi)
+{
+	char* copy = (char*)malloc(length + 1);
+	if (!copy)
+		return NULL;
+
+	memcpy(copy, data, length);
+	copy[length] = '\0';
+
+	NSVGimage* image = nsvgParse(copy, units, dpi);
+	free(copy);
+	return image;
+}
+
+
+static void
+delete_image(NSVGimage* image, SVGCachedImage* cached)
+{
+	if (cached)
+		delete cached;
+	else if (image)
+		nsvgDelete(image);
+}
+
+
+static bool
+is_painted(const SVGPaint& paint)
+{
+	if (paint.type == NSVG_PAINT_NONE)
+		return false;
+	return paint.type != NSVG_PAINT_COLOR || (paint.color >> 24) != 0;
+}
+
+
+// Whether the path in the rasterizer covers any pixel of its clip box
+static bool
+has_coverage(agg::rasterizer_scanline_aa<>& ras, agg::scanline_p8& sl)
+{
+	if (!ras.rewind_scanlines())
+		return false;
+	sl.reset(ras.min_x(), ras.max_x());
+	return ras.sweep_scanline(sl);
+}
+
+
+// Copies source to x, y in destination, clipped to the destination. Both
+// bitmaps are B_RGBA32.
+static void
+copy_bitmap(BBitmap* destination, BBitmap* source, int32 x, int32 y)
+{
+	int32 left = x > 0 ? x : 0;
+	int32 top = y > 0 ? y : 0;
+	int32 right = x + source->Bounds().IntegerWidth() + 1;
+	int32 bottom = y + source->Bounds().IntegerHeight() + 1;
+	if (right > destination->Bounds().IntegerWidth() + 1)
+		right = destination->Bounds().IntegerWidth() + 1;
+	if (bottom > destination->Bounds().IntegerHeight() + 1)
+		bottom = destination->Bounds().IntegerHeight() + 1;
+	if (left >= right || top >= bottom)
+		return;
+
+	uint8* dst = (uint8*)destination->Bits();
+	const uint8* src = (const uint8*)source->Bits();
+	int32 dstBpr = destination->BytesPerRow();
+	int32 srcBpr = source->BytesPerRow();
+	for (int32 row = top; row < bottom; row++) {
+		memcpy(dst + row * dstBpr + left * 4,
+			src + (row - y) * srcBpr + (left - x) * 4, (right - left) * 4);
+	}
+}
+
+
+// Parses a file that has been read into data, or restores it from the
+// document cache if the cached entry still matches the file. The data
+// must not be modified yet; terminated tells whether data[length] is NUL.
+static NSVGimage*
+parse_document(const SVGDocumentCache& cache, const char* filename,
+	const struct stat& st, char* data, size_t length, bool terminated,
+	const char* units, float dpi, SVGCachedImage** cached)
+{
+	*cached = NULL;
+
+	char resolved[PATH_MAX];
+	SVGCacheKey key;
+	if (cache.IsEnabled()) {
+		const char* path = realpath(filename, resolved) ? resolved : filename;
+		SVGDocumentCache::MakeKey(key, path, st.st_size, st.st_mtime, data,
+			length, units, dpi);
+		*cached = cache.Lookup(key);
+		if (*cached)
+			return (*cached)->Image();
+	}
+
+	NSVGimage* image;
+	if (terminated || terminate_in_place(data, length))
+		image = nsvgParse(data, units, dpi);
+	else
+		image = parse_copy(data, length, units, dpi);
+
+	if (image && cache.IsEnabled())
+		cache.Store(key, image);
+
+	return image;
+}
+
+
+static NSVGimage*
+parse_mapped_file(const SVGDocumentCache& cache, const char* filename,
+	const char* units, float dpi, SVGCachedImage** cached)
+{
+	*cached = NULL;
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	// A private mapping keeps the NULs the parser writes out of the file
+	size_t length = st.st_size;
+	void* address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		fd, 0);
+	close(fd);
+
+	if (address == MAP_FAILED)
+		return nsvgParseFromFile(filename, units, dpi);
+
+	// The rest of the last page is zero filled, which terminates the
+	// string unless the file ends exactly on a page boundary
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	NSVGimage* image = parse_document(cache, filename, st, (char*)address,
+		length, length % pageSize != 0, units, dpi, cached);
+
+	munmap(address, length);
+	return image;
+}
+
+
+// Converts the color table to B_RGBA32 pixels for the gradient kernels
+static void
+pack_gradient_lut(const GradientLUT& lut, uint8* pixels)
+{
+	for (int32 i = 0; i < 256; i++, pixels += 4) {
+		pixels[0] = lut.colors[i].blue;
+		pixels[1] = lut.colors[i].green;
+		pixels[2] = lut.colors[i].red;
+		pixels[3] = lut.colors[i].alpha;
+	}
+}
+
+
+// Bytes of a B_RGBA32 bitmap area that is sent to the app_server
+static inline uint64
+upload_size(BRect source)
+{
+	return (uint64)(source.IntegerWidth() + 1) * (source.IntegerHeight() + 1)
+		* 4;
+}
 
 
 BSVGView::BSVGView(BRect frame, const char* name, uint32 resizeMask, uint32 flags)
@@ -35,7 +283,13 @@ BSVGView::BSVGView(const char* name)
 
 BSVGView::~BSVGView()
 {
+	CancelLoad();
 	Unload();
+	delete[] fTiles;
+	delete[] fMaskedShapes;
+	delete fTileRenderBitmap;
+	delete fRenderBitmap;
+	delete fGridBitmap;
 }
 
 
@@ -45,19 +299,16 @@ BSVGView::LoadFromFile(const char* filename, const char* units, float dpi)
 	if (!filename)
 		return B_BAD_VALUE;
 
+	CancelLoad();
 	Unload();
 
-	fSVGImage = nsvgParseFromFile(filename, units, dpi);
-	if (!fSVGImage)
+	SVGCachedImage* cached;
+	NSVGimage* image = parse_mapped_file(fDocumentCache, filename, units, dpi,
+		&cached);
+	if (!image)
 		return B_ERROR;
 
-	fLoadedFile = filename;
-
-	if (fAutoScale)
-		_CalculateAutoScale();
-
-	Invalidate();
-	return B_OK;
+	return _SetImage(image, filename, cached);
 }
 
 
@@ -67,37 +318,149 @@ BSVGView::LoadFromMemory(const char* data, const char* units, float dpi)
 	if (!data)
 		return B_BAD_VALUE;
 
+	CancelLoad();
 	Unload();
 
 	char* dataCopy = strdup(data);
 	if (!dataCopy)
 		return B_NO_MEMORY;
 
-	fSVGImage = nsvgParse(dataCopy, units, dpi);
+	NSVGimage* image = nsvgParse(dataCopy, units, dpi);
 	free(dataCopy);
 
-	if (!fSVGImage)
+	if (!image)
 		return B_ERROR;
 
-	fLoadedFile.SetTo("");
+	return _SetImage(image, "");
+}
 
-	if (fAutoScale)
-		_CalculateAutoScale();
 
-	Invalidate();
+status_t
+BSVGView::LoadFromMemory(char* data, size_t length, bool adopt,
+	const char* units, float dpi)
+{
+	if (!data)
+		return B_BAD_VALUE;
+
+	CancelLoad();
+	Unload();
+
+	NSVGimage* image = NULL;
+	if (terminate_in_place(data, length))
+		image = nsvgParse(data, units, dpi);
+	else if (adopt) {
+		// Growing an owned buffer by one byte rarely needs to move it
+		char* grown = (char*)realloc(data, length + 1);
+		if (!grown) {
+			free(data);
+			return B_NO_MEMORY;
+		}
+		data = grown;
+		data[length] = '\0';
+		image = nsvgParse(data, units, dpi);
+	} else
+		image = parse_copy(data, length, units, dpi);
+
+	if (adopt)
+		free(data);
+
+	if (!image)
+		return B_ERROR;
+
+	return _SetImage(image, "");
+}
+
+
+status_t
+BSVGView::LoadFromFileAsync(const char* filename, BMessenger target,
+	const char* units, float dpi)
+{
+	if (!filename)
+		return B_BAD_VALUE;
+
+	CancelLoad();
+
+	SVGLoadJob* job = new(std::nothrow) SVGLoadJob;
+	if (!job)
+		return B_NO_MEMORY;
+
+	job->refCount = 2;
+	job->canceled = 0;
+	job->generation = ++fLoadGeneration;
+	job->path = filename;
+	job->units = units;
+	job->dpi = dpi;
+	job->cacheDirectory = fDocumentCache.Directory();
+	job->view = BMessenger(this);
+	job->target = target;
+	if (!job->target.IsValid() && Window())
+		job->target = BMessenger(Window());
+
+	// A canceled loader may still be stuck in nanosvg. Rather than piling
+	// up parser threads, the job waits until that one has exited.
+	if (fLoadThread < 0) {
+		status_t status = _StartLoadThread(job);
+		if (status != B_OK) {
+			delete job;
+			return status;
+		}
+	}
+
+	fLoadJob = job;
 	return B_OK;
 }
 
 
+void
+BSVGView::CancelLoad()
+{
+	if (!fLoadJob)
+		return;
+
+	if (fLoadThread < 0 || fLoadThreadGeneration != fLoadJob->generation) {
+		// Still queued, no thread has seen it
+		delete fLoadJob;
+	} else {
+		// The thread cannot interrupt nanosvg, so it is not waited for; it
+		// drops its result when it sees the flag
+		atomic_set(&fLoadJob->canceled, 1);
+		release_load_job(fLoadJob);
+	}
+	fLoadJob = NULL;
+	fLoadGeneration++;
+}
+
+
 void
 BSVGView::Unload()
 {
+	// While the geometry is still there to tell the highlighted area
+	ClearHighlight();
+
+	_EndInteraction();
+	_StopRefinement();
+	delete fPreviewBitmap;
+	fPreviewBitmap = NULL;
+	delete fRefineBitmap;
+	fRefineBitmap = NULL;
+
 	if (fSVGImage) {
-		nsvgDelete(fSVGImage);
+		delete_image(fSVGImage, fCachedImage);
 		fSVGImage = NULL;
+		fCachedImage = NULL;
 	}
+	_FreeDisplayList();
+	fRenderer.SetGeometry(NULL);
+	fRefineRenderer.SetGeometry(NULL);
+	fPolylineCache.SetGeometry(NULL);
+	fSpatialIndex.Unset();
+	fGeometry.Unset();
+	fGradientCache.Clear();
+	_FlushMaskCache();
+	fScratchPool.Flush();
+	delete[] fVisibleItems;
+	fVisibleItems = NULL;
 	fLoadedFile.SetTo("");
-	ClearHighlight();
 }
 
 
@@ -107,27 +470,61 @@ BSVGView::Draw(BRect updateRect)
 	if (!fSVGImage)
 		return;
 
+	bigtime_t frameStart = system_time();
+	memset(&fRenderStats, 0, sizeof(fRenderStats));
+	fPolylineCache.NextFrame();
+	SVGScratchStats scratchStats;
+	fScratchPool.GetStats(scratchStats);
+
 	PushState();
 
 	BRegion region(Bounds());
 	ConstrainClippingRegion(&region);
 
+	bigtime_t start = system_time();
 	if (fShowTransparency)
-		_DrawTransparencyGrid();
+		_DrawTransparencyGrid(updateRect);
+	fRenderStats.transparencyTime = system_time() - start;
 
+	start = system_time();
 	if (fBoundingBoxStyle != SVG_BBOX_NONE)
 		_DrawBoundingBox();
+	fRenderStats.boundingBoxTime = system_time() - start;
+
+	start = system_time();
+	if (fSnapshotBitmap == NULL && fDisplayListScale != fScale)
+		_BuildDisplayList();
+
+	if (fSnapshotBitmap) {
+		_DrawSnapshot(updateRect);
+	} else if (fProgressive) {
+		_DrawProgressive(updateRect);
+	} else if (fTileCacheEnabled) {
+		_DrawTiles(updateRect);
+	} else if (fRenderMode == SVG_RENDER_AGG) {
+		_DrawSoftware(updateRect);
+	} else {
+		SetDrawingMode(B_OP_ALPHA);
 
-	SetDrawingMode(B_OP_ALPHA);
-
-	int32 shapeIndex = 0;
-	for (NSVGshape* shape = fSVGImage->shapes; shape != NULL; shape = shape->next) {
-		if (shape->flags & NSVG_FLAGS_VISIBLE)
-			_DrawShape(shape, shapeIndex);
-		shapeIndex++;
+		BRect clipRect = updateRect & Bounds();
+		int32 count = _QueryDisplayItems(clipRect);
+		for (int32 i = 0; i < count; i++)
+			_DrawDisplayItem(this, fDisplayList[fVisibleItems[i]], clipRect);
 	}
+	fRenderStats.shapeTime = system_time() - start;
 
-	_DrawHighlight();
+	start = system_time();
+	_DrawHighlight(updateRect);
+	fRenderStats.highlightTime = system_time() - start;
+
+	SVGScratchStats scratchAfter;
+	fScratchPool.GetStats(scratchAfter);
+	fRenderStats.bitmapsAllocated += scratchAfter.bitmapsAllocated
+		- scratchStats.bitmapsAllocated;
+	fRenderStats.frameTime = system_time() - frameStart;
+
+	if (fShowRenderStats)
+		_DrawRenderStats();
 
 	PopState();
 }
@@ -145,16 +542,97 @@ void
 BSVGView::FrameResized(float newWidth, float newHeight)
 {
 	if (fAutoScale && fSVGImage) {
+		if (fInteractiveScaling)
+			_BeginInteraction();
 		_CalculateAutoScale();
 		Invalidate();
 	}
 }
 
 
+void
+BSVGView::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case kMsgRefineDone:
+		{
+			int32 generation;
+			if (message->FindInt32("generation", &generation) != B_OK
+				|| generation != fRefineGeneration || fRefineThread < 0)
+				break;
+
+			_FinishRefinement();
+			Invalidate();
+			break;
+		}
+
+		case kMsgSettle:
+		{
+			int32 generation;
+			if (message->FindInt32("generation", &generation) != B_OK
+				|| generation != fSettleGeneration || !fSnapshotBitmap)
+				break;
+
+			_EndInteraction();
+			Invalidate();
+			break;
+		}
+
+		case kMsgLoadDone:
+		{
+			int32 generation;
+			NSVGimage* image = NULL;
+			SVGCachedImage* cached = NULL;
+			if (message->FindInt32("generation", &generation) != B_OK
+				|| message->FindPointer("image", (void**)&image) != B_OK
+				|| message->FindPointer("cached", (void**)&cached) != B_OK)
+				break;
+
+			if (fLoadThread >= 0 && generation == fLoadThreadGeneration)
+				_LoadThreadExited();
+
+			if (generation != fLoadGeneration || !fLoadJob) {
+				// Canceled after the thread had already posted its result
+				delete_image(image, cached);
+				break;
+			}
+
+			BMessenger target = fLoadJob->target;
+			release_load_job(fLoadJob);
+			fLoadJob = NULL;
+
+			int32 status = B_ERROR;
+			const char* path = "";
+			message->FindInt32("status", &status);
+			message->FindString("path", &path);
+
+			if (image) {
+				Unload();
+				status_t error = _SetImage(image, path, cached);
+				if (error != B_OK)
+					status = error;
+			}
+
+			BMessage completed(SVG_MSG_LOAD_COMPLETED);
+			completed.AddInt32("status", status);
+			completed.AddString("path", path);
+			target.SendMessage(&completed);
+			break;
+		}
+
+		default:
+			BView::MessageReceived(message);
+			break;
+	}
+}
+
+
 void
 BSVGView::SetScale(float scale)
 {
 	if (scale > 0.0f && scale != fScale) {
+		if (fInteractiveScaling && fSVGImage)
+			_BeginInteraction();
 		fScale = scale;
 		Invalidate();
 	}
@@ -227,290 +705,808 @@ BSVGView::SetDisplayMode(svg_display_mode mode)
 {
 	if (fDisplayMode != mode) {
 		fDisplayMode = mode;
+		fRenderer.SetDisplayMode(mode);
 		Invalidate();
 	}
 }
 
 
 void
-BSVGView::SetShowTransparency(bool show)
+BSVGView::SetRenderMode(svg_render_mode mode)
 {
-	if (fShowTransparency != show) {
-		fShowTransparency = show;
+	if (fRenderMode != mode) {
+		fRenderMode = mode;
+		if (mode != SVG_RENDER_AGG) {
+			delete fRenderBitmap;
+			fRenderBitmap = NULL;
+		}
 		Invalidate();
 	}
 }
 
 
 void
-BSVGView::SetBoundingBoxStyle(svg_boundingbox_style style)
+BSVGView::SetRenderThreadCount(int32 count)
+{
+	// The output does not depend on the thread count, so neither the tile
+	// cache nor the current frame needs to be redrawn
+	fRenderer.SetThreadCount(count);
+
+	// A refinement in progress is stopped first and started over, without
+	// its bitmap the next Draw() does that
+	if (fRefineThread >= 0) {
+		_StopRefinement();
+		delete fRefineBitmap;
+		fRefineBitmap = NULL;
+		Invalidate();
+	}
+	fRefineRenderer.SetThreadCount(count);
+}
+
+
+void
+BSVGView::SetInteractiveScaling(bool enable)
 {
-	if (fBoundingBoxStyle != style) {
-		fBoundingBoxStyle = style;
+	if (fInteractiveScaling == enable)
+		return;
+
+	fInteractiveScaling = enable;
+	if (!enable && fSnapshotBitmap) {
+		_EndInteraction();
 		Invalidate();
 	}
 }
 
 
 void
-BSVGView::SetHighlightedShape(int32 shapeIndex)
+BSVGView::SetSettleInterval(bigtime_t interval)
 {
-	fHighlightInfo.mode = SVG_HIGHLIGHT_SHAPE;
-	fHighlightInfo.shapeIndex = shapeIndex;
-	fHighlightInfo.pathIndex = -1;
-	fHighlightInfo.showControlPoints = false;
-	fHighlightInfo.showBezierHandles = false;
-	Invalidate();
+	fSettleInterval = interval > 0 ? interval : 0;
 }
 
 
 void
-BSVGView::SetHighlightedPath(int32 shapeIndex, int32 pathIndex)
+BSVGView::SetProgressiveRendering(bool enable)
 {
-	fHighlightInfo.mode = SVG_HIGHLIGHT_PATH;
-	fHighlightInfo.shapeIndex = shapeIndex;
-	fHighlightInfo.pathIndex = pathIndex;
-	fHighlightInfo.showControlPoints = true;
-	fHighlightInfo.showBezierHandles = false;
+	if (fProgressive == enable)
+		return;
+
+	fProgressive = enable;
+	if (!enable) {
+		_StopRefinement();
+		delete fPreviewBitmap;
+		fPreviewBitmap = NULL;
+		delete fRefineBitmap;
+		fRefineBitmap = NULL;
+	}
 	Invalidate();
 }
 
 
 void
-BSVGView::SetHighlightControlPoints(int32 shapeIndex, int32 pathIndex,
-	bool showBezierHandles)
+BSVGView::SetDocumentCacheEnabled(bool enable)
 {
-	fHighlightInfo.mode = SVG_HIGHLIGHT_CONTROL_POINTS;
-	fHighlightInfo.shapeIndex = shapeIndex;
-	fHighlightInfo.pathIndex = pathIndex;
-	fHighlightInfo.showControlPoints = true;
-	fHighlightInfo.showBezierHandles = showBezierHandles;
-	Invalidate();
+	BPath path;
+	if (enable && find_directory(B_USER_CACHE_DIRECTORY, &path) == B_OK
+		&& path.Append("SVGView") == B_OK)
+		fDocumentCache.SetDirectory(path.Path());
+	else
+		fDocumentCache.SetDirectory(NULL);
 }
 
 
 void
-BSVGView::ClearHighlight()
+BSVGView::SetDetailThreshold(float pixels)
 {
-	if (fHighlightInfo.mode == SVG_HIGHLIGHT_NONE)
+	if (pixels < 0.0f)
+		pixels = 0.0f;
+	if (fDetailThreshold == pixels)
 		return;
 
-	fHighlightInfo.mode = SVG_HIGHLIGHT_NONE;
-	fHighlightInfo.shapeIndex = -1;
-	fHighlightInfo.pathIndex = -1;
-	fHighlightInfo.showControlPoints = false;
-	fHighlightInfo.showBezierHandles = false;
+	// Without the refined bitmap the next Draw() starts over
+	_StopRefinement();
+	delete fRefineBitmap;
+	fRefineBitmap = NULL;
+	fDetailThreshold = pixels;
+	fRenderer.SetDetailThreshold(pixels);
+
+	// The display list decides which shapes are dots when it is compiled;
+	// freeing it also drops the tiles
+	_FreeDisplayList();
 	Invalidate();
 }
 
 
-BRect
-BSVGView::SVGBounds() const
+void
+BSVGView::SetShowTransparency(bool show)
 {
-	if (!fSVGImage)
-		return BRect();
-	return BRect(0, 0, fSVGImage->width - 1, fSVGImage->height - 1);
+	if (fShowTransparency != show) {
+		fShowTransparency = show;
+		Invalidate();
+	}
 }
 
 
-BRect
-BSVGView::SVGViewBounds() const
+void
+BSVGView::GetRenderStats(SVGRenderStats& stats) const
 {
-	if (!fSVGImage)
-		return BRect();
-
-	float scaledWidth = fSVGImage->width * fScale;
-	float scaledHeight = fSVGImage->height * fScale;
-
-	return BRect(fOffsetX, fOffsetY,
-		fOffsetX + scaledWidth - 1,
-		fOffsetY + scaledHeight - 1);
+	stats = fRenderStats;
 }
 
 
 void
-BSVGView::_InitDefaults()
+BSVGView::SetShowRenderStats(bool show)
 {
-	fSVGImage = NULL;
-	fScale = 1.0f;
-	fOffsetX = 0.0f;
-	fOffsetY = 0.0f;
-	fAutoScale = true;
-	fDisplayMode = SVG_DISPLAY_NORMAL;
-	fShowTransparency = true;
-	fBoundingBoxStyle = SVG_BBOX_NONE;
+	if (fShowRenderStats != show) {
+		fShowRenderStats = show;
+		Invalidate();
+	}
 }
 
 
 void
-BSVGView::_BuildGradientLUT(NSVGgradient* gradient, float opacity, GradientLUT& lut)
+BSVGView::SetBoundingBoxStyle(svg_boundingbox_style style)
 {
-	if (!gradient || gradient->nstops == 0) {
-		memset(&lut, 0, sizeof(GradientLUT));
-		return;
+	if (fBoundingBoxStyle != style) {
+		fBoundingBoxStyle = style;
+		Invalidate();
 	}
+}
 
-	for (int i = 0; i < 256; i++) {
-		float t = i / 255.0f;
-		lut.colors[i] = _InterpolateGradientColor(gradient, t, opacity);
+
+void
+BSVGView::SetTileCacheEnabled(bool enable)
+{
+	if (fTileCacheEnabled != enable) {
+		fTileCacheEnabled = enable;
+		if (!enable)
+			_FlushTileCache();
+		Invalidate();
 	}
 }
 
 
 void
-BSVGView::_ApplyGradientToBuffer(uint8* bits, int width, int height, int32 bpr,
-	NSVGgradient* gradient, char gradientType, BRect renderBounds, float opacity)
+BSVGView::SetTileCacheLimit(size_t bytes)
 {
-	if (!bits || !gradient)
-		return;
-
-	GradientLUT lut;
-	_BuildGradientLUT(gradient, opacity, lut);
+	fTileCacheLimit = bytes;
+	_ValidateTileCache();
+}
 
-	float* m = gradient->xform;
-	float invScale = 1.0f / fScale;
 
-	for (int py = 0; py < height; py++) {
-		uint8* row = bits + py * bpr;
-		for (int px = 0; px < width; px++) {
-			uint8 alpha = row[px * 4 + 3];
-			if (alpha == 0)
-				continue;
+void
+BSVGView::SetGradientCacheLimit(size_t bytes)
+{
+	fGradientCache.SetLimit(bytes);
+}
 
-			float viewX = renderBounds.left + px;
-			float viewY = renderBounds.top + py;
-			float svgX = (viewX - fOffsetX) * invScale;
-			float svgY = (viewY - fOffsetY) * invScale;
 
-			float gx = m[0] * svgX + m[2] * svgY + m[4];
-			float gy = m[1] * svgX + m[3] * svgY + m[5];
+void
+BSVGView::SetMaskCacheLimit(size_t bytes)
+{
+	fMaskCacheLimit = bytes;
+	_MakeMaskCacheRoom(0);
+}
 
-			float t;
-			if (gradientType == NSVG_PAINT_LINEAR_GRADIENT) {
-				t = gy;
-			} else {
-				t = sqrtf(gx * gx + gy * gy);
-			}
 
-			t = _ApplySpreadMode(gradient->spread, t);
+void
+BSVGView::SetPolylineCacheLimit(size_t bytes)
+{
+	// The refinement thread uses the cache of its renderer
+	_StopRefinement();
+	delete fRefineBitmap;
+	fRefineBitmap = NULL;
 
-			int idx = (int)(t * 255.0f + 0.5f);
-			if (idx < 0) idx = 0;
-			if (idx > 255) idx = 255;
+	fPolylineCache.SetLimit(bytes);
+	fRenderer.SetPolylineCacheLimit(bytes);
+	fRefineRenderer.SetPolylineCacheLimit(bytes);
+	Invalidate();
+}
 
-			rgb_color c = lut.colors[idx];
 
-			row[px * 4 + 0] = c.blue;
-			row[px * 4 + 1] = c.green;
-			row[px * 4 + 2] = c.red;
-			row[px * 4 + 3] = (uint8)(((uint16)c.alpha * alpha) / 255);
-		}
+void
+BSVGView::GetScratchStats(SVGScratchStats& stats) const
+{
+	fScratchPool.GetStats(stats);
+}
+
+
+void
+BSVGView::SetHighlightedShape(int32 shapeIndex)
+{
+	HighlightInfo info;
+	info.mode = SVG_HIGHLIGHT_SHAPE;
+	info.shapeIndex = shapeIndex;
+	_SetHighlight(info);
+}
+
+
+void
+BSVGView::SetHighlightedPath(int32 shapeIndex, int32 pathIndex)
+{
+	HighlightInfo info;
+	info.mode = SVG_HIGHLIGHT_PATH;
+	info.shapeIndex = shapeIndex;
+	info.pathIndex = pathIndex;
+	info.showControlPoints = true;
+	_SetHighlight(info);
+}
+
+
+void
+BSVGView::SetHighlightControlPoints(int32 shapeIndex, int32 pathIndex,
+	bool showBezierHandles)
+{
+	HighlightInfo info;
+	info.mode = SVG_HIGHLIGHT_CONTROL_POINTS;
+	info.shapeIndex = shapeIndex;
+	info.pathIndex = pathIndex;
+	info.showControlPoints = true;
+	info.showBezierHandles = showBezierHandles;
+	_SetHighlight(info);
+}
+
+
+void
+BSVGView::ClearHighlight()
+{
+	if (fHighlightInfo.mode == SVG_HIGHLIGHT_NONE)
+		return;
+
+	_SetHighlight(HighlightInfo());
+}
+
+
+BRect
+BSVGView::SVGBounds() const
+{
+	if (!fSVGImage)
+		return BRect();
+	return BRect(0, 0, fSVGImage->width - 1, fSVGImage->height - 1);
+}
+
+
+BRect
+BSVGView::SVGViewBounds() const
+{
+	if (!fSVGImage)
+		return BRect();
+
+	float scaledWidth = fSVGImage->width * fScale;
+	float scaledHeight = fSVGImage->height * fScale;
+
+	return BRect(fOffsetX, fOffsetY,
+		fOffsetX + scaledWidth - 1,
+		fOffsetY + scaledHeight - 1);
+}
+
+
+NSVGshape*
+BSVGView::ShapeAt(int32 shapeIndex) const
+{
+	if (shapeIndex < 0 || shapeIndex >= fGeometry.CountShapes())
+		return NULL;
+	return fGeometry.ShapeAt(shapeIndex);
+}
+
+
+int32
+BSVGView::CountPaths(int32 shapeIndex) const
+{
+	if (shapeIndex < 0 || shapeIndex >= fGeometry.CountShapes())
+		return 0;
+	return fGeometry.ShapePathCount(shapeIndex);
+}
+
+
+int32
+BSVGView::ShapeAtPoint(BPoint where)
+{
+	int32 shapeIndex;
+	if (ShapesInRect(BRect(where, where), &shapeIndex, 1) == 0)
+		return -1;
+	return shapeIndex;
+}
+
+
+int32
+BSVGView::ShapesInRect(BRect rect, int32* shapes, int32 maxCount)
+{
+	if (!fSVGImage || !fVisibleItems || !shapes || maxCount <= 0
+		|| !rect.IsValid())
+		return 0;
+
+	float invScale = 1.0f / fScale;
+	int32 count = fSpatialIndex.Query(
+		(rect.left - 1.0f - fOffsetX) * invScale,
+		(rect.top - 1.0f - fOffsetY) * invScale,
+		(rect.right + 1.0f - fOffsetX) * invScale,
+		(rect.bottom + 1.0f - fOffsetY) * invScale,
+		fVisibleItems);
+
+	BRect pixels(floorf(rect.left), floorf(rect.top), floorf(rect.right),
+		floorf(rect.bottom));
+
+	// The candidates are in painting order, the top-most shape comes last
+	const int32* visibleShapes = fGeometry.VisibleShapes();
+	int32 found = 0;
+	for (int32 i = count - 1; i >= 0 && found < maxCount; i--) {
+		int32 shapeIndex = visibleShapes[fVisibleItems[i]];
+		if (_HitTestShape(shapeIndex, pixels))
+			shapes[found++] = shapeIndex;
 	}
+	return found;
 }
 
 
-float
-BSVGView::_ApplySpreadMode(int spread, float t)
-{
-	switch (spread) {
-		case NSVG_SPREAD_PAD:
-			if (t < 0.0f)
-				return 0.0f;
-			if (t > 1.0f)
-				return 1.0f;
-			return t;
-
-		case NSVG_SPREAD_REPEAT:
-			t = t - floorf(t);
-			if (t < 0.0f)
-				t += 1.0f;
-			return t;
-
-		case NSVG_SPREAD_REFLECT:
-		{
-			t = fabsf(t);
-			int period = (int)floorf(t);
-			t = t - period;
-			if (period % 2 != 0)
-				t = 1.0f - t;
-			return t;
-		}
+void
+BSVGView::_InitDefaults()
+{
+	fSVGImage = NULL;
+	fScale = 1.0f;
+	fOffsetX = 0.0f;
+	fOffsetY = 0.0f;
+	fAutoScale = true;
+	fDisplayMode = SVG_DISPLAY_NORMAL;
+	fShowTransparency = true;
+	fGridBitmap = NULL;
+	fShowRenderStats = false;
+	memset(&fRenderStats, 0, sizeof(fRenderStats));
+	fRenderStatsFrame = BRect();
+	fBoundingBoxStyle = SVG_BBOX_NONE;
+	fDisplayList = NULL;
+	fDisplayListCount = 0;
+	fDisplayListScale = 0.0f;
+	fDisplayListBounds = BRect();
+	fVisibleItems = NULL;
+	fTileCacheEnabled = true;
+	fTileCacheLimit = kDefaultTileCacheLimit;
+	fGradientCache.SetLimit(kDefaultGradientCacheLimit);
+	fMaskCacheLimit = kDefaultMaskCacheLimit;
+	fMaskCacheSize = 0;
+	fMaskedShapes = NULL;
+	fMaskedShapeCount = 0;
+	fMaskedShapeCapacity = 0;
+	fMaskCacheClock = 0;
+	fTiles = NULL;
+	fTileCount = 0;
+	fTileCapacity = 0;
+	fTileFrame = 0;
+	fTileScale = 0.0f;
+	fTilePhaseX = 0.0f;
+	fTilePhaseY = 0.0f;
+	fTileDisplayMode = SVG_DISPLAY_NORMAL;
+	fTileRenderMode = SVG_RENDER_NATIVE;
+	fTileRenderBitmap = NULL;
+	fTileRenderView = NULL;
+	fDetailThreshold = kDefaultDetailThreshold;
+	fRenderMode = SVG_RENDER_NATIVE;
+	fRenderBitmap = NULL;
+	fRenderer.SetDisplayMode(fDisplayMode);
+	fRenderer.SetDetailThreshold(fDetailThreshold);
+	fProgressive = false;
+	fPreviewBitmap = NULL;
+	fRefineBitmap = NULL;
+	fRefineThread = -1;
+	fRefineGeneration = 0;
+	fRefineCompleted = 0;
+	fRefineDone = false;
+	fRefineScale = 0.0f;
+	fRefineOffsetX = 0.0f;
+	fRefineOffsetY = 0.0f;
+	fRefineDisplayMode = SVG_DISPLAY_NORMAL;
+	fInteractiveScaling = false;
+	fSettleInterval = kDefaultSettleInterval;
+	fSettleRunner = NULL;
+	fSettleGeneration = 0;
+	fSnapshotBitmap = NULL;
+	fSnapshotScale = 1.0f;
+	fSnapshotOffsetX = 0.0f;
+	fSnapshotOffsetY = 0.0f;
+	fLoadJob = NULL;
+	fLoadGeneration = 0;
+	fLoadThread = -1;
+	fLoadThreadGeneration = 0;
+	fCachedImage = NULL;
+	SetDocumentCacheEnabled(true);
+}
+
+
+// Takes ownership of the image, which is deleted again if the view cannot
+// set up the structures to draw it
+status_t
+BSVGView::_SetImage(NSVGimage* image, const char* filename,
+	SVGCachedImage* cached)
+{
+	fSVGImage = image;
+	fCachedImage = cached;
+	fLoadedFile = filename;
 
-		default:
-			if (t < 0.0f)
-				return 0.0f;
-			if (t > 1.0f)
-				return 1.0f;
-			return t;
+	if (fAutoScale)
+		_CalculateAutoScale();
+
+	status_t status = fGeometry.SetTo(fSVGImage);
+	if (status == B_OK) {
+		fPolylineCache.SetGeometry(&fGeometry);
+		status = _BuildSpatialIndex();
+	}
+	if (status != B_OK) {
+		Unload();
+		Invalidate();
+		return status;
 	}
+
+	_BuildDisplayList();
+	fRenderer.SetGeometry(&fGeometry, &fSpatialIndex);
+	fRefineRenderer.SetGeometry(&fGeometry, &fSpatialIndex);
+
+	Invalidate();
+	return B_OK;
+}
+
+
+status_t
+BSVGView::_StartLoadThread(SVGLoadJob* job)
+{
+	thread_id thread = spawn_thread(_LoadThread, "svg loader",
+		B_NORMAL_PRIORITY, job);
+	if (thread < 0 || resume_thread(thread) != B_OK) {
+		if (thread >= 0)
+			kill_thread(thread);
+		return thread < 0 ? thread : B_ERROR;
+	}
+
+	fLoadThread = thread;
+	fLoadThreadGeneration = job->generation;
+	return B_OK;
 }
 
 
+// Called once the loader has posted its last message, so joining it only
+// waits for it to return. Starts the job that was queued behind it, if any.
 void
-BSVGView::_BuildAGGPath(NSVGshape* shape, agg::path_storage& aggPath)
+BSVGView::_LoadThreadExited()
 {
-	_BuildAGGPathWithOffset(shape, aggPath, fOffsetX, fOffsetY);
+	status_t exitValue;
+	wait_for_thread(fLoadThread, &exitValue);
+	fLoadThread = -1;
+
+	if (!fLoadJob || fLoadJob->generation == fLoadThreadGeneration)
+		return;
+
+	SVGLoadJob* job = fLoadJob;
+	status_t status = _StartLoadThread(job);
+	if (status == B_OK)
+		return;
+
+	BMessage completed(SVG_MSG_LOAD_COMPLETED);
+	completed.AddInt32("status", status);
+	completed.AddString("path", job->path.String());
+	job->target.SendMessage(&completed);
+	delete job;
+	fLoadJob = NULL;
+}
+
+
+status_t
+BSVGView::_LoadThread(void* data)
+{
+	SVGLoadJob* job = (SVGLoadJob*)data;
+	NSVGimage* image = NULL;
+	SVGCachedImage* cached = NULL;
+	status_t status = B_OK;
+
+	SVGDocumentCache cache;
+	cache.SetDirectory(job->cacheDirectory.String());
+
+	// Map the file and fault it in chunk by chunk, which is the only part
+	// that can report progress and be canceled midway
+	char* buffer = NULL;
+	bool mapped = false;
+	int64 total = 0;
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+
+	struct stat st;
+	int fd = open(job->path.String(), O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0)
+		status = B_ENTRY_NOT_FOUND;
+	else {
+		total = st.st_size;
+		void* address = total > 0 ? mmap(NULL, total, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		if (address != MAP_FAILED) {
+			buffer = (char*)address;
+			mapped = true;
+		} else if ((buffer = (char*)malloc(total + 1)) == NULL)
+			status = B_NO_MEMORY;
+	}
+
+	int64 bytesRead = 0;
+	while (status == B_OK && bytesRead < total) {
+		if (atomic_get(&job->canceled) != 0) {
+			status = B_CANCELED;
+			break;
+		}
+
+		size_t chunk = (size_t)(total - bytesRead) < kLoadChunkSize
+			? (size_t)(total - bytesRead) : kLoadChunkSize;
+		if (mapped) {
+			for (size_t offset = 0; offset < chunk; offset += pageSize)
+				(void)((volatile char*)buffer)[bytesRead + offset];
+		} else if (pread(fd, buffer + bytesRead, chunk, bytesRead)
+				!= (ssize_t)chunk) {
+			status = B_IO_ERROR;
+			break;
+		}
+		bytesRead += chunk;
+
+		BMessage progress(SVG_MSG_LOAD_PROGRESS);
+		progress.AddString("path", job->path.String());
+		progress.AddInt32("stage", SVG_LOAD_STAGE_READING);
+		progress.AddInt64("bytes", bytesRead);
+		progress.AddInt64("total", total);
+		job->target.SendMessage(&progress, (BHandler*)NULL, 0);
+	}
+
+	if (fd >= 0)
+		close(fd);
+
+	if (status == B_OK && atomic_get(&job->canceled) == 0) {
+		BMessage progress(SVG_MSG_LOAD_PROGRESS);
+		progress.AddString("path", job->path.String());
+		progress.AddInt32("stage", SVG_LOAD_STAGE_PARSING);
+		progress.AddInt64("bytes", total);
+		progress.AddInt64("total", total);
+		job->target.SendMessage(&progress, (BHandler*)NULL, 0);
+
+		if (!mapped)
+			buffer[total] = '\0';
+		image = parse_document(cache, job->path.String(), st, buffer, total,
+			!mapped || total % pageSize != 0, job->units.String(), job->dpi,
+			&cached);
+
+		if (!image)
+			status = B_BAD_DATA;
+	}
+
+	if (mapped)
+		munmap(buffer, total);
+	else
+		free(buffer);
+
+	if (atomic_get(&job->canceled) != 0)
+		status = B_CANCELED;
+
+	// Posted even when canceled, as it tells the view that the thread is
+	// gone and a queued job can start
+	BMessage done(kMsgLoadDone);
+	done.AddInt32("generation", job->generation);
+	done.AddInt32("status", status);
+	done.AddString("path", job->path.String());
+	done.AddPointer("image", image);
+	done.AddPointer("cached", cached);
+	if (job->view.SendMessage(&done) == B_OK) {
+		image = NULL;
+		cached = NULL;
+	}
+
+	delete_image(image, cached);
+
+	release_load_job(job);
+	return status;
 }
 
 
 void
-BSVGView::_BuildAGGPathWithOffset(NSVGshape* shape, agg::path_storage& aggPath,
-	float offsetX, float offsetY)
+BSVGView::_BuildGradientLUT(NSVGgradient* gradient, float opacity, GradientLUT& lut)
 {
-	if (!shape)
+	if (!gradient || gradient->nstops == 0) {
+		memset(&lut, 0, sizeof(GradientLUT));
 		return;
+	}
 
-	for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
-		if (path->npts < 2)
-			continue;
+	uint8 color[4];
+	for (int i = 0; i < 256; i++) {
+		svg_gradient_color(gradient, i / 255.0f, opacity, color);
+		lut.colors[i] = (rgb_color){color[0], color[1], color[2], color[3]};
+	}
+}
+
+
+// Returns the color table of the gradient as B_RGBA32 pixels. It is built
+// into buffer only if the cache cannot hold it.
+const uint8*
+BSVGView::_GradientTable(NSVGgradient* gradient, float opacity, uint8* buffer)
+{
+	SVGGradientKey key(gradient, SVG_GRADIENT_TABLE);
+	key.opacity = opacity;
+
+	const uint8* table = (const uint8*)fGradientCache.Find(key);
+	if (table != NULL)
+		return table;
 
-		float startX = path->pts[0] * fScale + offsetX;
-		float startY = path->pts[1] * fScale + offsetY;
-		aggPath.move_to(startX, startY);
+	uint8* pixels = (uint8*)fGradientCache.Add(key, 256 * 4);
+	if (pixels == NULL)
+		pixels = buffer;
+
+	GradientLUT lut;
+	_BuildGradientLUT(gradient, opacity, lut);
+	pack_gradient_lut(lut, pixels);
+	return pixels;
+}
+
+
+bool
+BSVGView::_GradientInverse(NSVGgradient* gradient, float* inverse)
+{
+	// The last element flags a singular transform
+	SVGGradientKey key(gradient, SVG_GRADIENT_INVERSE);
+	const float* cached = (const float*)fGradientCache.Find(key);
+	if (cached != NULL) {
+		memcpy(inverse, cached, sizeof(float) * 6);
+		return cached[6] != 0.0f;
+	}
+
+	float* t = gradient->xform;
+	double det = (double)t[0] * t[3] - (double)t[2] * t[1];
+	bool valid = fabs(det) >= 1e-6;
+	if (valid) {
+		double invdet = 1.0 / det;
+		inverse[0] = (float)(t[3] * invdet);
+		inverse[1] = (float)(-t[1] * invdet);
+		inverse[2] = (float)(-t[2] * invdet);
+		inverse[3] = (float)(t[0] * invdet);
+		inverse[4] = (float)(((double)t[2] * t[5] - (double)t[3] * t[4])
+			* invdet);
+		inverse[5] = (float)(((double)t[1] * t[4] - (double)t[0] * t[5])
+			* invdet);
+	} else
+		memset(inverse, 0, sizeof(float) * 6);
+
+	float* entry = (float*)fGradientCache.Add(key, sizeof(float) * 7);
+	if (entry != NULL) {
+		memcpy(entry, inverse, sizeof(float) * 6);
+		entry[6] = valid ? 1.0f : 0.0f;
+	}
+	return valid;
+}
+
+
+// Rasterized gradient for the current view transform, in the source area
+// of the bitmap. The bitmap belongs to the gradient cache, or to the
+// scratch pool if pooled is set.
+BBitmap*
+BSVGView::_GradientBitmap(NSVGgradient* gradient, char gradientType,
+	BRect shapeBounds, BRect clippedBounds, float shapeOpacity,
+	BRect& source, bool& pooled)
+{
+	SVGGradientKey key(gradient, SVG_GRADIENT_FILL_BITMAP);
+	key.type = gradientType;
+	key.opacity = shapeOpacity;
+	key.scale = fScale;
+	key.offsetX = fOffsetX;
+	key.offsetY = fOffsetY;
+	key.bounds = clippedBounds;
+
+	pooled = false;
+	BBitmap* bitmap = fGradientCache.FindBitmap(key);
+	if (bitmap != NULL) {
+		source = bitmap->Bounds();
+		return bitmap;
+	}
 
-		for (int i = 1; i + 2 < path->npts; i += 3) {
-			float c1x = path->pts[i * 2] * fScale + offsetX;
-			float c1y = path->pts[i * 2 + 1] * fScale + offsetY;
-			float c2x = path->pts[(i + 1) * 2] * fScale + offsetX;
-			float c2y = path->pts[(i + 1) * 2 + 1] * fScale + offsetY;
-			float endX = path->pts[(i + 2) * 2] * fScale + offsetX;
-			float endY = path->pts[(i + 2) * 2 + 1] * fScale + offsetY;
+	bitmap = _RasterizeGradient(gradient, gradientType, shapeBounds,
+		clippedBounds, shapeOpacity, source);
+	if (bitmap == NULL)
+		return NULL;
 
-			aggPath.curve4(c1x, c1y, c2x, c2y, endX, endY);
+	// Only bitmaps the cache keeps are worth an allocation of their own
+	if (fGradientCache.Accepts(upload_size(source))) {
+		BBitmap* copy = _CopyBitmapArea(bitmap, source);
+		if (copy != NULL && fGradientCache.AddBitmap(key, copy,
+				clippedBounds)) {
+			fScratchPool.ReleaseBitmap(bitmap);
+			source = copy->Bounds();
+			return copy;
 		}
+		delete copy;
+	}
 
-		if (path->closed)
-			aggPath.close_polygon();
+	pooled = true;
+	return bitmap;
+}
+
+
+// Exact size copy of the top left area of a B_RGBA32 bitmap
+BBitmap*
+BSVGView::_CopyBitmapArea(BBitmap* source, BRect area)
+{
+	int32 width = area.IntegerWidth() + 1;
+	int32 height = area.IntegerHeight() + 1;
+
+	BBitmap* bitmap = new BBitmap(BRect(0, 0, width - 1, height - 1),
+		B_RGBA32);
+	if (!bitmap || bitmap->InitCheck() != B_OK) {
+		delete bitmap;
+		return NULL;
 	}
+	fRenderStats.bitmapsAllocated++;
+
+	const uint8* src = (const uint8*)source->Bits();
+	uint8* dst = (uint8*)bitmap->Bits();
+	int32 srcBpr = source->BytesPerRow();
+	int32 dstBpr = bitmap->BytesPerRow();
+	for (int32 row = 0; row < height; row++)
+		memcpy(dst + row * dstBpr, src + row * srcBpr, width * 4);
+	return bitmap;
 }
 
 
-agg::line_cap_e
-BSVGView::_ConvertLineCapAGG(int nsvgCap)
+void
+BSVGView::_ApplyGradientToBuffer(uint8* bits, int width, int height, int32 bpr,
+	NSVGgradient* gradient, char gradientType, BRect renderBounds, float opacity)
 {
-	switch (nsvgCap) {
-		case NSVG_CAP_ROUND:
-			return agg::round_cap;
-		case NSVG_CAP_SQUARE:
-			return agg::square_cap;
-		case NSVG_CAP_BUTT:
-		default:
-			return agg::butt_cap;
+	if (!bits || !gradient)
+		return;
+
+	uint8 buffer[256 * 4];
+	const uint8* pixels = _GradientTable(gradient, opacity, buffer);
+
+	float invScale = 1.0f / fScale;
+
+	SVGGradientRow row;
+	row.lut = pixels;
+	row.xform = gradient->xform;
+	row.type = gradientType;
+	row.spread = gradient->spread;
+	row.fx = gradient->fx;
+	row.fy = gradient->fy;
+	row.startX = (renderBounds.left - fOffsetX) * invScale;
+	row.stepX = invScale;
+
+	for (int py = 0; py < height; py++) {
+		row.y = (renderBounds.top + py - fOffsetY) * invScale;
+		svg_gradient_apply_row(row, bits + py * bpr, width);
 	}
 }
 
 
-agg::line_join_e
-BSVGView::_ConvertLineJoinAGG(int nsvgJoin)
+void
+BSVGView::_BuildAGGPath(int32 shapeIndex, agg::path_storage& aggPath)
+{
+	_BuildAGGPathWithOffset(shapeIndex, aggPath, fOffsetX, fOffsetY);
+}
+
+
+void
+BSVGView::_BuildAGGPathWithOffset(int32 shapeIndex, agg::path_storage& aggPath,
+	float offsetX, float offsetY)
 {
-	switch (nsvgJoin) {
-		case NSVG_JOIN_ROUND:
-			return agg::round_join;
-		case NSVG_JOIN_BEVEL:
-			return agg::bevel_join;
-		case NSVG_JOIN_MITER:
-		default:
-			return agg::miter_join;
+	if (shapeIndex < 0)
+		return;
+
+	// The curves are already flattened, so the path needs no conv_curve
+	const SVGPolyline* polyline = fPolylineCache.Polyline(shapeIndex, fScale);
+	if (polyline == NULL)
+		return;
+
+	int32 firstPath = polyline->FirstPath();
+	int32 endPath = firstPath + polyline->CountPaths();
+	for (int32 path = firstPath; path < endPath; path++) {
+		int32 count = polyline->PathPointCount(path);
+		if (count < 2)
+			continue;
+
+		const float* pt = polyline->PathPoints(path);
+		aggPath.move_to(pt[0] * fScale + offsetX, pt[1] * fScale + offsetY);
+
+		for (int i = 1; i < count; i++) {
+			pt += 2;
+			aggPath.line_to(pt[0] * fScale + offsetX, pt[1] * fScale + offsetY);
+		}
+
+		if (fGeometry.IsPathClosed(path))
+			aggPath.close_polygon();
 	}
 }
 
@@ -545,41 +1541,28 @@ BSVGView::_ConvertLineJoinHaiku(int nsvgJoin)
 }
 
 
-float
-BSVGView::_ClampMiterLimit(float miterLimit)
-{
-	if (miterLimit < 1.0f)
-		return 1.0f;
-	if (miterLimit > 100.0f)
-		return 100.0f;
-	return miterLimit;
-}
-
-
 BShape*
-BSVGView::_ConvertStrokeToFillShape(NSVGshape* shape)
+BSVGView::_ConvertStrokeToFillShape(int32 shapeIndex)
 {
-	if (!shape || !shape->paths)
+	if (shapeIndex < 0 || fGeometry.ShapePathCount(shapeIndex) == 0)
 		return NULL;
 
-	agg::path_storage aggPath;
-	_BuildAGGPath(shape, aggPath);
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(shapeIndex);
 
-	typedef agg::conv_curve<agg::path_storage> CurveConverter;
-	CurveConverter curve(aggPath);
-	curve.approximation_scale(fScale > 1.0f ? fScale : 1.0f);
+	agg::path_storage& aggPath = fScratchPool.Path();
+	_BuildAGGPath(shapeIndex, aggPath);
 
-	typedef agg::conv_stroke<CurveConverter> StrokeConverter;
-	StrokeConverter stroke(curve);
+	typedef agg::conv_stroke<agg::path_storage> StrokeConverter;
+	StrokeConverter stroke(aggPath);
 
-	float strokeWidth = shape->strokeWidth * fScale;
+	float strokeWidth = style.strokeWidth * fScale;
 	if (strokeWidth < 0.1f)
 		strokeWidth = 0.1f;
 	stroke.width(strokeWidth);
 
-	stroke.line_cap(_ConvertLineCapAGG(shape->strokeLineCap));
-	stroke.line_join(_ConvertLineJoinAGG(shape->strokeLineJoin));
-	stroke.miter_limit(_ClampMiterLimit(shape->miterLimit));
+	stroke.line_cap(SVGRenderer::LineCap(style.strokeLineCap));
+	stroke.line_join(SVGRenderer::LineJoin(style.strokeLineJoin));
+	stroke.miter_limit(SVGRenderer::MiterLimit(style.miterLimit));
 
 	BShape* result = new BShape();
 	double x, y;
@@ -622,44 +1605,54 @@ BSVGView::_ConvertStrokeToFillShape(NSVGshape* shape)
 
 
 void
-BSVGView::_StrokeShapeWithRasterizedGradient(NSVGshape* shape, char gradientType)
+BSVGView::_StrokeShapeWithRasterizedGradient(BView* target,
+	int32 shapeIndex, BRect clipRect)
 {
-	if (!shape || !shape->stroke.gradient)
+	if (shapeIndex < 0)
 		return;
 
-	NSVGgradient* gradient = shape->stroke.gradient;
-	if (gradient->nstops == 0)
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(shapeIndex);
+	NSVGgradient* gradient = style.stroke.gradient;
+	if (!gradient || gradient->nstops == 0)
 		return;
 
-	BRect viewBounds = Bounds();
-
-	agg::path_storage aggPath;
-	_BuildAGGPath(shape, aggPath);
-
-	typedef agg::conv_curve<agg::path_storage> CurveConverter;
-	CurveConverter curve(aggPath);
-
-	float approxScale = fScale;
-	if (approxScale < 1.0f)
-		approxScale = 1.0f;
+	char gradientType = style.stroke.type;
+	BRect viewBounds = clipRect;
+
+	SVGGradientKey key(gradient, SVG_GRADIENT_STROKE_BITMAP);
+	key.type = gradientType;
+	key.shape = shapeIndex;
+	key.opacity = style.opacity;
+	key.scale = fScale;
+	key.offsetX = fOffsetX;
+	key.offsetY = fOffsetY;
+	key.bounds = clipRect;
+
+	BRect cachedFrame;
+	BBitmap* cached = fGradientCache.FindBitmap(key, &cachedFrame);
+	if (cached != NULL) {
+		target->SetDrawingMode(B_OP_ALPHA);
+		target->DrawBitmap(cached, cached->Bounds(), cachedFrame);
+		fRenderStats.bytesUploaded += upload_size(cached->Bounds());
+		return;
+	}
 
-	curve.approximation_method(agg::curve_div);
-	curve.approximation_scale(approxScale);
-	curve.angle_tolerance(0.0);
+	agg::path_storage& aggPath = fScratchPool.Path();
+	_BuildAGGPath(shapeIndex, aggPath);
 
-	typedef agg::conv_stroke<CurveConverter> StrokeConverter;
-	StrokeConverter stroke(curve);
+	typedef agg::conv_stroke<agg::path_storage> StrokeConverter;
+	StrokeConverter stroke(aggPath);
 
-	float strokeWidth = shape->strokeWidth * fScale;
+	float strokeWidth = style.strokeWidth * fScale;
 	if (strokeWidth < 0.1f)
 		strokeWidth = 0.1f;
 	stroke.width(strokeWidth);
 
-	stroke.line_cap(_ConvertLineCapAGG(shape->strokeLineCap));
-	stroke.line_join(_ConvertLineJoinAGG(shape->strokeLineJoin));
-	stroke.miter_limit(_ClampMiterLimit(shape->miterLimit));
+	stroke.line_cap(SVGRenderer::LineCap(style.strokeLineCap));
+	stroke.line_join(SVGRenderer::LineJoin(style.strokeLineJoin));
+	stroke.miter_limit(SVGRenderer::MiterLimit(style.miterLimit));
 
-	agg::path_storage strokePath;
+	agg::path_storage& strokePath = fScratchPool.StrokePath();
 	double x, y;
 	unsigned cmd;
 
@@ -709,16 +1702,13 @@ BSVGView::_StrokeShapeWithRasterizedGradient(NSVGshape* shape, char gradientType
 	if (width < 1) width = 1;
 	if (height < 1) height = 1;
 
-	BBitmap* combinedBitmap = new BBitmap(
-		BRect(0, 0, width - 1, height - 1), B_RGBA32);
-	if (!combinedBitmap || combinedBitmap->InitCheck() != B_OK) {
-		delete combinedBitmap;
+	// The scratch bitmap comes cleared in the requested area
+	BBitmap* combinedBitmap = fScratchPool.AcquireBitmap(width, height);
+	if (!combinedBitmap)
 		return;
-	}
 
 	uint8* bits = (uint8*)combinedBitmap->Bits();
 	int32 bpr = combinedBitmap->BytesPerRow();
-	memset(bits, 0, combinedBitmap->BitsLength());
 
 	typedef agg::pixfmt_bgra32 pixfmt;
 	typedef agg::renderer_base<pixfmt> renderer_base;
@@ -729,8 +1719,8 @@ BSVGView::_StrokeShapeWithRasterizedGradient(NSVGshape* shape, char gradientType
 	renderer_base rb(pixf);
 	renderer_solid ren(rb);
 
-	agg::rasterizer_scanline_aa<> ras;
-	agg::scanline_p8 sl;
+	agg::rasterizer_scanline_aa<>& ras = fScratchPool.Rasterizer();
+	agg::scanline_p8& sl = fScratchPool.Scanline();
 
 	ras.clip_box(0, 0, width, height);
 
@@ -756,32 +1746,47 @@ BSVGView::_StrokeShapeWithRasterizedGradient(NSVGshape* shape, char gradientType
 
 		BRect localBounds(0, 0, width - 1, height - 1);
 		_ApplyGradientToBuffer(bits, width, height, bpr, gradient,
-			gradientType, localBounds, shape->opacity);
+			gradientType, localBounds, style.opacity);
 
 		fScale = savedScale;
 		fOffsetX = savedOffsetX;
 		fOffsetY = savedOffsetY;
 	} else {
 		_ApplyGradientToBuffer(bits, width, height, bpr, gradient,
-			gradientType, totalBounds, shape->opacity);
+			gradientType, totalBounds, style.opacity);
 	}
 
-	SetDrawingMode(B_OP_ALPHA);
-	DrawBitmap(combinedBitmap, combinedBitmap->Bounds(), totalBounds);
+	BRect source(0, 0, width - 1, height - 1);
+	target->SetDrawingMode(B_OP_ALPHA);
+	target->DrawBitmap(combinedBitmap, source, totalBounds);
+	fRenderStats.bytesUploaded += upload_size(source);
 
-	delete combinedBitmap;
+	if (fGradientCache.Accepts(upload_size(source))) {
+		BBitmap* copy = _CopyBitmapArea(combinedBitmap, source);
+		if (copy != NULL && !fGradientCache.AddBitmap(key, copy, totalBounds))
+			delete copy;
+	}
+	fScratchPool.ReleaseBitmap(combinedBitmap);
 }
 
 
 void
-BSVGView::_RenderShapeToBuffer(NSVGshape* shape, BBitmap* bitmap, BRect renderBounds)
+BSVGView::_RenderShapeToBuffer(int32 shapeIndex, BBitmap* bitmap,
+	BRect renderBounds)
 {
-	if (!shape || !bitmap)
+	if (shapeIndex < 0 || !bitmap)
 		return;
 
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(shapeIndex);
+
 	uint8* bits = (uint8*)bitmap->Bits();
-	int width = bitmap->Bounds().IntegerWidth() + 1;
-	int height = bitmap->Bounds().IntegerHeight() + 1;
+	// Scratch bitmaps can be larger than the area to render
+	int width = (int)ceilf(renderBounds.Width()) + 1;
+	int height = (int)ceilf(renderBounds.Height()) + 1;
+	if (width > bitmap->Bounds().IntegerWidth() + 1)
+		width = bitmap->Bounds().IntegerWidth() + 1;
+	if (height > bitmap->Bounds().IntegerHeight() + 1)
+		height = bitmap->Bounds().IntegerHeight() + 1;
 	int32 bpr = bitmap->BytesPerRow();
 
 	typedef agg::pixfmt_bgra32 pixfmt;
@@ -793,89 +1798,91 @@ BSVGView::_RenderShapeToBuffer(NSVGshape* shape, BBitmap* bitmap, BRect renderBo
 	renderer_base rb(pixf);
 	renderer_solid ren(rb);
 
-	agg::rasterizer_scanline_aa<> ras;
-	agg::scanline_p8 sl;
+	agg::rasterizer_scanline_aa<>& ras = fScratchPool.Rasterizer();
+	agg::scanline_p8& sl = fScratchPool.Scanline();
 
 	float localOffsetX = fOffsetX - renderBounds.left;
 	float localOffsetY = fOffsetY - renderBounds.top;
 
-	agg::path_storage aggPath;
-	_BuildAGGPathWithOffset(shape, aggPath, localOffsetX, localOffsetY);
+	agg::path_storage& aggPath = fScratchPool.Path();
+	_BuildAGGPathWithOffset(shapeIndex, aggPath, localOffsetX, localOffsetY);
 
-	typedef agg::conv_curve<agg::path_storage> CurveConverter;
-	CurveConverter curve(aggPath);
-	curve.approximation_scale(fScale > 1.0f ? fScale : 1.0f);
-
-	if (shape->fill.type != NSVG_PAINT_NONE) {
+	if (style.fill.type != NSVG_PAINT_NONE) {
 		ras.reset();
 
-		if (shape->fillRule == NSVG_FILLRULE_EVENODD)
+		if (style.fillRule == NSVG_FILLRULE_EVENODD)
 			ras.filling_rule(agg::fill_even_odd);
 		else
 			ras.filling_rule(agg::fill_non_zero);
 
-		ras.add_path(curve);
+		ras.add_path(aggPath);
 
-		if (shape->fill.type == NSVG_PAINT_COLOR) {
-			rgb_color color = _ConvertColor(shape->fill.color, shape->opacity);
+		if (style.fill.type == NSVG_PAINT_COLOR) {
+			rgb_color color = _ConvertColor(style.fill.color, style.opacity);
 			ren.color(agg::rgba8(color.red, color.green, color.blue, color.alpha));
 			agg::render_scanlines(ras, sl, ren);
-		} else if ((shape->fill.type == NSVG_PAINT_LINEAR_GRADIENT ||
-					shape->fill.type == NSVG_PAINT_RADIAL_GRADIENT) &&
-				   shape->fill.gradient != NULL) {
+		} else if ((style.fill.type == NSVG_PAINT_LINEAR_GRADIENT ||
+					style.fill.type == NSVG_PAINT_RADIAL_GRADIENT) &&
+				   style.fill.gradient != NULL) {
 			ren.color(agg::rgba8(255, 255, 255, 255));
 			agg::render_scanlines(ras, sl, ren);
 
 			_ApplyGradientToBuffer(bits, width, height, bpr,
-				shape->fill.gradient, shape->fill.type, renderBounds,
-				shape->opacity);
+				style.fill.gradient, style.fill.type, renderBounds,
+				style.opacity);
 		}
 	}
 
-	if (shape->stroke.type != NSVG_PAINT_NONE && shape->strokeWidth > 0.0f) {
-		typedef agg::conv_stroke<CurveConverter> StrokeConverter;
-		StrokeConverter stroke(curve);
+	if (style.stroke.type != NSVG_PAINT_NONE && style.strokeWidth > 0.0f) {
+		typedef agg::conv_stroke<agg::path_storage> StrokeConverter;
+		StrokeConverter stroke(aggPath);
 
-		float strokeWidth = shape->strokeWidth * fScale;
+		float strokeWidth = style.strokeWidth * fScale;
 		if (strokeWidth < 0.1f)
 			strokeWidth = 0.1f;
 		stroke.width(strokeWidth);
 
-		stroke.line_cap(_ConvertLineCapAGG(shape->strokeLineCap));
-		stroke.line_join(_ConvertLineJoinAGG(shape->strokeLineJoin));
-		stroke.miter_limit(_ClampMiterLimit(shape->miterLimit));
+		stroke.line_cap(SVGRenderer::LineCap(style.strokeLineCap));
+		stroke.line_join(SVGRenderer::LineJoin(style.strokeLineJoin));
+		stroke.miter_limit(SVGRenderer::MiterLimit(style.miterLimit));
 
 		ras.reset();
 		ras.filling_rule(agg::fill_non_zero);
 		ras.add_path(stroke);
 
-		if (shape->stroke.type == NSVG_PAINT_COLOR) {
-			rgb_color color = _ConvertColor(shape->stroke.color, shape->opacity);
+		if (style.stroke.type == NSVG_PAINT_COLOR) {
+			rgb_color color = _ConvertColor(style.stroke.color, style.opacity);
 			ren.color(agg::rgba8(color.red, color.green, color.blue, color.alpha));
 			agg::render_scanlines(ras, sl, ren);
-		} else if ((shape->stroke.type == NSVG_PAINT_LINEAR_GRADIENT ||
-					shape->stroke.type == NSVG_PAINT_RADIAL_GRADIENT) &&
-				   shape->stroke.gradient != NULL) {
+		} else if ((style.stroke.type == NSVG_PAINT_LINEAR_GRADIENT ||
+					style.stroke.type == NSVG_PAINT_RADIAL_GRADIENT) &&
+				   style.stroke.gradient != NULL) {
 			ren.color(agg::rgba8(255, 255, 255, 255));
 			agg::render_scanlines(ras, sl, ren);
 
 			_ApplyGradientToBuffer(bits, width, height, bpr,
-				shape->stroke.gradient, shape->stroke.type, renderBounds,
-				shape->opacity);
+				style.stroke.gradient, style.stroke.type, renderBounds,
+				style.opacity);
 		}
 	}
 }
 
 
 void
-BSVGView::_RenderMaskToBuffer(NSVGmask* mask, BBitmap* bitmap, BRect renderBounds)
+BSVGView::_RenderMaskToBuffer(int32 maskIndex, BBitmap* bitmap,
+	BRect renderBounds)
 {
-	if (!mask || !mask->shapes || !bitmap)
+	if (maskIndex < 0 || !bitmap)
 		return;
 
 	uint8* bits = (uint8*)bitmap->Bits();
-	int width = bitmap->Bounds().IntegerWidth() + 1;
-	int height = bitmap->Bounds().IntegerHeight() + 1;
+	// Scratch bitmaps can be larger than the area to render
+	int width = (int)ceilf(renderBounds.Width()) + 1;
+	int height = (int)ceilf(renderBounds.Height()) + 1;
+	if (width > bitmap->Bounds().IntegerWidth() + 1)
+		width = bitmap->Bounds().IntegerWidth() + 1;
+	if (height > bitmap->Bounds().IntegerHeight() + 1)
+		height = bitmap->Bounds().IntegerHeight() + 1;
 	int32 bpr = bitmap->BytesPerRow();
 
 	typedef agg::pixfmt_bgra32 pixfmt;
@@ -887,73 +1894,72 @@ BSVGView::_RenderMaskToBuffer(NSVGmask* mask, BBitmap* bitmap, BRect renderBound
 	renderer_base rb(pixf);
 	renderer_solid ren(rb);
 
-	agg::rasterizer_scanline_aa<> ras;
-	agg::scanline_p8 sl;
+	agg::rasterizer_scanline_aa<>& ras = fScratchPool.Rasterizer();
+	agg::scanline_p8& sl = fScratchPool.Scanline();
 
 	float localOffsetX = fOffsetX - renderBounds.left;
 	float localOffsetY = fOffsetY - renderBounds.top;
 
-	for (NSVGshape* maskShape = mask->shapes; maskShape != NULL;
-		 maskShape = maskShape->next) {
-		if (!(maskShape->flags & NSVG_FLAGS_VISIBLE))
+	int32 firstShape = fGeometry.MaskFirstShape(maskIndex);
+	int32 endShape = firstShape + fGeometry.MaskShapeCount(maskIndex);
+	for (int32 maskShape = firstShape; maskShape < endShape; maskShape++) {
+		if (!fGeometry.IsShapeVisible(maskShape))
 			continue;
 
-		agg::path_storage aggPath;
-		_BuildAGGPathWithOffset(maskShape, aggPath, localOffsetX, localOffsetY);
+		const SVGShapeStyle& style = fGeometry.ShapeStyle(maskShape);
 
-		typedef agg::conv_curve<agg::path_storage> CurveConverter;
-		CurveConverter curve(aggPath);
-		curve.approximation_scale(fScale > 1.0f ? fScale : 1.0f);
+		agg::path_storage& aggPath = fScratchPool.Path();
+		_BuildAGGPathWithOffset(maskShape, aggPath, localOffsetX, localOffsetY);
 
-		if (maskShape->fill.type != NSVG_PAINT_NONE) {
+		if (style.fill.type != NSVG_PAINT_NONE) {
 			ras.reset();
 
-			if (maskShape->fillRule == NSVG_FILLRULE_EVENODD)
+			if (style.fillRule == NSVG_FILLRULE_EVENODD)
 				ras.filling_rule(agg::fill_even_odd);
 			else
 				ras.filling_rule(agg::fill_non_zero);
 
-			ras.add_path(curve);
+			ras.add_path(aggPath);
 
-			if (maskShape->fill.type == NSVG_PAINT_COLOR) {
-				rgb_color color = _ConvertColor(maskShape->fill.color,
-					maskShape->opacity);
+			if (style.fill.type == NSVG_PAINT_COLOR) {
+				rgb_color color = _ConvertColor(style.fill.color,
+					style.opacity);
 				ren.color(agg::rgba8(color.red, color.green, color.blue,
 					color.alpha));
 				agg::render_scanlines(ras, sl, ren);
-			} else if ((maskShape->fill.type == NSVG_PAINT_LINEAR_GRADIENT ||
-						maskShape->fill.type == NSVG_PAINT_RADIAL_GRADIENT) &&
-					   maskShape->fill.gradient != NULL) {
+			} else if ((style.fill.type == NSVG_PAINT_LINEAR_GRADIENT ||
+						style.fill.type == NSVG_PAINT_RADIAL_GRADIENT) &&
+					   style.fill.gradient != NULL) {
 				ren.color(agg::rgba8(255, 255, 255, 255));
 				agg::render_scanlines(ras, sl, ren);
 
 				_ApplyGradientToBuffer(bits, width, height, bpr,
-					maskShape->fill.gradient, maskShape->fill.type,
-					renderBounds, maskShape->opacity);
+					style.fill.gradient, style.fill.type,
+					renderBounds, style.opacity);
 			}
 		}
 
-		if (maskShape->stroke.type != NSVG_PAINT_NONE
-			&& maskShape->strokeWidth > 0.0f) {
-			typedef agg::conv_stroke<CurveConverter> StrokeConverter;
-			StrokeConverter stroke(curve);
+		if (style.stroke.type != NSVG_PAINT_NONE
+			&& style.strokeWidth > 0.0f) {
+			typedef agg::conv_stroke<agg::path_storage> StrokeConverter;
+			StrokeConverter stroke(aggPath);
 
-			float strokeWidth = maskShape->strokeWidth * fScale;
+			float strokeWidth = style.strokeWidth * fScale;
 			if (strokeWidth < 0.1f)
 				strokeWidth = 0.1f;
 			stroke.width(strokeWidth);
 
-			stroke.line_cap(_ConvertLineCapAGG(maskShape->strokeLineCap));
-			stroke.line_join(_ConvertLineJoinAGG(maskShape->strokeLineJoin));
-			stroke.miter_limit(_ClampMiterLimit(maskShape->miterLimit));
+			stroke.line_cap(SVGRenderer::LineCap(style.strokeLineCap));
+			stroke.line_join(SVGRenderer::LineJoin(style.strokeLineJoin));
+			stroke.miter_limit(SVGRenderer::MiterLimit(style.miterLimit));
 
 			ras.reset();
 			ras.filling_rule(agg::fill_non_zero);
 			ras.add_path(stroke);
 
-			if (maskShape->stroke.type == NSVG_PAINT_COLOR) {
-				rgb_color color = _ConvertColor(maskShape->stroke.color,
-					maskShape->opacity);
+			if (style.stroke.type == NSVG_PAINT_COLOR) {
+				rgb_color color = _ConvertColor(style.stroke.color,
+					style.opacity);
 				ren.color(agg::rgba8(color.red, color.green, color.blue,
 					color.alpha));
 				agg::render_scanlines(ras, sl, ren);
@@ -964,383 +1970,1488 @@ BSVGView::_RenderMaskToBuffer(NSVGmask* mask, BBitmap* bitmap, BRect renderBound
 
 
 void
-BSVGView::_ApplyMaskToBitmap(BBitmap* content, BBitmap* mask)
+BSVGView::_ApplyMaskToBitmap(BBitmap* content, BBitmap* mask, int32 width,
+	int32 height)
+{
+	if (!content || !mask)
+		return;
+
+	int32 contentBpr = content->BytesPerRow();
+	int32 maskBpr = mask->BytesPerRow();
+
+	uint8* contentBits = (uint8*)content->Bits();
+	uint8* maskBits = (uint8*)mask->Bits();
+
+	for (int py = 0; py < height; py++) {
+		uint8* contentRow = contentBits + py * contentBpr;
+		uint8* maskRow = maskBits + py * maskBpr;
+
+		svg_mask_apply_row(contentRow, maskRow, width);
+	}
+}
+
+
+void
+BSVGView::_DrawShapeWithMask(BView* target, int32 shapeIndex, BRect clipRect)
+{
+	int32 mask = fGeometry.ShapeMask(shapeIndex);
+	if (mask < 0)
+		return;
+
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(shapeIndex);
+	const float* bounds = fGeometry.ShapeBounds(shapeIndex);
+
+	BRect viewBounds = clipRect;
+	BRect shapeBounds(
+		bounds[0] * fScale + fOffsetX,
+		bounds[1] * fScale + fOffsetY,
+		bounds[2] * fScale + fOffsetX,
+		bounds[3] * fScale + fOffsetY);
+
+	float expand = style.strokeWidth * fScale * style.miterLimit;
+	shapeBounds.InsetBy(-expand, -expand);
+
+	if (!shapeBounds.Intersects(viewBounds))
+		return;
+
+	// Composites are cached relative to the integer part of the offset,
+	// which a pan changes without changing the pixels
+	float phaseX = fOffsetX - floorf(fOffsetX);
+	float phaseY = fOffsetY - floorf(fOffsetY);
+	float originX = fOffsetX - phaseX;
+	float originY = fOffsetY - phaseY;
+
+	SVGMaskedShape* cached = _FindMaskedShape(shapeIndex, phaseX, phaseY);
+	if (cached != NULL) {
+		target->SetDrawingMode(B_OP_ALPHA);
+		target->DrawBitmap(cached->bitmap, cached->bitmap->Bounds(),
+			cached->frame.OffsetByCopy(originX, originY));
+		fRenderStats.bytesUploaded += upload_size(cached->bitmap->Bounds());
+		return;
+	}
+
+	// The whole shape is composited when it can be cached, otherwise only
+	// the visible part
+	int fullWidth = (int)ceilf(shapeBounds.Width()) + 1;
+	int fullHeight = (int)ceilf(shapeBounds.Height()) + 1;
+	bool cacheable = fullWidth <= kMaxMaskDimension
+		&& fullHeight <= kMaxMaskDimension
+		&& (size_t)fullWidth * fullHeight * 4 <= fMaskCacheLimit;
+
+	BRect renderBounds = cacheable ? shapeBounds : shapeBounds & viewBounds;
+	if (!renderBounds.IsValid())
+		return;
+
+	int width = (int)ceilf(renderBounds.Width()) + 1;
+	int height = (int)ceilf(renderBounds.Height()) + 1;
+
+	if (width <= 0 || height <= 0)
+		return;
+
+	float downsample = 1.0f;
+	if (width > kMaxMaskDimension || height > kMaxMaskDimension) {
+		downsample = fmaxf((float)width / kMaxMaskDimension,
+						   (float)height / kMaxMaskDimension);
+		width = (int)(width / downsample);
+		height = (int)(height / downsample);
+	}
+
+	if (width <= 0)
+		width = 1;
+	if (height <= 0)
+		height = 1;
+
+	// A cached composite is kept, so it gets a bitmap of its exact size
+	BBitmap* contentBitmap;
+	if (cacheable) {
+		contentBitmap = new BBitmap(BRect(0, 0, width - 1, height - 1),
+			B_RGBA32);
+		fRenderStats.bitmapsAllocated++;
+		if (!contentBitmap || contentBitmap->InitCheck() != B_OK) {
+			delete contentBitmap;
+			return;
+		}
+		memset(contentBitmap->Bits(), 0, contentBitmap->BitsLength());
+	} else {
+		contentBitmap = fScratchPool.AcquireBitmap(width, height);
+		if (!contentBitmap)
+			return;
+	}
+
+	BBitmap* maskBitmap = fScratchPool.AcquireBitmap(width, height);
+	if (!maskBitmap) {
+		if (cacheable)
+			delete contentBitmap;
+		else
+			fScratchPool.ReleaseBitmap(contentBitmap);
+		return;
+	}
+
+	BRect adjustedRenderBounds = renderBounds;
+	if (downsample > 1.0f) {
+		float savedScale = fScale;
+		fScale = fScale / downsample;
+
+		float savedOffsetX = fOffsetX;
+		float savedOffsetY = fOffsetY;
+		fOffsetX = (fOffsetX - renderBounds.left) / downsample;
+		fOffsetY = (fOffsetY - renderBounds.top) / downsample;
+
+		adjustedRenderBounds = BRect(0, 0, width - 1, height - 1);
+
+		_RenderShapeToBuffer(shapeIndex, contentBitmap, adjustedRenderBounds);
+		_RenderMaskToBuffer(mask, maskBitmap, adjustedRenderBounds);
+
+		fScale = savedScale;
+		fOffsetX = savedOffsetX;
+		fOffsetY = savedOffsetY;
+	} else {
+		_RenderShapeToBuffer(shapeIndex, contentBitmap, renderBounds);
+		_RenderMaskToBuffer(mask, maskBitmap, renderBounds);
+	}
+
+	_ApplyMaskToBitmap(contentBitmap, maskBitmap, width, height);
+
+	target->SetDrawingMode(B_OP_ALPHA);
+	target->DrawBitmap(contentBitmap, BRect(0, 0, width - 1, height - 1),
+		renderBounds);
+	fRenderStats.bytesUploaded += upload_size(
+		BRect(0, 0, width - 1, height - 1));
+
+	if (!cacheable)
+		fScratchPool.ReleaseBitmap(contentBitmap);
+	else if (!_AddMaskedShape(shapeIndex, phaseX, phaseY, contentBitmap,
+			renderBounds.OffsetByCopy(-originX, -originY)))
+		delete contentBitmap;
+	fScratchPool.ReleaseBitmap(maskBitmap);
+}
+
+
+SVGMaskedShape*
+BSVGView::_FindMaskedShape(int32 shapeIndex, float phaseX, float phaseY)
+{
+	for (int32 i = 0; i < fMaskedShapeCount; i++) {
+		SVGMaskedShape& entry = fMaskedShapes[i];
+		if (entry.shape == shapeIndex && entry.scale == fScale
+			&& entry.phaseX == phaseX && entry.phaseY == phaseY) {
+			entry.lastUsed = ++fMaskCacheClock;
+			return &entry;
+		}
+	}
+	return NULL;
+}
+
+
+bool
+BSVGView::_AddMaskedShape(int32 shapeIndex, float phaseX, float phaseY,
+	BBitmap* bitmap, BRect frame)
+{
+	size_t bytes = bitmap->BitsLength();
+	if (bytes > fMaskCacheLimit)
+		return false;
+
+	_MakeMaskCacheRoom(bytes);
+
+	if (fMaskedShapeCount == fMaskedShapeCapacity) {
+		int32 capacity = fMaskedShapeCapacity > 0
+			? fMaskedShapeCapacity * 2 : 16;
+		SVGMaskedShape* entries = new(std::nothrow) SVGMaskedShape[capacity];
+		if (!entries)
+			return false;
+		if (fMaskedShapeCount > 0) {
+			memcpy(entries, fMaskedShapes,
+				fMaskedShapeCount * sizeof(SVGMaskedShape));
+		}
+		delete[] fMaskedShapes;
+		fMaskedShapes = entries;
+		fMaskedShapeCapacity = capacity;
+	}
+
+	SVGMaskedShape& entry = fMaskedShapes[fMaskedShapeCount++];
+	entry.bitmap = bitmap;
+	entry.frame = frame;
+	entry.shape = shapeIndex;
+	entry.scale = fScale;
+	entry.phaseX = phaseX;
+	entry.phaseY = phaseY;
+	entry.lastUsed = ++fMaskCacheClock;
+	fMaskCacheSize += bytes;
+	return true;
+}
+
+
+void
+BSVGView::_MakeMaskCacheRoom(size_t bytes)
+{
+	while (fMaskedShapeCount > 0 && fMaskCacheSize + bytes > fMaskCacheLimit) {
+		int32 victim = 0;
+		for (int32 i = 1; i < fMaskedShapeCount; i++) {
+			if (fMaskedShapes[i].lastUsed < fMaskedShapes[victim].lastUsed)
+				victim = i;
+		}
+
+		fMaskCacheSize -= fMaskedShapes[victim].bitmap->BitsLength();
+		delete fMaskedShapes[victim].bitmap;
+		fMaskedShapes[victim] = fMaskedShapes[--fMaskedShapeCount];
+	}
+}
+
+
+void
+BSVGView::_FlushMaskCache()
+{
+	for (int32 i = 0; i < fMaskedShapeCount; i++)
+		delete fMaskedShapes[i].bitmap;
+	fMaskedShapeCount = 0;
+	fMaskCacheSize = 0;
+}
+
+
+void
+BSVGView::_BuildDisplayList()
+{
+	_FreeDisplayList();
+
+	if (!fSVGImage)
+		return;
+
+	int32 count = fGeometry.CountVisibleShapes();
+	fDisplayListScale = fScale;
+	if (count == 0)
+		return;
+
+	fDisplayList = new(std::nothrow) SVGDisplayItem[count];
+	if (!fDisplayList)
+		return;
+
+	float savedOffsetX = fOffsetX;
+	float savedOffsetY = fOffsetY;
+	fOffsetX = 0.0f;
+	fOffsetY = 0.0f;
+
+	const int32* visibleShapes = fGeometry.VisibleShapes();
+	for (int32 i = 0; i < count; i++) {
+		SVGDisplayItem& item = fDisplayList[fDisplayListCount];
+		_CompileDisplayItem(visibleShapes[i], item);
+		fDisplayListBounds = fDisplayListCount == 0
+			? item.bounds : fDisplayListBounds | item.bounds;
+		fDisplayListCount++;
+	}
+
+	fOffsetX = savedOffsetX;
+	fOffsetY = savedOffsetY;
+}
+
+
+void
+BSVGView::_FreeDisplayList()
+{
+	for (int32 i = 0; i < fDisplayListCount; i++) {
+		SVGDisplayItem& item = fDisplayList[i];
+		delete item.path;
+		delete item.fillGradient;
+		delete item.strokeGradient;
+		delete item.strokeOutline;
+	}
+
+	delete[] fDisplayList;
+	fDisplayList = NULL;
+	fDisplayListCount = 0;
+	fDisplayListScale = 0.0f;
+	fDisplayListBounds = BRect();
+
+	_FlushTileCache();
+}
+
+
+void
+BSVGView::_CompileDisplayItem(int32 shapeIndex, SVGDisplayItem& item)
+{
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(shapeIndex);
+	const float* bounds = fGeometry.ShapeBounds(shapeIndex);
+
+	item.shapeIndex = shapeIndex;
+	item.masked = fGeometry.ShapeMask(shapeIndex) >= 0;
+	item.dot = false;
+	item.path = NULL;
+	item.fillClass = SVG_PAINT_CLASS_NONE;
+	item.fillGradient = NULL;
+	item.strokeClass = SVG_PAINT_CLASS_NONE;
+	item.strokeGradient = NULL;
+	item.strokeOutline = NULL;
+
+	item.bounds = BRect(bounds[0] * fScale, bounds[1] * fScale,
+		bounds[2] * fScale, bounds[3] * fScale);
+	float expand = style.strokeWidth * fScale * style.miterLimit;
+	item.bounds.InsetBy(-expand, -expand);
+
+	float width;
+	float height;
+	fGeometry.ShapeSize(shapeIndex, width, height);
+	if (fmaxf(width, height) * fScale < fDetailThreshold) {
+		item.dot = true;
+		return;
+	}
+
+	// Masked shapes are composited through AGG at draw time
+	if (item.masked || fGeometry.ShapePathCount(shapeIndex) == 0)
+		return;
+
+	const SVGPolyline* polyline = fPolylineCache.Polyline(shapeIndex, fScale);
+	if (polyline == NULL)
+		return;
+
+	item.path = new BShape();
+	int32 firstPath = polyline->FirstPath();
+	for (int32 path = firstPath; path < firstPath + polyline->CountPaths();
+			path++)
+		_ConvertPolyline(*polyline, path, *item.path);
+	item.fillBounds = item.path->Bounds();
+
+	switch (style.fill.type) {
+		case NSVG_PAINT_COLOR:
+			item.fillClass = SVG_PAINT_CLASS_SOLID;
+			item.fillColor = _ConvertColor(style.fill.color, style.opacity);
+			break;
+
+		case NSVG_PAINT_LINEAR_GRADIENT:
+		case NSVG_PAINT_RADIAL_GRADIENT:
+			_SetupGradient(style.fill.gradient, item.fillBounds,
+				style.fill.type, &item.fillGradient, style.opacity);
+			item.fillClass = item.fillGradient != NULL
+				? SVG_PAINT_CLASS_GRADIENT : SVG_PAINT_CLASS_RASTER_GRADIENT;
+			break;
+
+		default:
+			break;
+	}
+
+	if (style.stroke.type == NSVG_PAINT_NONE || style.strokeWidth <= 0.0f)
+		return;
+
+	item.penSize = style.strokeWidth * fScale;
+	if (item.penSize < 0.1f)
+		item.penSize = 0.1f;
+	item.lineCap = _ConvertLineCapHaiku(style.strokeLineCap);
+	item.lineJoin = _ConvertLineJoinHaiku(style.strokeLineJoin);
+	item.miterLimit = SVGRenderer::MiterLimit(style.miterLimit);
+
+	switch (style.stroke.type) {
+		case NSVG_PAINT_COLOR:
+			item.strokeClass = SVG_PAINT_CLASS_SOLID;
+			item.strokeColor = _ConvertColor(style.stroke.color, style.opacity);
+			break;
+
+		case NSVG_PAINT_LINEAR_GRADIENT:
+		case NSVG_PAINT_RADIAL_GRADIENT:
+		{
+			item.strokeOutline = _ConvertStrokeToFillShape(shapeIndex);
+			if (!item.strokeOutline) {
+				NSVGgradient* gradient = style.stroke.gradient;
+				if (gradient && gradient->nstops > 0) {
+					item.strokeClass = SVG_PAINT_CLASS_SOLID;
+					item.strokeColor = _ConvertColor(
+						gradient->stops[gradient->nstops / 2].color,
+						style.opacity);
+				}
+				break;
+			}
+
+			_SetupGradient(style.stroke.gradient, item.strokeOutline->Bounds(),
+				style.stroke.type, &item.strokeGradient, style.opacity);
+			if (item.strokeGradient) {
+				item.strokeClass = SVG_PAINT_CLASS_GRADIENT;
+			} else {
+				item.strokeClass = SVG_PAINT_CLASS_RASTER_GRADIENT;
+				delete item.strokeOutline;
+				item.strokeOutline = NULL;
+			}
+			break;
+		}
+
+		default:
+			item.strokeClass = SVG_PAINT_CLASS_SOLID;
+			item.strokeColor = (rgb_color){0, 0, 0, 255};
+			break;
+	}
+}
+
+
+void
+BSVGView::_DrawDisplayItem(BView* target, const SVGDisplayItem& item,
+	BRect clipRect)
+{
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(item.shapeIndex);
+
+	if (item.dot) {
+		if (!item.bounds.OffsetByCopy(fOffsetX, fOffsetY).Intersects(
+				clipRect)) {
+			fRenderStats.shapesCulled++;
+			return;
+		}
+		_DrawDetailDot(target, item);
+		fRenderStats.shapesSkipped++;
+		return;
+	}
+
+	if (item.masked) {
+		bigtime_t start = system_time();
+		_DrawShapeWithMask(target, item.shapeIndex, clipRect);
+		fRenderStats.maskTime += system_time() - start;
+		fRenderStats.shapesDrawn++;
+		return;
+	}
+
+	BRect viewBounds = clipRect;
+	if (!item.path
+		|| !item.bounds.OffsetByCopy(fOffsetX, fOffsetY).Intersects(viewBounds)) {
+		fRenderStats.shapesCulled++;
+		return;
+	}
+	fRenderStats.shapesDrawn++;
+
+	bool drawFill = (fDisplayMode == SVG_DISPLAY_NORMAL
+		|| fDisplayMode == SVG_DISPLAY_FILL_ONLY);
+	bool drawStroke = (fDisplayMode == SVG_DISPLAY_NORMAL
+		|| fDisplayMode == SVG_DISPLAY_STROKE_ONLY);
+	bool drawOutline = (fDisplayMode == SVG_DISPLAY_OUTLINE);
+
+	if (drawOutline) {
+		target->PushState();
+		target->SetOrigin(fOffsetX, fOffsetY);
+		target->SetHighColor(0, 0, 0);
+		target->SetPenSize(1.0f);
+		target->SetLineMode(B_BUTT_CAP, B_MITER_JOIN, 4.0f);
+		target->StrokeShape(item.path);
+		fRenderStats.strokeShapeCalls++;
+		target->PopState();
+		return;
+	}
+
+	if (drawFill && item.fillClass != SVG_PAINT_CLASS_NONE) {
+		target->PushState();
+		target->SetOrigin(fOffsetX, fOffsetY);
+
+		switch (item.fillClass) {
+			case SVG_PAINT_CLASS_SOLID:
+				target->SetHighColor(item.fillColor);
+				target->FillShape(item.path);
+				fRenderStats.fillShapeCalls++;
+				break;
+
+			case SVG_PAINT_CLASS_GRADIENT:
+				target->FillShape(item.path, *item.fillGradient);
+				fRenderStats.fillShapeCalls++;
+				break;
+
+			case SVG_PAINT_CLASS_RASTER_GRADIENT:
+			{
+				BRect fillBounds = item.fillBounds.OffsetByCopy(fOffsetX,
+					fOffsetY);
+				if (!fillBounds.Intersects(viewBounds))
+					break;
+
+				BRect clippedBounds = fillBounds & viewBounds;
+				if (!clippedBounds.IsValid())
+					break;
+
+				bigtime_t start = system_time();
+				BRect source;
+				bool pooled;
+				BBitmap* gradientBitmap = _GradientBitmap(
+					style.fill.gradient, style.fill.type,
+					fillBounds, clippedBounds, style.opacity, source, pooled);
+
+				if (gradientBitmap) {
+					_FillShapeWithGradientBitmap(target, *item.path,
+						gradientBitmap, source, clippedBounds);
+					if (pooled)
+						fScratchPool.ReleaseBitmap(gradientBitmap);
+				} else if (style.fill.gradient
+					&& style.fill.gradient->nstops > 0) {
+					rgb_color color = _ConvertColor(
+						style.fill.gradient->stops[0].color,
+						style.opacity);
+					target->SetHighColor(color);
+					target->FillShape(item.path);
+					fRenderStats.fillShapeCalls++;
+				}
+				fRenderStats.gradientTime += system_time() - start;
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		target->PopState();
+	}
+
+	if (!drawStroke)
+		return;
+
+	switch (item.strokeClass) {
+		case SVG_PAINT_CLASS_SOLID:
+			target->PushState();
+			target->SetOrigin(fOffsetX, fOffsetY);
+			target->SetPenSize(item.penSize);
+			target->SetLineMode(item.lineCap, item.lineJoin, item.miterLimit);
+			target->SetHighColor(item.strokeColor);
+			target->StrokeShape(item.path);
+			fRenderStats.strokeShapeCalls++;
+			target->PopState();
+			break;
+
+		case SVG_PAINT_CLASS_GRADIENT:
+			target->PushState();
+			target->SetOrigin(fOffsetX, fOffsetY);
+			target->SetDrawingMode(B_OP_ALPHA);
+			target->FillShape(item.strokeOutline, *item.strokeGradient);
+			fRenderStats.fillShapeCalls++;
+			target->PopState();
+			break;
+
+		case SVG_PAINT_CLASS_RASTER_GRADIENT:
+		{
+			bigtime_t start = system_time();
+			_StrokeShapeWithRasterizedGradient(target, item.shapeIndex,
+				clipRect);
+			fRenderStats.gradientTime += system_time() - start;
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+
+void
+BSVGView::_DrawDetailDot(BView* target, const SVGDisplayItem& item)
+{
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(item.shapeIndex);
+
+	uint32 color;
+	switch (fDisplayMode) {
+		case SVG_DISPLAY_OUTLINE:
+			color = 0xff000000;
+			break;
+		case SVG_DISPLAY_FILL_ONLY:
+			if (style.fill.type == NSVG_PAINT_NONE)
+				return;
+			color = SVGGeometry::AverageColor(style.fill);
+			break;
+		case SVG_DISPLAY_STROKE_ONLY:
+			if (style.stroke.type == NSVG_PAINT_NONE
+				|| style.strokeWidth <= 0.0f)
+				return;
+			color = SVGGeometry::AverageColor(style.stroke);
+			break;
+		default:
+			color = SVGGeometry::AverageColor(
+				style.fill.type != NSVG_PAINT_NONE ? style.fill : style.stroke);
+			break;
+	}
+
+	// Same approximation as SVGRenderer: the pixel is covered by the
+	// area of the shape
+	float width;
+	float height;
+	fGeometry.ShapeSize(item.shapeIndex, width, height);
+	float coverage = fminf(fmaxf(width, 0.0f) * fmaxf(height, 0.0f)
+		* fScale * fScale, 1.0f);
+
+	rgb_color dotColor = _ConvertColor(color, style.opacity * coverage);
+	if (dotColor.alpha == 0)
+		return;
+
+	BPoint center((item.bounds.left + item.bounds.right) * 0.5f + fOffsetX,
+		(item.bounds.top + item.bounds.bottom) * 0.5f + fOffsetY);
+	BRect pixel(floorf(center.x), floorf(center.y), floorf(center.x),
+		floorf(center.y));
+
+	target->PushState();
+	target->SetDrawingMode(B_OP_ALPHA);
+	target->SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+	target->SetHighColor(dotColor);
+	target->FillRect(pixel);
+	fRenderStats.fillShapeCalls++;
+	target->PopState();
+}
+
+
+status_t
+BSVGView::_BuildSpatialIndex()
+{
+	fSpatialIndex.Unset();
+	delete[] fVisibleItems;
+	fVisibleItems = NULL;
+
+	if (!fSVGImage)
+		return B_OK;
+
+	int32 count = fGeometry.CountVisibleShapes();
+	if (count == 0)
+		return B_OK;
+
+	float* bounds = new(std::nothrow) float[count * 4];
+	fVisibleItems = new(std::nothrow) int32[count];
+	if (!bounds || !fVisibleItems) {
+		delete[] bounds;
+		delete[] fVisibleItems;
+		fVisibleItems = NULL;
+		return B_NO_MEMORY;
+	}
+
+	// Same expansion as the display list bounds, in document units
+	const int32* visibleShapes = fGeometry.VisibleShapes();
+	float* b = bounds;
+	for (int32 i = 0; i < count; i++, b += 4) {
+		const SVGShapeStyle& style = fGeometry.ShapeStyle(visibleShapes[i]);
+		const float* shapeBounds = fGeometry.ShapeBounds(visibleShapes[i]);
+		float expand = style.strokeWidth * style.miterLimit;
+		b[0] = shapeBounds[0] - expand;
+		b[1] = shapeBounds[1] - expand;
+		b[2] = shapeBounds[2] + expand;
+		b[3] = shapeBounds[3] + expand;
+	}
+
+	status_t status = fSpatialIndex.SetTo(bounds, count);
+	delete[] bounds;
+	return status;
+}
+
+
+int32
+BSVGView::_QueryDisplayItems(BRect viewRect)
+{
+	if (!fVisibleItems || !viewRect.IsValid()
+		|| fSpatialIndex.CountItems() != fDisplayListCount)
+		return 0;
+
+	float invScale = 1.0f / fScale;
+	int32 count = fSpatialIndex.Query(
+		(viewRect.left - 1.0f - fOffsetX) * invScale,
+		(viewRect.top - 1.0f - fOffsetY) * invScale,
+		(viewRect.right + 1.0f - fOffsetX) * invScale,
+		(viewRect.bottom + 1.0f - fOffsetY) * invScale,
+		fVisibleItems);
+	fRenderStats.shapesCulled += fDisplayListCount - count;
+
+	// Shapes that cannot put any color on the screen are only outlined
+	if (fDisplayMode != SVG_DISPLAY_OUTLINE) {
+		const int32* visibleShapes = fGeometry.VisibleShapes();
+		int32 painted = 0;
+		for (int32 i = 0; i < count; i++) {
+			if (!fGeometry.IsShapeTransparent(visibleShapes[fVisibleItems[i]]))
+				fVisibleItems[painted++] = fVisibleItems[i];
+		}
+		count = painted;
+	}
+	return count;
+}
+
+
+bool
+BSVGView::_HitTestShape(int32 shapeIndex, BRect pixels)
+{
+	if (!_HitTestPaint(shapeIndex, pixels, fDisplayMode))
+		return false;
+
+	// A masked shape is hit where one of the mask shapes paints. The
+	// luminance of the mask is not taken into account.
+	int32 mask = fGeometry.ShapeMask(shapeIndex);
+	if (mask < 0)
+		return true;
+
+	int32 firstShape = fGeometry.MaskFirstShape(mask);
+	int32 endShape = firstShape + fGeometry.MaskShapeCount(mask);
+	for (int32 maskShape = firstShape; maskShape < endShape; maskShape++) {
+		if (_HitTestPaint(maskShape, pixels, SVG_DISPLAY_NORMAL))
+			return true;
+	}
+	return false;
+}
+
+
+bool
+BSVGView::_HitTestPaint(int32 shapeIndex, BRect pixels,
+	svg_display_mode displayMode)
+{
+	const SVGShapeStyle& style = fGeometry.ShapeStyle(shapeIndex);
+
+	bool drawOutline = (displayMode == SVG_DISPLAY_OUTLINE);
+	bool drawFill = (displayMode == SVG_DISPLAY_NORMAL
+		|| displayMode == SVG_DISPLAY_FILL_ONLY) && is_painted(style.fill);
+	bool drawStroke = (displayMode == SVG_DISPLAY_NORMAL
+		|| displayMode == SVG_DISPLAY_STROKE_ONLY)
+		&& is_painted(style.stroke) && style.strokeWidth > 0.0f;
+	if (!drawOutline && !drawFill && !drawStroke)
+		return false;
+
+	agg::path_storage& aggPath = fScratchPool.Path();
+	_BuildAGGPath(shapeIndex, aggPath);
+
+	// Only the cells inside the clip box are generated, so testing a few
+	// pixels of a large shape is cheap
+	agg::rasterizer_scanline_aa<>& ras = fScratchPool.Rasterizer();
+	agg::scanline_p8& sl = fScratchPool.Scanline();
+	ras.clip_box(pixels.left, pixels.top, pixels.right + 1,
+		pixels.bottom + 1);
+
+	if (drawFill) {
+		if (style.fillRule == NSVG_FILLRULE_EVENODD)
+			ras.filling_rule(agg::fill_even_odd);
+		else
+			ras.filling_rule(agg::fill_non_zero);
+		ras.add_path(aggPath);
+		if (has_coverage(ras, sl))
+			return true;
+	}
+
+	if (!drawStroke && !drawOutline)
+		return false;
+
+	typedef agg::conv_stroke<agg::path_storage> StrokeConverter;
+	StrokeConverter stroke(aggPath);
+
+	if (drawOutline) {
+		stroke.width(1.0);
+		stroke.line_cap(agg::butt_cap);
+		stroke.line_join(agg::miter_join);
+		stroke.miter_limit(4.0);
+	} else {
+		float strokeWidth = style.strokeWidth * fScale;
+		if (strokeWidth < 0.1f)
+			strokeWidth = 0.1f;
+		stroke.width(strokeWidth);
+		stroke.line_cap(SVGRenderer::LineCap(style.strokeLineCap));
+		stroke.line_join(SVGRenderer::LineJoin(style.strokeLineJoin));
+		stroke.miter_limit(SVGRenderer::MiterLimit(style.miterLimit));
+	}
+
+	ras.reset();
+	ras.filling_rule(agg::fill_non_zero);
+	ras.add_path(stroke);
+	return has_coverage(ras, sl);
+}
+
+
+void
+BSVGView::_DrawSoftware(BRect updateRect)
+{
+	BRect bounds = Bounds();
+	int32 width = bounds.IntegerWidth() + 1;
+	int32 height = bounds.IntegerHeight() + 1;
+
+	if (fRenderBitmap
+		&& (fRenderBitmap->Bounds().IntegerWidth() + 1 != width
+			|| fRenderBitmap->Bounds().IntegerHeight() + 1 != height)) {
+		delete fRenderBitmap;
+		fRenderBitmap = NULL;
+	}
+
+	if (!fRenderBitmap) {
+		fRenderBitmap = new BBitmap(BRect(0, 0, width - 1, height - 1),
+			B_RGBA32);
+		fRenderStats.bitmapsAllocated++;
+		if (!fRenderBitmap || fRenderBitmap->InitCheck() != B_OK) {
+			delete fRenderBitmap;
+			fRenderBitmap = NULL;
+			return;
+		}
+	}
+
+	BRect area = (updateRect & bounds).OffsetByCopy(-bounds.left, -bounds.top);
+	if (!area.IsValid())
+		return;
+
+	agg::rect_i clip((int)floorf(area.left), (int)floorf(area.top),
+		(int)ceilf(area.right), (int)ceilf(area.bottom));
+	SVGRenderBuffer buffer((uint8*)fRenderBitmap->Bits(), width, height,
+		fRenderBitmap->BytesPerRow());
+
+	SVGRenderer::ClearBuffer(buffer, clip);
+	fRenderer.Render(buffer, fScale, fOffsetX - bounds.left,
+		fOffsetY - bounds.top, clip);
+	fRenderStats.shapesSkipped += fRenderer.CountSkipped();
+
+	BRect source(clip.x1, clip.y1, clip.x2, clip.y2);
+	SetDrawingMode(B_OP_ALPHA);
+	SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+	DrawBitmap(fRenderBitmap, source,
+		source.OffsetByCopy(bounds.left, bounds.top));
+	fRenderStats.bytesUploaded += upload_size(source);
+}
+
+
+void
+BSVGView::_DrawProgressive(BRect updateRect)
+{
+	BRect bounds = Bounds();
+	int32 width = bounds.IntegerWidth() + 1;
+	int32 height = bounds.IntegerHeight() + 1;
+
+	if (!fRefineBitmap
+		|| fRefineBitmap->Bounds().IntegerWidth() + 1 != width
+		|| fRefineBitmap->Bounds().IntegerHeight() + 1 != height
+		|| fRefineScale != fScale
+		|| fRefineOffsetX != fOffsetX - bounds.left
+		|| fRefineOffsetY != fOffsetY - bounds.top
+		|| fRefineDisplayMode != fDisplayMode)
+		_StartRefinement();
+	else
+		_FinishRefinement();
+
+	BRect area = updateRect & bounds;
+	if (!area.IsValid())
+		return;
+
+	SetDrawingMode(B_OP_ALPHA);
+	SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+
+	if (fRefineDone) {
+		DrawBitmap(fRefineBitmap,
+			area.OffsetByCopy(-bounds.left, -bounds.top), area);
+		fRenderStats.bytesUploaded += upload_size(area);
+		return;
+	}
+
+	if (fPreviewBitmap) {
+		BRect source = fPreviewBitmap->Bounds();
+		BRect destination(bounds.left, bounds.top,
+			bounds.left + (source.Width() + 1) * kPreviewDownsample - 1,
+			bounds.top + (source.Height() + 1) * kPreviewDownsample - 1);
+		DrawBitmap(fPreviewBitmap, source, destination,
+			B_FILTER_BITMAP_BILINEAR);
+		fRenderStats.bytesUploaded += upload_size(source);
+	}
+}
+
+
+void
+BSVGView::_StartRefinement()
+{
+	_StopRefinement();
+
+	BRect bounds = Bounds();
+	int32 width = bounds.IntegerWidth() + 1;
+	int32 height = bounds.IntegerHeight() + 1;
+
+	fRefineGeneration++;
+	fRefineScale = fScale;
+	fRefineOffsetX = fOffsetX - bounds.left;
+	fRefineOffsetY = fOffsetY - bounds.top;
+	fRefineDisplayMode = fDisplayMode;
+
+	if (fRefineBitmap
+		&& (fRefineBitmap->Bounds().IntegerWidth() + 1 != width
+			|| fRefineBitmap->Bounds().IntegerHeight() + 1 != height)) {
+		delete fRefineBitmap;
+		fRefineBitmap = NULL;
+	}
+
+	if (!fRefineBitmap) {
+		fRefineBitmap = new BBitmap(BRect(0, 0, width - 1, height - 1),
+			B_RGBA32);
+		fRenderStats.bitmapsAllocated++;
+		if (!fRefineBitmap || fRefineBitmap->InitCheck() != B_OK) {
+			delete fRefineBitmap;
+			fRefineBitmap = NULL;
+			return;
+		}
+	}
+
+	_RenderPreview();
+
+	fRefineRenderer.SetDisplayMode(fDisplayMode);
+	fRefineRenderer.SetDetailThreshold(fDetailThreshold);
+	fRefineMessenger = BMessenger(this);
+
+	SVGRefineJob* job = new(std::nothrow) SVGRefineJob;
+	if (job != NULL) {
+		job->view = this;
+		job->generation = fRefineGeneration;
+		fRefineThread = spawn_thread(_RefineThread, "svg refine",
+			B_NORMAL_PRIORITY, job);
+		if (fRefineThread >= 0 && resume_thread(fRefineThread) == B_OK)
+			return;
+
+		if (fRefineThread >= 0)
+			kill_thread(fRefineThread);
+		fRefineThread = -1;
+		delete job;
+	}
+
+	// Render in place, which is what the non-progressive modes do
+	fRefineDone = _Refine(fRefineGeneration, false) == B_OK;
+}
+
+
+void
+BSVGView::_StopRefinement()
+{
+	if (fRefineThread >= 0) {
+		fRefineRenderer.SetCanceled(true);
+		status_t status;
+		wait_for_thread(fRefineThread, &status);
+		fRefineThread = -1;
+		fRefineRenderer.SetCanceled(false);
+	}
+	fRefineDone = false;
+}
+
+
+// Shows the refined bitmap once the thread has rendered it. This does not
+// depend on the notification, which only triggers the redraw.
+void
+BSVGView::_FinishRefinement()
+{
+	if (fRefineThread < 0
+		|| atomic_get(&fRefineCompleted) != fRefineGeneration)
+		return;
+
+	// The thread may still be trying to deliver the notification; canceling
+	// makes it give up instead of waiting for our message queue
+	_StopRefinement();
+	fRefineDone = true;
+}
+
+
+void
+BSVGView::_RenderPreview()
+{
+	// Same remapping as the downsampled path in _DrawShapeWithMask(): the
+	// scale and the offset are both divided by the downsample factor
+	BRect bounds = Bounds();
+	int32 width = (int32)ceilf((bounds.IntegerWidth() + 1) / kPreviewDownsample);
+	int32 height = (int32)ceilf((bounds.IntegerHeight() + 1)
+		/ kPreviewDownsample);
+
+	if (fPreviewBitmap
+		&& (fPreviewBitmap->Bounds().IntegerWidth() + 1 != width
+			|| fPreviewBitmap->Bounds().IntegerHeight() + 1 != height)) {
+		delete fPreviewBitmap;
+		fPreviewBitmap = NULL;
+	}
+
+	if (!fPreviewBitmap) {
+		fPreviewBitmap = new BBitmap(BRect(0, 0, width - 1, height - 1),
+			B_RGBA32);
+		fRenderStats.bitmapsAllocated++;
+		if (!fPreviewBitmap || fPreviewBitmap->InitCheck() != B_OK) {
+			delete fPreviewBitmap;
+			fPreviewBitmap = NULL;
+			return;
+		}
+	}
+
+	SVGRenderBuffer buffer((uint8*)fPreviewBitmap->Bits(), width, height,
+		fPreviewBitmap->BytesPerRow());
+	SVGRenderer::ClearBuffer(buffer, agg::rect_i(0, 0, width - 1, height - 1));
+	fRenderer.Render(buffer, fRefineScale / kPreviewDownsample,
+		fRefineOffsetX / kPreviewDownsample,
+		fRefineOffsetY / kPreviewDownsample);
+}
+
+
+// Renders the refined bitmap. The bitmap and the refine parameters are not
+// touched by the window thread until the refinement is stopped.
+status_t
+BSVGView::_Refine(int32 generation, bool notify)
+{
+	BBitmap* bitmap = fRefineBitmap;
+	int32 width = bitmap->Bounds().IntegerWidth() + 1;
+	int32 height = bitmap->Bounds().IntegerHeight() + 1;
+
+	SVGRenderBuffer buffer((uint8*)bitmap->Bits(), width, height,
+		bitmap->BytesPerRow());
+	SVGRenderer::ClearBuffer(buffer, agg::rect_i(0, 0, width - 1, height - 1));
+	fRefineRenderer.Render(buffer, fRefineScale, fRefineOffsetX,
+		fRefineOffsetY);
+
+	if (fRefineRenderer.IsCanceled())
+		return B_CANCELED;
+
+	atomic_set(&fRefineCompleted, generation);
+	if (!notify)
+		return B_OK;
+
+	// The window may be waiting for this thread in _StopRefinement(), so
+	// never block on a full message queue, but keep trying until the
+	// refinement is stopped
+	BMessage message(kMsgRefineDone);
+	message.AddInt32("generation", generation);
+	while (fRefineMessenger.SendMessage(&message, (BHandler*)NULL, 100000)
+			== B_TIMED_OUT) {
+		if (fRefineRenderer.IsCanceled())
+			break;
+	}
+	return B_OK;
+}
+
+
+status_t
+BSVGView::_RefineThread(void* data)
+{
+	SVGRefineJob* job = (SVGRefineJob*)data;
+	BSVGView* view = job->view;
+	int32 generation = job->generation;
+	delete job;
+
+	return view->_Refine(generation, true);
+}
+
+
+// Every scale change of an interaction restarts the settle timer. Until it
+// fires, Draw() only scales the frame captured at the start, and nothing
+// is rendered for the intermediate scales.
+void
+BSVGView::_BeginInteraction()
 {
-	if (!content || !mask)
+	if (fSettleInterval <= 0 || !Window())
 		return;
 
-	int width = content->Bounds().IntegerWidth() + 1;
-	int height = content->Bounds().IntegerHeight() + 1;
-	int32 contentBpr = content->BytesPerRow();
-	int32 maskBpr = mask->BytesPerRow();
+	if (!fSnapshotBitmap) {
+		_CaptureSnapshot();
+		if (!fSnapshotBitmap)
+			return;
+	}
 
-	uint8* contentBits = (uint8*)content->Bits();
-	uint8* maskBits = (uint8*)mask->Bits();
+	// A refinement for the old scale would only be thrown away
+	_StopRefinement();
+
+	delete fSettleRunner;
+	fSettleGeneration++;
+	BMessage message(kMsgSettle);
+	message.AddInt32("generation", fSettleGeneration);
+	fSettleRunner = new BMessageRunner(BMessenger(this), &message,
+		fSettleInterval, 1);
+	if (!fSettleRunner || fSettleRunner->InitCheck() != B_OK)
+		_EndInteraction();
+}
 
-	for (int py = 0; py < height; py++) {
-		uint8* contentRow = contentBits + py * contentBpr;
-		uint8* maskRow = maskBits + py * maskBpr;
 
-		for (int px = 0; px < width; px++) {
-			uint8 maskB = maskRow[px * 4 + 0];
-			uint8 maskG = maskRow[px * 4 + 1];
-			uint8 maskR = maskRow[px * 4 + 2];
-			uint8 maskA = maskRow[px * 4 + 3];
+void
+BSVGView::_EndInteraction()
+{
+	// A settle message that is already queued no longer matches
+	fSettleGeneration++;
+	delete fSettleRunner;
+	fSettleRunner = NULL;
+	delete fSnapshotBitmap;
+	fSnapshotBitmap = NULL;
+}
 
-			uint32 luminance = (54 * maskR + 183 * maskG + 19 * maskB) >> 8;
-			if (luminance > 255)
-				luminance = 255;
 
-			uint32 maskOpacity = (luminance * maskA) / 255;
+void
+BSVGView::_CaptureSnapshot()
+{
+	BRect bounds = Bounds();
+	int32 width = bounds.IntegerWidth() + 1;
+	int32 height = bounds.IntegerHeight() + 1;
+
+	fSnapshotScale = fScale;
+	fSnapshotOffsetX = fOffsetX - bounds.left;
+	fSnapshotOffsetY = fOffsetY - bounds.top;
+
+	// The frame on screen is usually still in one of the render paths, and
+	// their bitmaps are recreated by the next full render anyway
+	if (fProgressive) {
+		if (fRefineDone && fRefineBitmap) {
+			fSnapshotBitmap = fRefineBitmap;
+			fSnapshotScale = fRefineScale;
+			fSnapshotOffsetX = fRefineOffsetX;
+			fSnapshotOffsetY = fRefineOffsetY;
+			fRefineBitmap = NULL;
+			fRefineDone = false;
+			return;
+		}
+		if (fPreviewBitmap) {
+			fSnapshotBitmap = fPreviewBitmap;
+			fSnapshotScale = fRefineScale / kPreviewDownsample;
+			fSnapshotOffsetX = fRefineOffsetX / kPreviewDownsample;
+			fSnapshotOffsetY = fRefineOffsetY / kPreviewDownsample;
+			fPreviewBitmap = NULL;
+			return;
+		}
+	} else if (!fTileCacheEnabled && fRenderMode == SVG_RENDER_AGG) {
+		if (fRenderBitmap) {
+			fSnapshotBitmap = fRenderBitmap;
+			fRenderBitmap = NULL;
+			return;
+		}
+	}
 
-			uint8 contentA = contentRow[px * 4 + 3];
-			uint32 newAlpha = (contentA * maskOpacity) / 255;
+	// Rendering the whole document again would cost more than the scale
+	// changes save, so without a frame to reuse, in native mode for
+	// instance, nothing is captured and Draw() keeps drawing directly
+	if (fProgressive || !fTileCacheEnabled || fTileCount == 0
+		|| fTileScale != fScale
+		|| fTilePhaseX != fOffsetX - floorf(fOffsetX)
+		|| fTilePhaseY != fOffsetY - floorf(fOffsetY))
+		return;
 
-			contentRow[px * 4 + 3] = (uint8)newAlpha;
+	fSnapshotBitmap = new BBitmap(BRect(0, 0, width - 1, height - 1),
+		B_RGBA32);
+	if (!fSnapshotBitmap || fSnapshotBitmap->InitCheck() != B_OK) {
+		delete fSnapshotBitmap;
+		fSnapshotBitmap = NULL;
+		return;
+	}
+	fRenderStats.bitmapsAllocated++;
+	memset(fSnapshotBitmap->Bits(), 0, fSnapshotBitmap->BitsLength());
 
-			if (contentA > 0 && newAlpha < contentA) {
-				uint32 ratio = (newAlpha * 255) / contentA;
-				contentRow[px * 4 + 0] = (uint8)((contentRow[px * 4 + 0] * ratio) / 255);
-				contentRow[px * 4 + 1] = (uint8)((contentRow[px * 4 + 1] * ratio) / 255);
-				contentRow[px * 4 + 2] = (uint8)((contentRow[px * 4 + 2] * ratio) / 255);
-			}
-		}
+	int32 originX = (int32)floorf(fOffsetX - bounds.left);
+	int32 originY = (int32)floorf(fOffsetY - bounds.top);
+	for (int32 i = 0; i < fTileCount; i++) {
+		if (fTiles[i].x == INT32_MIN)
+			continue;
+		copy_bitmap(fSnapshotBitmap, fTiles[i].bitmap,
+			originX + fTiles[i].x * kTileSize,
+			originY + fTiles[i].y * kTileSize);
 	}
 }
 
 
 void
-BSVGView::_DrawShapeWithMask(NSVGshape* shape, int32 shapeIndex)
+BSVGView::_DrawSnapshot(BRect updateRect)
 {
-	NSVGmask* mask = shape->mask;
-	if (!mask || !mask->shapes)
+	// A snapshot pixel p shows the document point (p - offset) / scale
+	BRect bounds = Bounds();
+	BRect source = fSnapshotBitmap->Bounds();
+	float factor = fScale / fSnapshotScale;
+	float left = fOffsetX - fSnapshotOffsetX * factor;
+	float top = fOffsetY - fSnapshotOffsetY * factor;
+	BRect destination(left, top,
+		left + (source.Width() + 1) * factor - 1,
+		top + (source.Height() + 1) * factor - 1);
+	if (!destination.Intersects(updateRect & bounds))
 		return;
 
-	BRect viewBounds = Bounds();
-	BRect shapeBounds(
-		shape->bounds[0] * fScale + fOffsetX,
-		shape->bounds[1] * fScale + fOffsetY,
-		shape->bounds[2] * fScale + fOffsetX,
-		shape->bounds[3] * fScale + fOffsetY);
-
-	float expand = shape->strokeWidth * fScale * shape->miterLimit;
-	shapeBounds.InsetBy(-expand, -expand);
+	SetDrawingMode(B_OP_ALPHA);
+	SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+	DrawBitmap(fSnapshotBitmap, source, destination,
+		B_FILTER_BITMAP_BILINEAR);
+	fRenderStats.bytesUploaded += upload_size(source);
+}
 
-	if (!shapeBounds.Intersects(viewBounds))
-		return;
 
-	BRect renderBounds = shapeBounds & viewBounds;
-	if (!renderBounds.IsValid())
-		return;
+void
+BSVGView::_DrawTiles(BRect updateRect)
+{
+	_ValidateTileCache();
+	fTileFrame++;
 
-	int width = (int)ceilf(renderBounds.Width()) + 1;
-	int height = (int)ceilf(renderBounds.Height()) + 1;
+	BRect area = updateRect & Bounds();
+	float originX = floorf(fOffsetX);
+	float originY = floorf(fOffsetY);
 
-	if (width <= 0 || height <= 0)
+	BRect content = fDisplayListBounds.OffsetByCopy(fOffsetX, fOffsetY);
+	if (!area.IsValid() || !content.Intersects(area))
 		return;
+	area = area & content;
 
-	float downsample = 1.0f;
-	if (width > kMaxMaskDimension || height > kMaxMaskDimension) {
-		downsample = fmaxf((float)width / kMaxMaskDimension,
-						   (float)height / kMaxMaskDimension);
-		width = (int)(width / downsample);
-		height = (int)(height / downsample);
-	}
-
-	if (width <= 0)
-		width = 1;
-	if (height <= 0)
-		height = 1;
+	int32 firstX = (int32)floorf((area.left - originX) / kTileSize);
+	int32 firstY = (int32)floorf((area.top - originY) / kTileSize);
+	int32 lastX = (int32)floorf((area.right - originX) / kTileSize);
+	int32 lastY = (int32)floorf((area.bottom - originY) / kTileSize);
 
-	BBitmap* contentBitmap = new BBitmap(
-		BRect(0, 0, width - 1, height - 1), B_RGBA32);
-	if (!contentBitmap || contentBitmap->InitCheck() != B_OK) {
-		delete contentBitmap;
-		return;
-	}
+	SetDrawingMode(B_OP_ALPHA);
+	SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
+
+	for (int32 y = firstY; y <= lastY; y++) {
+		for (int32 x = firstX; x <= lastX; x++) {
+			SVGTile* tile = _FindTile(x, y);
+			if (!tile)
+				tile = _RenderTile(x, y);
+			if (!tile)
+				continue;
 
-	BBitmap* maskBitmap = new BBitmap(
-		BRect(0, 0, width - 1, height - 1), B_RGBA32);
-	if (!maskBitmap || maskBitmap->InitCheck() != B_OK) {
-		delete contentBitmap;
-		delete maskBitmap;
-		return;
+			tile->lastUsed = fTileFrame;
+			DrawBitmapAsync(tile->bitmap, BPoint(originX + x * kTileSize,
+				originY + y * kTileSize));
+			fRenderStats.tilesDrawn++;
+			fRenderStats.bytesUploaded += upload_size(tile->bitmap->Bounds());
+		}
 	}
 
-	memset(contentBitmap->Bits(), 0, contentBitmap->BitsLength());
-	memset(maskBitmap->Bits(), 0, maskBitmap->BitsLength());
-
-	BRect adjustedRenderBounds = renderBounds;
-	if (downsample > 1.0f) {
-		float savedScale = fScale;
-		fScale = fScale / downsample;
-
-		float savedOffsetX = fOffsetX;
-		float savedOffsetY = fOffsetY;
-		fOffsetX = (fOffsetX - renderBounds.left) / downsample;
-		fOffsetY = (fOffsetY - renderBounds.top) / downsample;
-
-		adjustedRenderBounds = BRect(0, 0, width - 1, height - 1);
+	Sync();
+}
 
-		_RenderShapeToBuffer(shape, contentBitmap, adjustedRenderBounds);
-		_RenderMaskToBuffer(mask, maskBitmap, adjustedRenderBounds);
 
-		fScale = savedScale;
-		fOffsetX = savedOffsetX;
-		fOffsetY = savedOffsetY;
-	} else {
-		_RenderShapeToBuffer(shape, contentBitmap, renderBounds);
-		_RenderMaskToBuffer(mask, maskBitmap, renderBounds);
+void
+BSVGView::_ValidateTileCache()
+{
+	float phaseX = fOffsetX - floorf(fOffsetX);
+	float phaseY = fOffsetY - floorf(fOffsetY);
+
+	if (fTileScale != fScale || fTilePhaseX != phaseX || fTilePhaseY != phaseY
+		|| fTileDisplayMode != fDisplayMode || fTileRenderMode != fRenderMode) {
+		_FlushTileCache();
+		fTileScale = fScale;
+		fTilePhaseX = phaseX;
+		fTilePhaseY = phaseY;
+		fTileDisplayMode = fDisplayMode;
+		fTileRenderMode = fRenderMode;
 	}
 
-	_ApplyMaskToBitmap(contentBitmap, maskBitmap);
-
-	SetDrawingMode(B_OP_ALPHA);
-	DrawBitmap(contentBitmap, contentBitmap->Bounds(), renderBounds);
+	int32 capacity = fTileCacheLimit / (kTileSize * kTileSize * 4);
+	if (capacity < 1)
+		capacity = 1;
 
-	delete contentBitmap;
-	delete maskBitmap;
+	if (capacity != fTileCapacity) {
+		_FlushTileCache();
+		delete[] fTiles;
+		fTiles = new SVGTile[capacity];
+		fTileCapacity = fTiles ? capacity : 0;
+	}
 }
 
 
 void
-BSVGView::_DrawShape(NSVGshape* shape, int32 shapeIndex)
+BSVGView::_FlushTileCache()
 {
-	if (!shape)
-		return;
+	for (int32 i = 0; i < fTileCount; i++)
+		delete fTiles[i].bitmap;
+	fTileCount = 0;
+}
 
-	if (shape->mask != NULL && shape->mask->shapes != NULL) {
-		_DrawShapeWithMask(shape, shapeIndex);
-		return;
-	}
 
-	BRect viewBounds = Bounds();
-	BRect shapeBounds(
-		shape->bounds[0] * fScale + fOffsetX,
-		shape->bounds[1] * fScale + fOffsetY,
-		shape->bounds[2] * fScale + fOffsetX,
-		shape->bounds[3] * fScale + fOffsetY);
+SVGTile*
+BSVGView::_FindTile(int32 x, int32 y)
+{
+	for (int32 i = 0; i < fTileCount; i++) {
+		if (fTiles[i].x == x && fTiles[i].y == y)
+			return &fTiles[i];
+	}
+	return NULL;
+}
 
-	float expand = shape->strokeWidth * fScale * shape->miterLimit;
-	shapeBounds.InsetBy(-expand, -expand);
 
-	if (!shapeBounds.Intersects(viewBounds))
-		return;
+SVGTile*
+BSVGView::_RenderTile(int32 x, int32 y)
+{
+	if (fTileCapacity == 0)
+		return NULL;
 
-	SetDrawingMode(B_OP_ALPHA);
+	BRect tileRect(0, 0, kTileSize - 1, kTileSize - 1);
 
-	bool drawFill = (fDisplayMode == SVG_DISPLAY_NORMAL
-		|| fDisplayMode == SVG_DISPLAY_FILL_ONLY);
-	bool drawStroke = (fDisplayMode == SVG_DISPLAY_NORMAL
-		|| fDisplayMode == SVG_DISPLAY_STROKE_ONLY);
-	bool drawOutline = (fDisplayMode == SVG_DISPLAY_OUTLINE);
+	if (fRenderMode == SVG_RENDER_NATIVE && !fTileRenderBitmap) {
+		fTileRenderBitmap = new BBitmap(tileRect, B_BITMAP_ACCEPTS_VIEWS,
+			B_RGBA32);
+		fRenderStats.bitmapsAllocated++;
+		if (!fTileRenderBitmap || fTileRenderBitmap->InitCheck() != B_OK) {
+			delete fTileRenderBitmap;
+			fTileRenderBitmap = NULL;
+			return NULL;
+		}
+		fTileRenderView = new BView(tileRect, "svg tile", B_FOLLOW_NONE,
+			B_WILL_DRAW);
+		fTileRenderBitmap->AddChild(fTileRenderView);
+	}
 
-	if (drawOutline) {
-		PushState();
-		SetHighColor(0, 0, 0);
-		SetPenSize(1.0f);
-		SetLineMode(B_BUTT_CAP, B_MITER_JOIN, 4.0f);
-
-		for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
-			BShape bShape;
-			_ConvertPath(path, bShape);
-			StrokeShape(&bShape);
+	SVGTile* tile;
+	if (fTileCount < fTileCapacity) {
+		tile = &fTiles[fTileCount];
+		tile->bitmap = new BBitmap(tileRect, B_RGBA32);
+		fRenderStats.bitmapsAllocated++;
+		if (!tile->bitmap || tile->bitmap->InitCheck() != B_OK) {
+			delete tile->bitmap;
+			return NULL;
+		}
+		fTileCount++;
+	} else {
+		tile = &fTiles[0];
+		for (int32 i = 1; i < fTileCount; i++) {
+			if (fTiles[i].lastUsed < tile->lastUsed)
+				tile = &fTiles[i];
 		}
+		// The victim may still be queued for drawing in this frame
+		if (tile->lastUsed == fTileFrame)
+			Sync();
+	}
 
-		PopState();
-		return;
+	// Until it is rendered again the slot must not match any position
+	tile->x = INT32_MIN;
+	tile->lastUsed = fTileFrame;
+	fRenderStats.tilesRendered++;
+
+	if (fRenderMode == SVG_RENDER_AGG) {
+		SVGRenderBuffer buffer((uint8*)tile->bitmap->Bits(), kTileSize,
+			kTileSize, tile->bitmap->BytesPerRow());
+		memset(buffer.bits, 0, tile->bitmap->BitsLength());
+		fRenderer.Render(buffer, fScale, fTilePhaseX - x * kTileSize,
+			fTilePhaseY - y * kTileSize);
+		fRenderStats.shapesSkipped += fRenderer.CountSkipped();
+		tile->x = x;
+		tile->y = y;
+		return tile;
 	}
 
-	if (drawFill && shape->fill.type != NSVG_PAINT_NONE && shape->paths) {
-		PushState();
+	if (!fTileRenderBitmap->Lock())
+		return NULL;
 
-		BShape fillShape;
-		for (NSVGpath* path = shape->paths; path != NULL; path = path->next)
-			_ConvertPath(path, fillShape);
+	memset(fTileRenderBitmap->Bits(), 0, fTileRenderBitmap->BitsLength());
 
-		BRect fillBounds = fillShape.Bounds();
+	fTileRenderView->PushState();
+	fTileRenderView->SetDrawingMode(B_OP_ALPHA);
+	fTileRenderView->SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_COMPOSITE);
 
-		switch (shape->fill.type) {
-			case NSVG_PAINT_COLOR:
-			{
-				rgb_color color = _ConvertColor(shape->fill.color, shape->opacity);
-				SetHighColor(color);
-				FillShape(&fillShape);
-				break;
-			}
+	float savedOffsetX = fOffsetX;
+	float savedOffsetY = fOffsetY;
+	fOffsetX = fTilePhaseX - x * kTileSize;
+	fOffsetY = fTilePhaseY - y * kTileSize;
 
-			case NSVG_PAINT_LINEAR_GRADIENT:
-			case NSVG_PAINT_RADIAL_GRADIENT:
-			{
-				BGradient* gradient = NULL;
-				_SetupGradient(shape->fill.gradient, fillBounds,
-					shape->fill.type, &gradient, shape->opacity);
-
-				if (gradient) {
-					FillShape(&fillShape, *gradient);
-					delete gradient;
-				} else {
-					if (!fillBounds.Intersects(viewBounds))
-						break;
-
-					BRect clippedBounds = fillBounds & viewBounds;
-					if (!clippedBounds.IsValid())
-						break;
-
-					BBitmap* gradientBitmap = _RasterizeGradient(
-						shape->fill.gradient, shape->fill.type,
-						fillBounds, clippedBounds, shape->opacity);
-
-					if (gradientBitmap) {
-						_FillShapeWithGradientBitmap(fillShape,
-							gradientBitmap, fillBounds, clippedBounds);
-						delete gradientBitmap;
-					} else if (shape->fill.gradient
-						&& shape->fill.gradient->nstops > 0) {
-						rgb_color color = _ConvertColor(
-							shape->fill.gradient->stops[0].color,
-							shape->opacity);
-						SetHighColor(color);
-						FillShape(&fillShape);
-					}
-				}
-				break;
-			}
+	int32 count = _QueryDisplayItems(tileRect);
+	for (int32 i = 0; i < count; i++) {
+		_DrawDisplayItem(fTileRenderView, fDisplayList[fVisibleItems[i]],
+			tileRect);
+	}
 
-			default:
-				break;
-		}
+	fOffsetX = savedOffsetX;
+	fOffsetY = savedOffsetY;
 
-		PopState();
-	}
+	fTileRenderView->PopState();
+	fTileRenderView->Sync();
 
-	if (drawStroke && shape->stroke.type != NSVG_PAINT_NONE
-		&& shape->strokeWidth > 0.0f) {
+	uint8* src = (uint8*)fTileRenderBitmap->Bits();
+	uint8* dst = (uint8*)tile->bitmap->Bits();
+	int32 srcBpr = fTileRenderBitmap->BytesPerRow();
+	int32 dstBpr = tile->bitmap->BytesPerRow();
+	for (int32 row = 0; row < kTileSize; row++)
+		memcpy(dst + row * dstBpr, src + row * srcBpr, kTileSize * 4);
 
-		switch (shape->stroke.type) {
-			case NSVG_PAINT_COLOR:
-			{
-				PushState();
-				_SetupStrokeStyle(shape);
+	fTileRenderBitmap->Unlock();
 
-				rgb_color color = _ConvertColor(shape->stroke.color, shape->opacity);
-				SetHighColor(color);
+	tile->x = x;
+	tile->y = y;
+	return tile;
+}
 
-				for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
-					BShape strokeShape;
-					_ConvertPath(path, strokeShape);
-					StrokeShape(&strokeShape);
-				}
 
-				PopState();
-				break;
-			}
+// Only the old and the new highlight area are redrawn. The document below
+// comes from the tile cache, or from the shapes the spatial index finds
+// in that area.
+void
+BSVGView::_SetHighlight(const HighlightInfo& info)
+{
+	BRect dirty = _HighlightBounds(fHighlightInfo);
+	fHighlightInfo = info;
+	BRect bounds = _HighlightBounds(fHighlightInfo);
+	if (!dirty.IsValid())
+		dirty = bounds;
+	else if (bounds.IsValid())
+		dirty = dirty | bounds;
 
-			case NSVG_PAINT_LINEAR_GRADIENT:
-			case NSVG_PAINT_RADIAL_GRADIENT:
-			{
-				BShape* strokeAsFill = _ConvertStrokeToFillShape(shape);
-				if (!strokeAsFill) {
-					if (shape->stroke.gradient && shape->stroke.gradient->nstops > 0) {
-						PushState();
-						_SetupStrokeStyle(shape);
-						int midIdx = shape->stroke.gradient->nstops / 2;
-						rgb_color color = _ConvertColor(
-							shape->stroke.gradient->stops[midIdx].color,
-							shape->opacity);
-						SetHighColor(color);
-						for (NSVGpath* path = shape->paths; path != NULL;
-							path = path->next) {
-							BShape strokeShape;
-							_ConvertPath(path, strokeShape);
-							StrokeShape(&strokeShape);
-						}
-						PopState();
-					}
-					break;
-				}
+	if (!dirty.IsValid())
+		return;
 
-				BRect strokeFillBounds = strokeAsFill->Bounds();
-
-				BGradient* gradient = NULL;
-				_SetupGradient(shape->stroke.gradient, strokeFillBounds,
-					shape->stroke.type, &gradient, shape->opacity);
-
-				if (gradient) {
-					PushState();
-					SetDrawingMode(B_OP_ALPHA);
-					FillShape(strokeAsFill, *gradient);
-					PopState();
-					delete gradient;
-					delete strokeAsFill;
-				} else {
-					delete strokeAsFill;
-					_StrokeShapeWithRasterizedGradient(shape, shape->stroke.type);
-				}
-				break;
-			}
+	// The statistics overlay would be left half updated otherwise. Its
+	// width follows the text, so the band up to the right edge is redrawn.
+	if (fShowRenderStats && fRenderStatsFrame.IsValid()) {
+		BRect band = fRenderStatsFrame;
+		band.right = fmaxf(band.right, Bounds().right);
+		Invalidate(band);
+	}
+	Invalidate(dirty);
+}
 
-			default:
-			{
-				PushState();
-				_SetupStrokeStyle(shape);
-				SetHighColor(0, 0, 0);
-
-				for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
-					BShape strokeShape;
-					_ConvertPath(path, strokeShape);
-					StrokeShape(&strokeShape);
-				}
 
-				PopState();
-				break;
+// View area of everything _DrawHighlight() draws for the given highlight
+BRect
+BSVGView::_HighlightBounds(const HighlightInfo& info) const
+{
+	if (info.mode == SVG_HIGHLIGHT_NONE || !fSVGImage
+		|| info.shapeIndex < 0 || info.shapeIndex >= fGeometry.CountShapes())
+		return BRect();
+
+	int32 ranges[2][2] = { { 0, 0 }, { 0, 0 } };
+	if (info.mode == SVG_HIGHLIGHT_SHAPE) {
+		ranges[0][0] = fGeometry.ShapeFirstPath(info.shapeIndex);
+		ranges[0][1] = ranges[0][0]
+			+ fGeometry.ShapePathCount(info.shapeIndex);
+
+		int32 mask = fGeometry.ShapeMask(info.shapeIndex);
+		if (mask >= 0 && fGeometry.MaskShapeCount(mask) > 0) {
+			int32 firstShape = fGeometry.MaskFirstShape(mask);
+			int32 lastShape = firstShape + fGeometry.MaskShapeCount(mask) - 1;
+			ranges[1][0] = fGeometry.ShapeFirstPath(firstShape);
+			ranges[1][1] = fGeometry.ShapeFirstPath(lastShape)
+				+ fGeometry.ShapePathCount(lastShape);
+		}
+	} else {
+		if (info.pathIndex < 0
+			|| info.pathIndex >= fGeometry.ShapePathCount(info.shapeIndex))
+			return BRect();
+		ranges[0][0] = fGeometry.ShapeFirstPath(info.shapeIndex)
+			+ info.pathIndex;
+		ranges[0][1] = ranges[0][0] + 1;
+	}
+
+	// The control points contain the curves, and they are drawn too
+	float left = HUGE_VALF;
+	float top = HUGE_VALF;
+	float right = -HUGE_VALF;
+	float bottom = -HUGE_VALF;
+	for (int32 range = 0; range < 2; range++) {
+		for (int32 path = ranges[range][0]; path < ranges[range][1];
+				path++) {
+			const float* pt = fGeometry.PathPoints(path);
+			int32 count = fGeometry.PathPointCount(path);
+			for (int32 i = 0; i < count; i++, pt += 2) {
+				left = fminf(left, pt[0]);
+				top = fminf(top, pt[1]);
+				right = fmaxf(right, pt[0]);
+				bottom = fmaxf(bottom, pt[1]);
 			}
 		}
 	}
+	if (left > right || top > bottom)
+		return BRect();
+
+	// Half of the widest outline pen or of a control point, and a pixel
+	// of antialiasing
+	float margin = fmaxf(3.0f, _GetControlPointSize() / 2 + 1.5f) + 1.0f;
+	return BRect(floorf(left * fScale + fOffsetX - margin),
+		floorf(top * fScale + fOffsetY - margin),
+		ceilf(right * fScale + fOffsetX + margin),
+		ceilf(bottom * fScale + fOffsetY + margin));
 }
 
 
 void
-BSVGView::_DrawHighlight()
+BSVGView::_DrawHighlight(BRect updateRect)
 {
 	if (fHighlightInfo.mode == SVG_HIGHLIGHT_NONE || !fSVGImage)
 		return;
 
-	int32 currentIndex = 0;
-	NSVGshape* shape = fSVGImage->shapes;
-
-	while (shape && currentIndex < fHighlightInfo.shapeIndex) {
-		shape = shape->next;
-		currentIndex++;
-	}
+	int32 shapeIndex = fHighlightInfo.shapeIndex;
+	if (shapeIndex < 0 || shapeIndex >= fGeometry.CountShapes())
+		return;
 
-	if (!shape)
+	if (!_HighlightBounds(fHighlightInfo).Intersects(updateRect))
 		return;
 
 	PushState();
 	SetDrawingMode(B_OP_ALPHA);
 
 	if (fHighlightInfo.mode == SVG_HIGHLIGHT_SHAPE) {
-		_DrawShapeHighlight(shape);
-	} else if (fHighlightInfo.mode == SVG_HIGHLIGHT_PATH
-		|| fHighlightInfo.mode == SVG_HIGHLIGHT_CONTROL_POINTS) {
-		int32 pathIndex = 0;
-		NSVGpath* path = shape->paths;
-
-		while (path && pathIndex < fHighlightInfo.pathIndex) {
-			path = path->next;
-			pathIndex++;
-		}
+		_DrawShapeHighlight(shapeIndex);
+	} else if ((fHighlightInfo.mode == SVG_HIGHLIGHT_PATH
+			|| fHighlightInfo.mode == SVG_HIGHLIGHT_CONTROL_POINTS)
+		&& fHighlightInfo.pathIndex >= 0
+		&& fHighlightInfo.pathIndex < fGeometry.ShapePathCount(shapeIndex)) {
+		int32 path = fGeometry.ShapeFirstPath(shapeIndex)
+			+ fHighlightInfo.pathIndex;
 
-		if (path) {
-			_DrawPathHighlight(shape, path);
+		_DrawPathHighlight(path);
 
-			if (fHighlightInfo.showControlPoints)
-				_DrawControlPoints(path);
+		if (fHighlightInfo.showControlPoints)
+			_DrawControlPoints(path);
 
-			if (fHighlightInfo.showBezierHandles)
-				_DrawBezierHandles(path);
-		}
+		if (fHighlightInfo.showBezierHandles)
+			_DrawBezierHandles(path);
 	}
 
 	PopState();
@@ -1348,42 +3459,49 @@ BSVGView::_DrawHighlight()
 
 
 void
-BSVGView::_DrawShapeHighlight(NSVGshape* shape)
+BSVGView::_DrawShapeHighlight(int32 shapeIndex)
 {
-	if (!shape)
+	if (shapeIndex < 0)
 		return;
 
-	for (NSVGpath* path = shape->paths; path != NULL; path = path->next)
+	int32 firstPath = fGeometry.ShapeFirstPath(shapeIndex);
+	int32 endPath = firstPath + fGeometry.ShapePathCount(shapeIndex);
+	for (int32 path = firstPath; path < endPath; path++)
 		_DrawHighlightOutline(path, 4.0f);
 
-	if (shape->mask != NULL && shape->mask->shapes != NULL) {
-		for (NSVGshape* maskShape = shape->mask->shapes; maskShape != NULL;
-			 maskShape = maskShape->next) {
-			for (NSVGpath* path = maskShape->paths; path != NULL; path = path->next)
-				_DrawHighlightOutline(path, 4.0f);
-		}
+	int32 mask = fGeometry.ShapeMask(shapeIndex);
+	if (mask >= 0) {
+		int32 firstShape = fGeometry.MaskFirstShape(mask);
+		int32 endShape = firstShape + fGeometry.MaskShapeCount(mask);
+		firstPath = fGeometry.ShapeFirstPath(firstShape);
+		endPath = endShape > firstShape
+			? fGeometry.ShapeFirstPath(endShape - 1)
+				+ fGeometry.ShapePathCount(endShape - 1)
+			: firstPath;
+		for (int32 path = firstPath; path < endPath; path++)
+			_DrawHighlightOutline(path, 4.0f);
 	}
 }
 
 
 void
-BSVGView::_DrawPathHighlight(NSVGshape* shape, NSVGpath* path)
+BSVGView::_DrawPathHighlight(int32 pathIndex)
 {
-	if (!path)
+	if (pathIndex < 0)
 		return;
 
-	_DrawHighlightOutline(path, 3.0f);
+	_DrawHighlightOutline(pathIndex, 3.0f);
 }
 
 
 void
-BSVGView::_DrawHighlightOutline(NSVGpath* path, float width)
+BSVGView::_DrawHighlightOutline(int32 pathIndex, float width)
 {
-	if (!path || path->npts < 2)
+	if (pathIndex < 0 || fGeometry.PathPointCount(pathIndex) < 2)
 		return;
 
 	BShape highlightShape;
-	_ConvertPath(path, highlightShape);
+	_ConvertPath(pathIndex, highlightShape);
 
 	SetHighColor(255, 255, 255, 180);
 	SetPenSize(width + 2.0f);
@@ -1393,17 +3511,20 @@ BSVGView::_DrawHighlightOutline(NSVGpath* path, float width)
 	SetHighColor(255, 100, 0, 220);
 	SetPenSize(width);
 	StrokeShape(&highlightShape);
+	fRenderStats.strokeShapeCalls += 2;
 }
 
 
 void
-BSVGView::_DrawControlPoints(NSVGpath* path)
+BSVGView::_DrawControlPoints(int32 pathIndex)
 {
-	if (!path)
+	if (pathIndex < 0)
 		return;
 
-	for (int i = 0; i < path->npts; i++) {
-		BPoint point = _ConvertSVGPoint(path->pts[i * 2], path->pts[i * 2 + 1]);
+	const float* pts = fGeometry.PathPoints(pathIndex);
+	int32 count = fGeometry.PathPointCount(pathIndex);
+	for (int i = 0; i < count; i++) {
+		BPoint point = _ConvertSVGPoint(pts[i * 2], pts[i * 2 + 1]);
 		bool isEndPoint = (i == 0) || ((i > 0) && ((i - 1) % 3 == 2));
 		_DrawControlPoint(point, isEndPoint, false);
 	}
@@ -1411,26 +3532,29 @@ BSVGView::_DrawControlPoints(NSVGpath* path)
 
 
 void
-BSVGView::_DrawBezierHandles(NSVGpath* path)
+BSVGView::_DrawBezierHandles(int32 pathIndex)
 {
-	if (!path)
+	if (pathIndex < 0)
 		return;
 
-	for (int i = 0; i < path->npts; i += 3) {
-		if (i + 2 < path->npts) {
-			BPoint anchor1 = _ConvertSVGPoint(path->pts[i * 2],
-				path->pts[i * 2 + 1]);
-			BPoint control1 = _ConvertSVGPoint(path->pts[(i + 1) * 2],
-				path->pts[(i + 1) * 2 + 1]);
-			BPoint control2 = _ConvertSVGPoint(path->pts[(i + 2) * 2],
-				path->pts[(i + 2) * 2 + 1]);
+	const float* pts = fGeometry.PathPoints(pathIndex);
+	int32 count = fGeometry.PathPointCount(pathIndex);
+	bool closed = fGeometry.IsPathClosed(pathIndex);
+
+	for (int i = 0; i < count; i += 3) {
+		if (i + 2 < count) {
+			BPoint anchor1 = _ConvertSVGPoint(pts[i * 2], pts[i * 2 + 1]);
+			BPoint control1 = _ConvertSVGPoint(pts[(i + 1) * 2],
+				pts[(i + 1) * 2 + 1]);
+			BPoint control2 = _ConvertSVGPoint(pts[(i + 2) * 2],
+				pts[(i + 2) * 2 + 1]);
 
 			BPoint anchor2;
-			if (i + 3 < path->npts) {
-				anchor2 = _ConvertSVGPoint(path->pts[(i + 3) * 2],
-					path->pts[(i + 3) * 2 + 1]);
-			} else if (path->closed && path->npts > 3) {
-				anchor2 = _ConvertSVGPoint(path->pts[0], path->pts[1]);
+			if (i + 3 < count) {
+				anchor2 = _ConvertSVGPoint(pts[(i + 3) * 2],
+					pts[(i + 3) * 2 + 1]);
+			} else if (closed && count > 3) {
+				anchor2 = _ConvertSVGPoint(pts[0], pts[1]);
 			} else {
 				continue;
 			}
@@ -1514,29 +3638,35 @@ BSVGView::_GetControlPointSize() const
 
 
 void
-BSVGView::_ConvertPath(NSVGpath* path, BShape& shape)
+BSVGView::_ConvertPath(int32 pathIndex, BShape& shape)
 {
-	if (!path || path->npts < 2)
-		return;
+	const SVGPolyline* polyline = fPolylineCache.Polyline(
+		fGeometry.PathShape(pathIndex), fScale);
+	if (polyline != NULL)
+		_ConvertPolyline(*polyline, pathIndex, shape);
+}
+
 
-	BPoint startPoint(path->pts[0] * fScale + fOffsetX,
-		path->pts[1] * fScale + fOffsetY);
-	shape.MoveTo(startPoint);
+// Hands app_server line segments only, so it does not subdivide the
+// curves again on every frame
+void
+BSVGView::_ConvertPolyline(const SVGPolyline& polyline, int32 pathIndex,
+	BShape& shape)
+{
+	int32 count = polyline.PathPointCount(pathIndex);
+	if (count < 2)
+		return;
 
-	for (int i = 1; i < path->npts; i += 3) {
-		if (i + 2 < path->npts) {
-			BPoint control1(path->pts[i * 2] * fScale + fOffsetX,
-				path->pts[i * 2 + 1] * fScale + fOffsetY);
-			BPoint control2(path->pts[(i + 1) * 2] * fScale + fOffsetX,
-				path->pts[(i + 1) * 2 + 1] * fScale + fOffsetY);
-			BPoint endPoint(path->pts[(i + 2) * 2] * fScale + fOffsetX,
-				path->pts[(i + 2) * 2 + 1] * fScale + fOffsetY);
+	const float* pt = polyline.PathPoints(pathIndex);
+	shape.MoveTo(BPoint(pt[0] * fScale + fOffsetX, pt[1] * fScale + fOffsetY));
 
-			shape.BezierTo(control1, control2, endPoint);
-		}
+	for (int i = 1; i < count; i++) {
+		pt += 2;
+		shape.LineTo(BPoint(pt[0] * fScale + fOffsetX,
+			pt[1] * fScale + fOffsetY));
 	}
 
-	if (path->closed)
+	if (fGeometry.IsPathClosed(pathIndex))
 		shape.Close();
 }
 
@@ -1571,21 +3701,12 @@ BSVGView::_SetupGradient(NSVGgradient* gradient, BRect bounds, char gradientType
 
 	float* t = gradient->xform;
 
-	double det = (double)t[0] * t[3] - (double)t[2] * t[1];
-	if (fabs(det) < 1e-6) {
+	float inv[6];
+	if (!_GradientInverse(gradient, inv)) {
 		*outGradient = NULL;
 		return;
 	}
 
-	double invdet = 1.0 / det;
-	float inv[6];
-	inv[0] = (float)(t[3] * invdet);
-	inv[1] = (float)(-t[1] * invdet);
-	inv[2] = (float)(-t[2] * invdet);
-	inv[3] = (float)(t[0] * invdet);
-	inv[4] = (float)(((double)t[2] * t[5] - (double)t[3] * t[4]) * invdet);
-	inv[5] = (float)(((double)t[1] * t[4] - (double)t[0] * t[5]) * invdet);
-
 	BGradient* bgradient = NULL;
 
 	if (gradientType == NSVG_PAINT_LINEAR_GRADIENT) {
@@ -1665,67 +3786,11 @@ BSVGView::_ConvertColor(unsigned int color, float opacity)
 }
 
 
-rgb_color
-BSVGView::_InterpolateGradientColor(NSVGgradient* gradient, float t, float opacity)
-{
-	if (!gradient || gradient->nstops == 0)
-		return (rgb_color){0, 0, 0, 0};
-
-	if (t < 0.0f)
-		t = 0.0f;
-	if (t > 1.0f)
-		t = 1.0f;
-
-	int stop0 = 0;
-	int stop1 = gradient->nstops - 1;
-
-	for (int i = 0; i < gradient->nstops - 1; i++) {
-		if (t >= gradient->stops[i].offset && t <= gradient->stops[i + 1].offset) {
-			stop0 = i;
-			stop1 = i + 1;
-			break;
-		}
-	}
-
-	float offset0 = gradient->stops[stop0].offset;
-	float offset1 = gradient->stops[stop1].offset;
-	float range = offset1 - offset0;
-	float localT = (range > 0.0001f) ? (t - offset0) / range : 0.0f;
-	if (localT < 0.0f)
-		localT = 0.0f;
-	if (localT > 1.0f)
-		localT = 1.0f;
-
-	unsigned int c0 = gradient->stops[stop0].color;
-	unsigned int c1 = gradient->stops[stop1].color;
-
-	uint8 r0 = (c0 >> 0) & 0xFF;
-	uint8 g0 = (c0 >> 8) & 0xFF;
-	uint8 b0 = (c0 >> 16) & 0xFF;
-	uint8 a0 = (c0 >> 24) & 0xFF;
-
-	uint8 r1 = (c1 >> 0) & 0xFF;
-	uint8 g1 = (c1 >> 8) & 0xFF;
-	uint8 b1 = (c1 >> 16) & 0xFF;
-	uint8 a1 = (c1 >> 24) & 0xFF;
-
-	rgb_color result;
-	result.red = (uint8)(r0 + (int)(r1 - r0) * localT);
-	result.green = (uint8)(g0 + (int)(g1 - g0) * localT);
-	result.blue = (uint8)(b0 + (int)(b1 - b0) * localT);
-
-	float alpha0 = a0 / 255.0f;
-	float alpha1 = a1 / 255.0f;
-	float interpolatedAlpha = alpha0 + (alpha1 - alpha0) * localT;
-	result.alpha = (uint8)(interpolatedAlpha * opacity * 255.0f);
-
-	return result;
-}
-
-
+// Renders into a scratch pool bitmap, the caller releases it. Only the
+// returned area of the bitmap is used.
 BBitmap*
 BSVGView::_RasterizeGradient(NSVGgradient* gradient, char gradientType,
-	BRect shapeBounds, BRect clippedBounds, float shapeOpacity)
+	BRect shapeBounds, BRect clippedBounds, float shapeOpacity, BRect& area)
 {
 	if (!gradient)
 		return NULL;
@@ -1751,118 +3816,36 @@ BSVGView::_RasterizeGradient(NSVGgradient* gradient, char gradientType,
 	if (height < 1)
 		height = 1;
 
-	BBitmap* bitmap = new BBitmap(BRect(0, 0, width - 1, height - 1), B_RGBA32);
-	if (!bitmap || bitmap->InitCheck() != B_OK) {
-		delete bitmap;
+	BBitmap* bitmap = fScratchPool.AcquireBitmap(width, height);
+	if (!bitmap)
 		return NULL;
-	}
+	area.Set(0, 0, width - 1, height - 1);
 
 	uint8* bits = (uint8*)bitmap->Bits();
 	int32 bpr = bitmap->BytesPerRow();
 
-	GradientLUT lut;
-	_BuildGradientLUT(gradient, shapeOpacity, lut);
-
-	float* m = gradient->xform;
 	float invScale = 1.0f / fScale;
 	float baseX = (clippedBounds.left - fOffsetX) * invScale;
 	float baseY = (clippedBounds.top - fOffsetY) * invScale;
 	float stepX = downsample * invScale;
 	float stepY = downsample * invScale;
 
-	if (gradientType == NSVG_PAINT_LINEAR_GRADIENT) {
-		float dtdx = m[1] * stepX;
-		float dtdy = m[3] * stepY;
-		float tBase = m[1] * baseX + m[3] * baseY + m[5];
-
-		for (int py = 0; py < height; py++) {
-			uint8* row = bits + py * bpr;
-			float tRow = tBase + dtdy * py;
-
-			for (int px = 0; px < width; px++) {
-				float t = _ApplySpreadMode(gradient->spread, tRow);
-
-				int idx = (int)(t * 255.0f + 0.5f);
-				if (idx < 0)
-					idx = 0;
-				if (idx > 255)
-					idx = 255;
-
-				rgb_color color = lut.colors[idx];
+	uint8 buffer[256 * 4];
+	const uint8* pixels = _GradientTable(gradient, shapeOpacity, buffer);
 
-				row[px * 4 + 0] = color.blue;
-				row[px * 4 + 1] = color.green;
-				row[px * 4 + 2] = color.red;
-				row[px * 4 + 3] = color.alpha;
+	SVGGradientRow row;
+	row.lut = pixels;
+	row.xform = gradient->xform;
+	row.type = gradientType;
+	row.spread = gradient->spread;
+	row.fx = gradient->fx;
+	row.fy = gradient->fy;
+	row.startX = baseX;
+	row.stepX = stepX;
 
-				tRow += dtdx;
-			}
-		}
-	} else {
-		float fx = gradient->fx;
-		float fy = gradient->fy;
-		float focalDist = sqrtf(fx * fx + fy * fy);
-		bool hasFocalPoint = focalDist >= 0.001f;
-
-		for (int py = 0; py < height; py++) {
-			uint8* row = bits + py * bpr;
-			float svgY = baseY + py * stepY;
-
-			for (int px = 0; px < width; px++) {
-				float svgX = baseX + px * stepX;
-
-				float gx = m[0] * svgX + m[2] * svgY + m[4];
-				float gy = m[1] * svgX + m[3] * svgY + m[5];
-
-				float t;
-
-				if (!hasFocalPoint) {
-					t = sqrtf(gx * gx + gy * gy);
-				} else {
-					float angle = atan2f(gy, gx);
-					float cosA = cosf(angle);
-					float sinA = sinf(angle);
-
-					float a = 1.0f;
-					float b = -2.0f * (fx * cosA + fy * sinA);
-					float c = fx * fx + fy * fy - 1.0f;
-					float discriminant = b * b - 4.0f * a * c;
-
-					if (discriminant >= 0) {
-						float sqrtD = sqrtf(discriminant);
-						float t1 = (-b + sqrtD) / (2.0f * a);
-						float t2 = (-b - sqrtD) / (2.0f * a);
-						float edgeDist = (t1 > 0) ? t1 : t2;
-
-						float focalToPoint = sqrtf((gx - fx) * (gx - fx)
-							+ (gy - fy) * (gy - fy));
-						float focalToEdgeX = edgeDist * cosA - fx;
-						float focalToEdgeY = edgeDist * sinA - fy;
-						float focalToEdge = sqrtf(focalToEdgeX * focalToEdgeX
-							+ focalToEdgeY * focalToEdgeY);
-
-						t = (focalToEdge > 0.001f) ? focalToPoint / focalToEdge : 0.0f;
-					} else {
-						t = sqrtf(gx * gx + gy * gy);
-					}
-				}
-
-				t = _ApplySpreadMode(gradient->spread, t);
-
-				int idx = (int)(t * 255.0f + 0.5f);
-				if (idx < 0)
-					idx = 0;
-				if (idx > 255)
-					idx = 255;
-
-				rgb_color color = lut.colors[idx];
-
-				row[px * 4 + 0] = color.blue;
-				row[px * 4 + 1] = color.green;
-				row[px * 4 + 2] = color.red;
-				row[px * 4 + 3] = color.alpha;
-			}
-		}
+	for (int py = 0; py < height; py++) {
+		row.y = baseY + py * stepY;
+		svg_gradient_fill_row(row, bits + py * bpr, width);
 	}
 
 	return bitmap;
@@ -1870,34 +3853,23 @@ BSVGView::_RasterizeGradient(NSVGgradient* gradient, char gradientType,
 
 
 void
-BSVGView::_FillShapeWithGradientBitmap(BShape& shape, BBitmap* bitmap,
-	BRect shapeBounds, BRect clippedBounds)
+BSVGView::_FillShapeWithGradientBitmap(BView* target, BShape& shape,
+	BBitmap* bitmap, BRect source, BRect clippedBounds)
 {
 	if (!bitmap)
 		return;
 
-	PushState();
-
-	ClipToShape(&shape);
-
-	SetDrawingMode(B_OP_ALPHA);
-	DrawBitmap(bitmap, bitmap->Bounds(), clippedBounds);
-
-	PopState();
-}
+	// The caller has already moved the origin to the display list space
+	target->PushState();
 
+	target->ClipToShape(&shape);
 
-void
-BSVGView::_SetupStrokeStyle(NSVGshape* shape)
-{
-	float scaledWidth = shape->strokeWidth * fScale;
-	if (scaledWidth < 0.1f)
-		scaledWidth = 0.1f;
-	SetPenSize(scaledWidth);
+	target->SetDrawingMode(B_OP_ALPHA);
+	target->DrawBitmap(bitmap, source,
+		clippedBounds.OffsetByCopy(-fOffsetX, -fOffsetY));
+	fRenderStats.bytesUploaded += upload_size(source);
 
-	SetLineMode(_ConvertLineCapHaiku(shape->strokeLineCap),
-		_ConvertLineJoinHaiku(shape->strokeLineJoin),
-		_ClampMiterLimit(shape->miterLimit));
+	target->PopState();
 }
 
 
@@ -1935,25 +3907,62 @@ BSVGView::_CalculateAutoScale()
 
 
 void
-BSVGView::_DrawTransparencyGrid()
+BSVGView::_DrawTransparencyGrid(BRect updateRect)
 {
-	float cellSize = 24.0f;
-	BRect bounds = Bounds();
+	BRegion region(updateRect & Bounds());
 
-	int cols = (int)ceilf(bounds.Width() / cellSize) + 1;
-	int rows = (int)ceilf(bounds.Height() / cellSize) + 1;
+	// The document style paints the document area opaque; the inset keeps
+	// its fractional edges covered
+	if (fSVGImage && fBoundingBoxStyle == SVG_BBOX_DOCUMENT)
+		region.Exclude(SVGViewBounds().InsetByCopy(1, 1));
 
-	for (int x = 0; x < cols; x++) {
-		for (int y = 0; y < rows; y++) {
-			if ((x + y) % 2)
-				SetHighColor(230, 230, 230);
-			else
-				SetHighColor(200, 200, 200);
+	if (region.CountRects() == 0
+		|| (fGridBitmap == NULL && !_CreateGridBitmap()))
+		return;
+
+	// The cells stay anchored to the view origin, so the pattern bitmap
+	// is drawn at multiples of its size
+	PushState();
+	SetDrawingMode(B_OP_COPY);
+	float size = kGridPatternSize;
+	for (int32 i = 0; i < region.CountRects(); i++) {
+		BRect rect = region.RectAt(i);
+		for (float y = floorf(rect.top / size) * size; y <= rect.bottom;
+				y += size) {
+			for (float x = floorf(rect.left / size) * size; x <= rect.right;
+					x += size) {
+				BRect area = rect & BRect(x, y, x + size - 1, y + size - 1);
+				DrawBitmapAsync(fGridBitmap, area.OffsetByCopy(-x, -y), area);
+				fRenderStats.bytesUploaded += upload_size(area);
+			}
+		}
+	}
+	PopState();
+}
+
+
+bool
+BSVGView::_CreateGridBitmap()
+{
+	fGridBitmap = new BBitmap(BRect(0, 0, kGridPatternSize - 1,
+		kGridPatternSize - 1), B_RGB32);
+	fRenderStats.bitmapsAllocated++;
+	if (fGridBitmap->InitCheck() != B_OK) {
+		delete fGridBitmap;
+		fGridBitmap = NULL;
+		return false;
+	}
 
-			FillRect(BRect(x * cellSize, y * cellSize,
-				(x + 1) * cellSize, (y + 1) * cellSize));
+	uint8* bits = (uint8*)fGridBitmap->Bits();
+	int32 bpr = fGridBitmap->BytesPerRow();
+	for (int32 y = 0; y < kGridPatternSize; y++) {
+		uint32* row = (uint32*)(bits + y * bpr);
+		for (int32 x = 0; x < kGridPatternSize; x++) {
+			bool light = (x / kGridCellSize + y / kGridCellSize) % 2 != 0;
+			row[x] = light ? 0xffe6e6e6 : 0xffc8c8c8;
 		}
 	}
+	return true;
 }
 
 
@@ -1981,6 +3990,57 @@ BSVGView::_DrawBoundingBox()
 }
 
 
+void
+BSVGView::_DrawRenderStats()
+{
+	const SVGRenderStats& stats = fRenderStats;
+
+	BString lines[6];
+	lines[0].SetToFormat("frame %.2f ms", stats.frameTime / 1000.0);
+	lines[1].SetToFormat("grid %.2f  bbox %.2f  shapes %.2f  highlight %.2f",
+		stats.transparencyTime / 1000.0, stats.boundingBoxTime / 1000.0,
+		stats.shapeTime / 1000.0, stats.highlightTime / 1000.0);
+	lines[2].SetToFormat("gradients %.2f  masks %.2f",
+		stats.gradientTime / 1000.0, stats.maskTime / 1000.0);
+	lines[3].SetToFormat("shapes %d drawn, %d culled, %d skipped  "
+		"tiles %d drawn, %d rendered", (int)stats.shapesDrawn,
+		(int)stats.shapesCulled, (int)stats.shapesSkipped,
+		(int)stats.tilesDrawn, (int)stats.tilesRendered);
+	lines[4].SetToFormat("fill %d  stroke %d  bitmaps %d",
+		(int)stats.fillShapeCalls, (int)stats.strokeShapeCalls,
+		(int)stats.bitmapsAllocated);
+	lines[5].SetToFormat("uploaded %.1f KB", stats.bytesUploaded / 1024.0);
+
+	BFont font(be_fixed_font);
+	font_height height;
+	font.GetHeight(&height);
+	float lineHeight = ceilf(height.ascent + height.descent + height.leading);
+
+	float width = 0;
+	for (int32 i = 0; i < 6; i++)
+		width = fmaxf(width, font.StringWidth(lines[i].String()));
+
+	BRect bounds = Bounds();
+	BRect frame(bounds.left + 8, bounds.top + 8,
+		bounds.left + 8 + width + 12, bounds.top + 8 + lineHeight * 6 + 8);
+	fRenderStatsFrame = frame;
+
+	PushState();
+	SetFont(&font);
+	SetDrawingMode(B_OP_ALPHA);
+	SetBlendingMode(B_CONSTANT_ALPHA, B_ALPHA_OVERLAY);
+	SetHighColor(0, 0, 0, 170);
+	FillRect(frame);
+
+	SetHighColor(255, 255, 255, 255);
+	for (int32 i = 0; i < 6; i++) {
+		DrawString(lines[i].String(), BPoint(frame.left + 6,
+			frame.top + 4 + height.ascent + lineHeight * i));
+	}
+	PopState();
+}
+
+
 void
 BSVGView::_DrawDocumentStyle(BRect bounds)
 {
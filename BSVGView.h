@@ -7,6 +7,9 @@
 #define B_SVGVIEW_H
 
 #include <View.h>
+#include <Messenger.h>
+#include <MessageRunner.h>
+#include <OS.h>
 #include <Shape.h>
 #include <Rect.h>
 #include <Region.h>
@@ -19,7 +22,6 @@
 
 #include <agg_path_storage.h>
 #include <agg_conv_stroke.h>
-#include <agg_conv_curve.h>
 #include <agg_conv_transform.h>
 #include <agg_trans_affine.h>
 #include <agg_rendering_buffer.h>
@@ -30,12 +32,28 @@
 #include <agg_scanline_p.h>
 
 #include "nanosvg.h"
+#include "SVGDocumentCache.h"
+#include "SVGGeometry.h"
+#include "SVGGradientCache.h"
+#include "SVGPolylineCache.h"
+#include "SVGRenderer.h"
+#include "SVGScratchPool.h"
+#include "SVGSpatialIndex.h"
 
-enum svg_display_mode {
-	SVG_DISPLAY_NORMAL = 0,
-	SVG_DISPLAY_OUTLINE,
-	SVG_DISPLAY_FILL_ONLY,
-	SVG_DISPLAY_STROKE_ONLY
+// Messages sent to the target of LoadFromFileAsync()
+enum {
+	SVG_MSG_LOAD_PROGRESS	= 'svlp',
+	SVG_MSG_LOAD_COMPLETED	= 'svlc'
+};
+
+enum svg_load_stage {
+	SVG_LOAD_STAGE_READING = 0,
+	SVG_LOAD_STAGE_PARSING
+};
+
+enum svg_render_mode {
+	SVG_RENDER_NATIVE = 0,
+	SVG_RENDER_AGG
 };
 
 enum svg_boundingbox_style {
@@ -67,6 +85,82 @@ struct GradientLUT {
 	rgb_color colors[256];
 };
 
+enum svg_paint_class {
+	SVG_PAINT_CLASS_NONE = 0,
+	SVG_PAINT_CLASS_SOLID,
+	SVG_PAINT_CLASS_GRADIENT,
+	SVG_PAINT_CLASS_RASTER_GRADIENT
+};
+
+// One compiled shape of the display list. Geometry is scaled but not
+// offset, so panning only moves the view origin.
+struct SVGDisplayItem {
+	int32				shapeIndex;
+	BRect				bounds;
+	bool				masked;
+	// Below the detail threshold at the compiled scale, drawn as a pixel
+	bool				dot;
+
+	BShape*				path;
+	BRect				fillBounds;
+	svg_paint_class		fillClass;
+	rgb_color			fillColor;
+	BGradient*			fillGradient;
+
+	svg_paint_class		strokeClass;
+	rgb_color			strokeColor;
+	BGradient*			strokeGradient;
+	BShape*				strokeOutline;
+	float				penSize;
+	cap_mode			lineCap;
+	join_mode			lineJoin;
+	float				miterLimit;
+};
+
+struct SVGLoadJob;
+
+struct SVGTile {
+	BBitmap*			bitmap;
+	int32				x;
+	int32				y;
+	uint32				lastUsed;
+};
+
+// Statistics of one Draw() call. Times are in microseconds. The gradient
+// and mask fallbacks are part of the shape time; shapes are only counted
+// when they are drawn through the display list.
+struct SVGRenderStats {
+	bigtime_t			frameTime;
+	bigtime_t			transparencyTime;
+	bigtime_t			boundingBoxTime;
+	bigtime_t			shapeTime;
+	bigtime_t			highlightTime;
+	bigtime_t			gradientTime;
+	bigtime_t			maskTime;
+	int32				shapesDrawn;
+	int32				shapesCulled;
+	int32				shapesSkipped;
+	int32				tilesDrawn;
+	int32				tilesRendered;
+	int32				bitmapsAllocated;
+	int32				fillShapeCalls;
+	int32				strokeShapeCalls;
+	uint64				bytesUploaded;
+};
+
+// A masked shape composited at one scale and sub-pixel offset phase. The
+// frame is in view coordinates with the integer part of the offset
+// removed, so that panning only moves it.
+struct SVGMaskedShape {
+	BBitmap*			bitmap;
+	BRect				frame;
+	int32				shape;
+	float				scale;
+	float				phaseX;
+	float				phaseY;
+	uint32				lastUsed;
+};
+
 class BSVGView : public BView {
 public:
 							BSVGView(BRect frame, const char* name,
@@ -79,11 +173,25 @@ public:
 								const char* units = "px", float dpi = 96.0f);
 	status_t				LoadFromMemory(const char* data,
 								const char* units = "px", float dpi = 96.0f);
+	// Parses a writable buffer in place, destroying its contents. With
+	// adopt the view takes ownership and free()s it after parsing.
+	status_t				LoadFromMemory(char* data, size_t length,
+								bool adopt, const char* units = "px",
+								float dpi = 96.0f);
+	// Parses in a background thread and keeps the current document until
+	// the new one is ready. The target (the window by default) receives
+	// SVG_MSG_LOAD_PROGRESS and SVG_MSG_LOAD_COMPLETED messages.
+	status_t				LoadFromFileAsync(const char* filename,
+								BMessenger target = BMessenger(),
+								const char* units = "px", float dpi = 96.0f);
+	void					CancelLoad();
+	bool					IsLoading() const { return fLoadJob != NULL; }
 	void					Unload();
 
 	virtual void			Draw(BRect updateRect);
 	virtual void			AttachedToWindow();
 	virtual void			FrameResized(float newWidth, float newHeight);
+	virtual void			MessageReceived(BMessage* message);
 
 	void					SetScale(float scale);
 	void					SetOffset(BPoint point);
@@ -95,12 +203,72 @@ public:
 	void					SetDisplayMode(svg_display_mode mode);
 	svg_display_mode		DisplayMode() const { return fDisplayMode; }
 
+	void					SetRenderMode(svg_render_mode mode);
+	svg_render_mode			RenderMode() const { return fRenderMode; }
+	// Threads used by the software renderer; 0 uses one per CPU core
+	void					SetRenderThreadCount(int32 count);
+	int32					RenderThreadCount() const
+								{ return fRenderer.ThreadCount(); }
+
+	// Scale changes from SetScale() and resizing with auto scale show the
+	// last frame scaled, and render at full quality once the scale has not
+	// changed for the settle interval. Off by default. Only frames of the
+	// software renderer are reused, native drawing is never delayed.
+	void					SetInteractiveScaling(bool enable);
+	bool					InteractiveScaling() const
+								{ return fInteractiveScaling; }
+	void					SetSettleInterval(bigtime_t interval);
+	bigtime_t				SettleInterval() const { return fSettleInterval; }
+
+	// Shows a low resolution preview first and refines it to full
+	// resolution in a background thread, using the software renderer
+	void					SetProgressiveRendering(bool enable);
+	bool					ProgressiveRendering() const
+								{ return fProgressive; }
+
+	// Shapes smaller than the threshold in pixels are drawn as a single
+	// pixel of their average color; 0 draws every shape in full
+	void					SetDetailThreshold(float pixels);
+	float					DetailThreshold() const
+								{ return fDetailThreshold; }
+
 	void					SetShowTransparency(bool show);
 	bool					ShowTransparency() const { return fShowTransparency; }
 
+	// Statistics of the last Draw() call, optionally drawn in the top left
+	// corner of the view
+	void					GetRenderStats(SVGRenderStats& stats) const;
+	void					SetShowRenderStats(bool show);
+	bool					ShowRenderStats() const { return fShowRenderStats; }
+
 	void					SetBoundingBoxStyle(svg_boundingbox_style style);
 	svg_boundingbox_style	BoundingBoxStyle() const { return fBoundingBoxStyle; }
 
+	// Keeps parsed documents in the user cache directory, so that files
+	// that did not change are not parsed again
+	void					SetDocumentCacheEnabled(bool enable);
+	bool					DocumentCacheEnabled() const
+								{ return fDocumentCache.IsEnabled(); }
+
+	void					SetTileCacheEnabled(bool enable);
+	bool					TileCacheEnabled() const { return fTileCacheEnabled; }
+	void					SetTileCacheLimit(size_t bytes);
+	size_t					TileCacheLimit() const { return fTileCacheLimit; }
+	// Color tables and rasterized gradients, reused across repaints
+	void					SetGradientCacheLimit(size_t bytes);
+	size_t					GradientCacheLimit() const
+								{ return fGradientCache.Limit(); }
+	// Composited masked shapes, reused across repaints and pans
+	void					SetMaskCacheLimit(size_t bytes);
+	size_t					MaskCacheLimit() const { return fMaskCacheLimit; }
+	// Curves flattened per zoom level, shared by fill, stroke and
+	// highlight. Each software renderer keeps its own cache of this size.
+	void					SetPolylineCacheLimit(size_t bytes);
+	size_t					PolylineCacheLimit() const
+								{ return fPolylineCache.Limit(); }
+	// Allocation counters of the offscreen raster paths
+	void					GetScratchStats(SVGScratchStats& stats) const;
+
 	void					SetHighlightedShape(int32 shapeIndex);
 	void					SetHighlightedPath(int32 shapeIndex, int32 pathIndex);
 	void					SetHighlightControlPoints(int32 shapeIndex,
@@ -118,34 +286,98 @@ public:
 	BPoint					Offset() const { return BPoint(fOffsetX, fOffsetY); }
 	NSVGimage*				SVGImage() const { return fSVGImage; }
 
+	// Document shapes by index, as used by the highlight methods
+	int32					CountShapes() const
+								{ return fGeometry.CountShapes(); }
+	NSVGshape*				ShapeAt(int32 shapeIndex) const;
+	int32					CountPaths(int32 shapeIndex) const;
+	// Index of the first shape with the given SVG id, or -1
+	int32					FindShapeById(const char* id) const
+								{ return fGeometry.FindShapeById(id); }
+
+	// Hit testing in view coordinates against the painted fill and stroke
+	// of the visible shapes, as in the current display mode. Results are
+	// ordered top-most first; ShapeAtPoint() returns -1 if nothing is hit.
+	int32					ShapeAtPoint(BPoint where);
+	int32					ShapesInRect(BRect rect, int32* shapes,
+								int32 maxCount);
+
 	bool					IsLoaded() const { return fSVGImage != NULL; }
 
 protected:
 	void					_InitDefaults();
+	status_t				_SetImage(NSVGimage* image, const char* filename,
+								SVGCachedImage* cached = NULL);
+	status_t				_StartLoadThread(SVGLoadJob* job);
+	void					_LoadThreadExited();
+	static status_t			_LoadThread(void* data);
+
+	void					_BuildDisplayList();
+	void					_FreeDisplayList();
+	void					_CompileDisplayItem(int32 shapeIndex,
+								SVGDisplayItem& item);
+	void					_DrawDisplayItem(BView* target,
+								const SVGDisplayItem& item, BRect clipRect);
 
-	void					_DrawShape(NSVGshape* shape, int32 shapeIndex);
-	void					_ConvertPath(NSVGpath* path, BShape& shape);
+	status_t				_BuildSpatialIndex();
+	int32					_QueryDisplayItems(BRect viewRect);
+	bool					_HitTestShape(int32 shapeIndex, BRect pixels);
+	bool					_HitTestPaint(int32 shapeIndex, BRect pixels,
+								svg_display_mode displayMode);
+
+	void					_DrawSoftware(BRect updateRect);
+	void					_DrawTiles(BRect updateRect);
+	void					_ValidateTileCache();
+	void					_FlushTileCache();
+	SVGTile*				_FindTile(int32 x, int32 y);
+	SVGMaskedShape*			_FindMaskedShape(int32 shapeIndex, float phaseX,
+								float phaseY);
+	bool					_AddMaskedShape(int32 shapeIndex, float phaseX,
+								float phaseY, BBitmap* bitmap, BRect frame);
+	void					_MakeMaskCacheRoom(size_t bytes);
+	void					_FlushMaskCache();
+	SVGTile*				_RenderTile(int32 x, int32 y);
+
+	void					_DrawProgressive(BRect updateRect);
+	void					_StartRefinement();
+	void					_StopRefinement();
+	void					_FinishRefinement();
+	void					_RenderPreview();
+	status_t				_Refine(int32 generation, bool notify);
+	static status_t			_RefineThread(void* data);
+	void					_BeginInteraction();
+	void					_EndInteraction();
+	void					_CaptureSnapshot();
+	void					_DrawSnapshot(BRect updateRect);
+	void					_DrawDetailDot(BView* target,
+								const SVGDisplayItem& item);
+	void					_ConvertPath(int32 pathIndex, BShape& shape);
+	void					_ConvertPolyline(const SVGPolyline& polyline,
+								int32 pathIndex, BShape& shape);
 	void					_SetupGradient(NSVGgradient* gradient, BRect bounds,
 								char gradientType, BGradient** outGradient,
 								float shapeOpacity = 1.0f);
 	rgb_color				_ConvertColor(unsigned int color,
 								float opacity = 1.0f);
 	void					_CalculateAutoScale();
-	void					_SetupStrokeStyle(NSVGshape* shape);
-	void					_DrawTransparencyGrid();
+	void					_DrawTransparencyGrid(BRect updateRect);
+	bool					_CreateGridBitmap();
 	void					_DrawBoundingBox();
+	void					_DrawRenderStats();
 	void					_DrawDocumentStyle(BRect bounds);
 	void					_DrawSimpleFrame(BRect bounds);
 	void					_DrawTransparentGray(BRect bounds);
 
-	void					_DrawHighlight();
-	void					_DrawShapeHighlight(NSVGshape* shape);
-	void					_DrawPathHighlight(NSVGshape* shape, NSVGpath* path);
-	void					_DrawControlPoints(NSVGpath* path);
-	void					_DrawBezierHandles(NSVGpath* path);
+	void					_SetHighlight(const HighlightInfo& info);
+	BRect					_HighlightBounds(const HighlightInfo& info) const;
+	void					_DrawHighlight(BRect updateRect);
+	void					_DrawShapeHighlight(int32 shapeIndex);
+	void					_DrawPathHighlight(int32 pathIndex);
+	void					_DrawControlPoints(int32 pathIndex);
+	void					_DrawBezierHandles(int32 pathIndex);
 	void					_DrawControlPoint(BPoint point,
 								bool isEndPoint = false, bool isSelected = false);
-	void					_DrawHighlightOutline(NSVGpath* path,
+	void					_DrawHighlightOutline(int32 pathIndex,
 								float width = 3.0f);
 	BPoint					_ConvertSVGPoint(float x, float y) const;
 	float					_GetControlPointSize() const;
@@ -154,44 +386,51 @@ protected:
 	bool					_HasRotationOrSkew(float* xform);
 	BBitmap*				_RasterizeGradient(NSVGgradient* gradient,
 								char gradientType, BRect shapeBounds,
-								BRect clippedBounds, float shapeOpacity);
-	void					_FillShapeWithGradientBitmap(BShape& shape,
-								BBitmap* bitmap, BRect shapeBounds,
-								BRect clippedBounds);
-	rgb_color				_InterpolateGradientColor(NSVGgradient* gradient,
-								float t, float opacity);
+								BRect clippedBounds, float shapeOpacity,
+								BRect& area);
+	BBitmap*				_CopyBitmapArea(BBitmap* source, BRect area);
+	void					_FillShapeWithGradientBitmap(BView* target,
+								BShape& shape, BBitmap* bitmap,
+								BRect source, BRect clippedBounds);
 	void					_BuildGradientLUT(NSVGgradient* gradient,
 								float opacity, GradientLUT& lut);
+	const uint8*			_GradientTable(NSVGgradient* gradient,
+								float opacity, uint8* buffer);
+	bool					_GradientInverse(NSVGgradient* gradient,
+								float* inverse);
+	BBitmap*				_GradientBitmap(NSVGgradient* gradient,
+								char gradientType, BRect shapeBounds,
+								BRect clippedBounds, float shapeOpacity,
+								BRect& source, bool& pooled);
 	void					_ApplyGradientToBuffer(uint8* bits, int width,
 								int height, int32 bpr, NSVGgradient* gradient,
 								char gradientType, BRect renderBounds,
 								float opacity);
-	float					_ApplySpreadMode(int spread, float t);
 
-	BShape*					_ConvertStrokeToFillShape(NSVGshape* shape);
-	void					_BuildAGGPath(NSVGshape* shape,
+	BShape*					_ConvertStrokeToFillShape(int32 shapeIndex);
+	void					_BuildAGGPath(int32 shapeIndex,
 								agg::path_storage& aggPath);
-	void					_StrokeShapeWithRasterizedGradient(NSVGshape* shape,
-								char gradientType);
-
-	void					_DrawShapeWithMask(NSVGshape* shape, int32 shapeIndex);
-	void					_RenderShapeToBuffer(NSVGshape* shape, BBitmap* bitmap,
-								BRect renderBounds);
-	void					_RenderMaskToBuffer(NSVGmask* mask, BBitmap* bitmap,
-								BRect renderBounds);
-	void					_ApplyMaskToBitmap(BBitmap* content, BBitmap* mask);
-	void					_BuildAGGPathWithOffset(NSVGshape* shape,
+	void					_StrokeShapeWithRasterizedGradient(BView* target,
+								int32 shapeIndex, BRect clipRect);
+
+	void					_DrawShapeWithMask(BView* target,
+								int32 shapeIndex, BRect clipRect);
+	void					_RenderShapeToBuffer(int32 shapeIndex,
+								BBitmap* bitmap, BRect renderBounds);
+	void					_RenderMaskToBuffer(int32 maskIndex,
+								BBitmap* bitmap, BRect renderBounds);
+	void					_ApplyMaskToBitmap(BBitmap* content, BBitmap* mask,
+								int32 width, int32 height);
+	void					_BuildAGGPathWithOffset(int32 shapeIndex,
 								agg::path_storage& aggPath,
 								float offsetX, float offsetY);
 
-	agg::line_cap_e			_ConvertLineCapAGG(int nsvgCap);
-	agg::line_join_e		_ConvertLineJoinAGG(int nsvgJoin);
 	cap_mode				_ConvertLineCapHaiku(int nsvgCap);
 	join_mode				_ConvertLineJoinHaiku(int nsvgJoin);
-	float					_ClampMiterLimit(float miterLimit);
 
 protected:
 	NSVGimage*				fSVGImage;
+	SVGGeometry				fGeometry;
 	float					fScale;
 	float					fOffsetX;
 	float					fOffsetY;
@@ -199,8 +438,85 @@ protected:
 	BString					fLoadedFile;
 	svg_display_mode		fDisplayMode;
 	bool					fShowTransparency;
+	BBitmap*				fGridBitmap;
+	bool					fShowRenderStats;
+	SVGRenderStats			fRenderStats;
+	BRect					fRenderStatsFrame;
 	svg_boundingbox_style	fBoundingBoxStyle;
 	HighlightInfo			fHighlightInfo;
+
+	SVGDisplayItem*			fDisplayList;
+	int32					fDisplayListCount;
+	float					fDisplayListScale;
+	BRect					fDisplayListBounds;
+
+	SVGSpatialIndex			fSpatialIndex;
+	int32*					fVisibleItems;
+
+	bool					fTileCacheEnabled;
+	size_t					fTileCacheLimit;
+	SVGTile*				fTiles;
+	int32					fTileCount;
+	int32					fTileCapacity;
+	uint32					fTileFrame;
+	float					fTileScale;
+	float					fTilePhaseX;
+	float					fTilePhaseY;
+	svg_display_mode		fTileDisplayMode;
+	svg_render_mode			fTileRenderMode;
+	BBitmap*				fTileRenderBitmap;
+	BView*					fTileRenderView;
+
+	float					fDetailThreshold;
+
+	svg_render_mode			fRenderMode;
+	SVGRenderer				fRenderer;
+	BBitmap*				fRenderBitmap;
+
+	bool					fProgressive;
+	BBitmap*				fPreviewBitmap;
+	SVGRenderer				fRefineRenderer;
+	BBitmap*				fRefineBitmap;
+	thread_id				fRefineThread;
+	int32					fRefineGeneration;
+	// Generation of the last refinement that finished rendering, set by
+	// the refine thread
+	int32					fRefineCompleted;
+	bool					fRefineDone;
+	float					fRefineScale;
+	float					fRefineOffsetX;
+	float					fRefineOffsetY;
+	svg_display_mode		fRefineDisplayMode;
+	BMessenger				fRefineMessenger;
+
+	bool					fInteractiveScaling;
+	bigtime_t				fSettleInterval;
+	BMessageRunner*			fSettleRunner;
+	int32					fSettleGeneration;
+	BBitmap*				fSnapshotBitmap;
+	float					fSnapshotScale;
+	float					fSnapshotOffsetX;
+	float					fSnapshotOffsetY;
+
+	SVGLoadJob*				fLoadJob;
+	int32					fLoadGeneration;
+	thread_id				fLoadThread;
+	int32					fLoadThreadGeneration;
+
+	SVGGradientCache		fGradientCache;
+	SVGPolylineCache		fPolylineCache;
+
+	size_t					fMaskCacheLimit;
+	size_t					fMaskCacheSize;
+	SVGMaskedShape*			fMaskedShapes;
+	int32					fMaskedShapeCount;
+	int32					fMaskedShapeCapacity;
+	uint32					fMaskCacheClock;
+
+	SVGScratchPool			fScratchPool;
+
+	SVGDocumentCache		fDocumentCache;
+	SVGCachedImage*			fCachedImage;
 };
 
 #endif
@@ -0,0 +1,849 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGDocumentCache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static const uint32 kCacheMagic = 0x43475653;	// "SVGC"
+static const uint32 kCacheVersion = 1;
+static const char* kEntrySuffix = ".svgcache";
+
+static const uint64 kDefaultLimit = 64 * 1024 * 1024;
+
+static const uint64 kFNVOffsetBasis = 14695981039346656037ULL;
+static const uint64 kFNVPrime = 1099511628211ULL;
+
+
+// File layout: header, source path, then the sections below at the
+// recorded offsets, each 8 byte aligned. Shapes of the document come
+// first, followed by the shapes of every mask. Points are stored as one
+// float array that the restored paths point into.
+struct CacheHeader {
+	uint32					magic;
+	uint32					version;
+
+	uint32					imageSize;
+	uint32					shapeSize;
+	uint32					pathSize;
+	uint32					gradientSize;
+	uint32					stopSize;
+	uint32					maskSize;
+
+	uint64					fileSize;
+	int64					fileTime;
+	uint64					contentHash;
+	float					dpi;
+	char					units[8];
+
+	float					width;
+	float					height;
+
+	uint32					pathLength;
+	uint32					shapeCount;
+	uint32					rootShapeCount;
+	uint32					pathCount;
+	uint32					gradientCount;
+	uint32					stopCount;
+	uint32					maskCount;
+	uint32					reserved;
+	uint64					pointCount;
+
+	uint64					pathOffset;
+	uint64					shapesOffset;
+	uint64					pathsOffset;
+	uint64					gradientsOffset;
+	uint64					stopsOffset;
+	uint64					masksOffset;
+	uint64					pointsOffset;
+};
+
+struct PaintRecord {
+	int32					type;
+	uint32					color;
+	int32					gradient;
+};
+
+struct ShapeRecord {
+	char					id[64];
+	PaintRecord				fill;
+	PaintRecord				stroke;
+	float					opacity;
+	float					strokeWidth;
+	float					strokeDashOffset;
+	float					strokeDashArray[8];
+	int32					strokeDashCount;
+	int32					strokeLineJoin;
+	int32					strokeLineCap;
+	float					miterLimit;
+	int32					fillRule;
+	uint32					flags;
+	float					bounds[4];
+	char					fillGradient[64];
+	char					strokeGradient[64];
+	float					xform[6];
+	uint32					firstPath;
+	uint32					pathCount;
+	int32					mask;
+};
+
+struct PathRecord {
+	uint64					firstPoint;
+	int32					pointCount;
+	int32					closed;
+	float					bounds[4];
+};
+
+struct GradientRecord {
+	float					xform[6];
+	int32					spread;
+	float					fx;
+	float					fy;
+	uint32					firstStop;
+	uint32					stopCount;
+};
+
+struct StopRecord {
+	uint32					color;
+	float					offset;
+};
+
+struct MaskRecord {
+	uint32					firstShape;
+	uint32					shapeCount;
+};
+
+// A file of the cache directory, while trimming it
+struct EntryFile {
+	char					name[32];
+	time_t					time;
+	uint64					size;
+};
+
+
+static inline uint64
+align8(uint64 value)
+{
+	return (value + 7) & ~(uint64)7;
+}
+
+
+static uint64
+fnv1a(const void* data, size_t length)
+{
+	const uint8* bytes = (const uint8*)data;
+	uint64 hash = kFNVOffsetBasis;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= kFNVPrime;
+	}
+	return hash;
+}
+
+
+static void
+copy_string(char* dest, size_t destSize, const char* source, size_t sourceSize)
+{
+	size_t size = destSize < sourceSize ? destSize : sourceSize;
+	memcpy(dest, source, size);
+	dest[destSize - 1] = '\0';
+}
+
+
+static bool
+is_gradient(int type)
+{
+	return type == NSVG_PAINT_LINEAR_GRADIENT
+		|| type == NSVG_PAINT_RADIAL_GRADIENT;
+}
+
+
+static int32
+find_mask(NSVGmask** masks, int32 count, NSVGmask* mask)
+{
+	for (int32 i = 0; i < count; i++) {
+		if (masks[i] == mask)
+			return i;
+	}
+	return -1;
+}
+
+
+static bool
+write_section(FILE* file, uint64& position, uint64 offset, const void* data,
+	uint64 size)
+{
+	static const char kPadding[8] = { 0 };
+	if (offset < position || offset - position > sizeof(kPadding))
+		return false;
+	if (offset > position
+		&& fwrite(kPadding, 1, offset - position, file) != offset - position)
+		return false;
+
+	position = offset + size;
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+
+static bool
+section_fits(uint64 offset, uint64 count, uint64 recordSize, uint64 fileSize)
+{
+	return offset <= fileSize && count <= (fileSize - offset) / recordSize;
+}
+
+
+static bool
+is_entry_name(const char* name)
+{
+	size_t length = strlen(name);
+	size_t suffixLength = strlen(kEntrySuffix);
+	return length > suffixLength && length < sizeof(EntryFile().name)
+		&& strcmp(name + length - suffixLength, kEntrySuffix) == 0;
+}
+
+
+static int
+compare_entry_time(const void* a, const void* b)
+{
+	time_t timeA = ((const EntryFile*)a)->time;
+	time_t timeB = ((const EntryFile*)b)->time;
+	return timeA < timeB ? -1 : (timeA > timeB ? 1 : 0);
+}
+
+
+//	#pragma mark - SVGCachedImage
+
+
+SVGCachedImage::SVGCachedImage()
+	:
+	fImage(NULL),
+	fArena(NULL),
+	fMapping(NULL),
+	fMappingSize(0)
+{
+}
+
+
+SVGCachedImage::~SVGCachedImage()
+{
+	free(fArena);
+	if (fMapping != NULL)
+		munmap(fMapping, fMappingSize);
+}
+
+
+//	#pragma mark - SVGDocumentCache
+
+
+SVGDocumentCache::SVGDocumentCache()
+	:
+	fDirectory(NULL),
+	fLimit(kDefaultLimit)
+{
+}
+
+
+SVGDocumentCache::~SVGDocumentCache()
+{
+	free(fDirectory);
+}
+
+
+status_t
+SVGDocumentCache::SetDirectory(const char* directory)
+{
+	free(fDirectory);
+	fDirectory = NULL;
+
+	if (directory == NULL || directory[0] == '\0')
+		return B_OK;
+
+	fDirectory = strdup(directory);
+	return fDirectory != NULL ? B_OK : B_NO_MEMORY;
+}
+
+
+void
+SVGDocumentCache::MakeKey(SVGCacheKey& key, const char* path, uint64 fileSize,
+	int64 fileTime, const char* data, size_t length, const char* units,
+	float dpi)
+{
+	memset(&key, 0, sizeof(key));
+	key.path = path;
+	key.fileSize = fileSize;
+	key.fileTime = fileTime;
+	key.contentHash = fnv1a(data, length);
+	key.dpi = dpi;
+	if (units != NULL)
+		strncpy(key.units, units, sizeof(key.units) - 1);
+}
+
+
+SVGCachedImage*
+SVGDocumentCache::Lookup(const SVGCacheKey& key) const
+{
+	if (fDirectory == NULL || key.path == NULL)
+		return NULL;
+
+	char entryPath[1024];
+	_EntryPath(key.path, entryPath, sizeof(entryPath));
+
+	int fd = open(entryPath, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader)) {
+		close(fd);
+		return NULL;
+	}
+
+	uint64 size = st.st_size;
+	void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		return NULL;
+
+	const uint8* base = (const uint8*)mapping;
+	const CacheHeader& header = *(const CacheHeader*)base;
+
+	bool valid = header.magic == kCacheMagic
+		&& header.version == kCacheVersion
+		&& header.imageSize == sizeof(NSVGimage)
+		&& header.shapeSize == sizeof(NSVGshape)
+		&& header.pathSize == sizeof(NSVGpath)
+		&& header.gradientSize == sizeof(NSVGgradient)
+		&& header.stopSize == sizeof(NSVGgradientStop)
+		&& header.maskSize == sizeof(NSVGmask)
+		&& header.fileSize == key.fileSize
+		&& header.fileTime == key.fileTime
+		&& header.contentHash == key.contentHash
+		&& header.dpi == key.dpi
+		&& memcmp(header.units, key.units, sizeof(key.units)) == 0
+		&& header.rootShapeCount <= header.shapeCount
+		&& ((header.shapesOffset | header.pathsOffset | header.gradientsOffset
+			| header.stopsOffset | header.masksOffset | header.pointsOffset)
+			& 7) == 0
+		&& section_fits(header.pathOffset, (uint64)header.pathLength + 1, 1,
+			size)
+		&& section_fits(header.shapesOffset, header.shapeCount,
+			sizeof(ShapeRecord), size)
+		&& section_fits(header.pathsOffset, header.pathCount,
+			sizeof(PathRecord), size)
+		&& section_fits(header.gradientsOffset, header.gradientCount,
+			sizeof(GradientRecord), size)
+		&& section_fits(header.stopsOffset, header.stopCount,
+			sizeof(StopRecord), size)
+		&& section_fits(header.masksOffset, header.maskCount,
+			sizeof(MaskRecord), size)
+		&& section_fits(header.pointsOffset, header.pointCount,
+			sizeof(float), size);
+
+	// Different paths may share an entry name, so compare the full path
+	if (valid) {
+		const char* storedPath = (const char*)(base + header.pathOffset);
+		valid = storedPath[header.pathLength] == '\0'
+			&& strcmp(storedPath, key.path) == 0;
+	}
+
+	const ShapeRecord* shapeRecords
+		= (const ShapeRecord*)(base + header.shapesOffset);
+	const PathRecord* pathRecords
+		= (const PathRecord*)(base + header.pathsOffset);
+	const GradientRecord* gradientRecords
+		= (const GradientRecord*)(base + header.gradientsOffset);
+	const StopRecord* stopRecords
+		= (const StopRecord*)(base + header.stopsOffset);
+	const MaskRecord* maskRecords
+		= (const MaskRecord*)(base + header.masksOffset);
+	float* points = (float*)((uint8*)mapping + header.pointsOffset);
+
+	// Everything but the points goes into one arena
+	uint64 imageOffset = 0;
+	uint64 shapesOffset = align8(sizeof(NSVGimage));
+	uint64 pathsOffset = align8(shapesOffset
+		+ (uint64)header.shapeCount * sizeof(NSVGshape));
+	uint64 masksOffset = align8(pathsOffset
+		+ (uint64)header.pathCount * sizeof(NSVGpath));
+	uint64 tableOffset = align8(masksOffset
+		+ (uint64)header.maskCount * sizeof(NSVGmask));
+	uint64 gradientsOffset = align8(tableOffset
+		+ (uint64)header.gradientCount * sizeof(NSVGgradient*));
+	uint64 arenaSize = gradientsOffset;
+
+	for (uint32 i = 0; valid && i < header.gradientCount; i++) {
+		const GradientRecord& record = gradientRecords[i];
+		valid = record.firstStop <= header.stopCount
+			&& record.stopCount <= header.stopCount - record.firstStop;
+		uint32 extraStops = record.stopCount > 1 ? record.stopCount - 1 : 0;
+		arenaSize += align8(sizeof(NSVGgradient)
+			+ (uint64)extraStops * sizeof(NSVGgradientStop));
+	}
+
+	uint8* arena = valid ? (uint8*)calloc(1, arenaSize) : NULL;
+	if (arena == NULL) {
+		munmap(mapping, size);
+		return NULL;
+	}
+
+	NSVGimage* image = (NSVGimage*)(arena + imageOffset);
+	NSVGshape* shapes = (NSVGshape*)(arena + shapesOffset);
+	NSVGpath* paths = (NSVGpath*)(arena + pathsOffset);
+	NSVGmask* masks = (NSVGmask*)(arena + masksOffset);
+	NSVGgradient** gradients = (NSVGgradient**)(arena + tableOffset);
+
+	uint64 gradientOffset = gradientsOffset;
+	for (uint32 i = 0; i < header.gradientCount; i++) {
+		const GradientRecord& record = gradientRecords[i];
+		NSVGgradient* gradient = (NSVGgradient*)(arena + gradientOffset);
+		memcpy(gradient->xform, record.xform, sizeof(gradient->xform));
+		gradient->spread = (char)record.spread;
+		gradient->fx = record.fx;
+		gradient->fy = record.fy;
+		gradient->nstops = record.stopCount;
+		for (uint32 j = 0; j < record.stopCount; j++) {
+			gradient->stops[j].color = stopRecords[record.firstStop + j].color;
+			gradient->stops[j].offset
+				= stopRecords[record.firstStop + j].offset;
+		}
+		gradients[i] = gradient;
+
+		uint32 extraStops = record.stopCount > 1 ? record.stopCount - 1 : 0;
+		gradientOffset += align8(sizeof(NSVGgradient)
+			+ (uint64)extraStops * sizeof(NSVGgradientStop));
+	}
+
+	for (uint32 i = 0; valid && i < header.pathCount; i++) {
+		const PathRecord& record = pathRecords[i];
+		valid = record.pointCount >= 0
+			&& record.firstPoint <= header.pointCount
+			&& (uint64)record.pointCount * 2
+				<= header.pointCount - record.firstPoint;
+		paths[i].pts = points + record.firstPoint;
+		paths[i].npts = record.pointCount;
+		paths[i].closed = (char)record.closed;
+		memcpy(paths[i].bounds, record.bounds, sizeof(paths[i].bounds));
+	}
+
+	for (uint32 i = 0; valid && i < header.maskCount; i++) {
+		const MaskRecord& record = maskRecords[i];
+		valid = record.firstShape <= header.shapeCount
+			&& record.shapeCount <= header.shapeCount - record.firstShape;
+		masks[i].shapes = record.shapeCount > 0
+			? shapes + record.firstShape : NULL;
+	}
+
+	for (uint32 i = 0; valid && i < header.shapeCount; i++) {
+		const ShapeRecord& record = shapeRecords[i];
+		NSVGshape& shape = shapes[i];
+
+		valid = record.firstPath <= header.pathCount
+			&& record.pathCount <= header.pathCount - record.firstPath
+			&& record.mask >= -1 && record.mask < (int32)header.maskCount
+			&& record.fill.gradient < (int32)header.gradientCount
+			&& record.stroke.gradient < (int32)header.gradientCount;
+		if (!valid)
+			break;
+
+		copy_string(shape.id, sizeof(shape.id), record.id, sizeof(record.id));
+		shape.fill.type = (signed char)record.fill.type;
+		if (record.fill.type == NSVG_PAINT_COLOR)
+			shape.fill.color = record.fill.color;
+		else if (is_gradient(record.fill.type) && record.fill.gradient >= 0)
+			shape.fill.gradient = gradients[record.fill.gradient];
+		shape.stroke.type = (signed char)record.stroke.type;
+		if (record.stroke.type == NSVG_PAINT_COLOR)
+			shape.stroke.color = record.stroke.color;
+		else if (is_gradient(record.stroke.type) && record.stroke.gradient >= 0)
+			shape.stroke.gradient = gradients[record.stroke.gradient];
+
+		shape.opacity = record.opacity;
+		shape.strokeWidth = record.strokeWidth;
+		shape.strokeDashOffset = record.strokeDashOffset;
+		memcpy(shape.strokeDashArray, record.strokeDashArray,
+			sizeof(shape.strokeDashArray));
+		shape.strokeDashCount = (char)record.strokeDashCount;
+		shape.strokeLineJoin = (char)record.strokeLineJoin;
+		shape.strokeLineCap = (char)record.strokeLineCap;
+		shape.miterLimit = record.miterLimit;
+		shape.fillRule = (char)record.fillRule;
+		shape.flags = (unsigned char)record.flags;
+		memcpy(shape.bounds, record.bounds, sizeof(shape.bounds));
+		copy_string(shape.fillGradient, sizeof(shape.fillGradient),
+			record.fillGradient, sizeof(record.fillGradient));
+		copy_string(shape.strokeGradient, sizeof(shape.strokeGradient),
+			record.strokeGradient, sizeof(record.strokeGradient));
+		memcpy(shape.xform, record.xform, sizeof(shape.xform));
+		shape.mask = record.mask >= 0 ? masks + record.mask : NULL;
+
+		shape.paths = record.pathCount > 0 ? paths + record.firstPath : NULL;
+		for (uint32 j = 1; j < record.pathCount; j++)
+			paths[record.firstPath + j - 1].next = paths + record.firstPath + j;
+	}
+
+	if (!valid) {
+		free(arena);
+		munmap(mapping, size);
+		return NULL;
+	}
+
+	// Chain the document shapes and the shapes of each mask
+	for (uint32 i = 1; i < header.rootShapeCount; i++)
+		shapes[i - 1].next = shapes + i;
+	for (uint32 i = 0; i < header.maskCount; i++) {
+		const MaskRecord& record = maskRecords[i];
+		for (uint32 j = 1; j < record.shapeCount; j++) {
+			shapes[record.firstShape + j - 1].next
+				= shapes + record.firstShape + j;
+		}
+	}
+
+	image->width = header.width;
+	image->height = header.height;
+	image->shapes = header.rootShapeCount > 0 ? shapes : NULL;
+
+	SVGCachedImage* cached = new(std::nothrow) SVGCachedImage;
+	if (cached == NULL) {
+		free(arena);
+		munmap(mapping, size);
+		return NULL;
+	}
+
+	cached->fImage = image;
+	cached->fArena = arena;
+	cached->fMapping = mapping;
+	cached->fMappingSize = size;
+
+	// The modification time orders the entries for trimming
+	utimes(entryPath, NULL);
+	return cached;
+}
+
+
+status_t
+SVGDocumentCache::Store(const SVGCacheKey& key, NSVGimage* image) const
+{
+	if (fDirectory == NULL || key.path == NULL || image == NULL)
+		return B_BAD_VALUE;
+
+	// Collect the masks in the order they are first referenced; shapes of
+	// masks may reference further masks
+	NSVGmask** masks = NULL;
+	int32 maskCount = 0;
+	int32 maskCapacity = 0;
+
+	for (int32 list = -1; list < maskCount; list++) {
+		NSVGshape* first = list < 0 ? image->shapes : masks[list]->shapes;
+		for (NSVGshape* shape = first; shape != NULL; shape = shape->next) {
+			if (shape->mask == NULL
+				|| find_mask(masks, maskCount, shape->mask) >= 0)
+				continue;
+
+			if (maskCount == maskCapacity) {
+				maskCapacity = maskCapacity > 0 ? maskCapacity * 2 : 8;
+				NSVGmask** grown = (NSVGmask**)realloc(masks,
+					maskCapacity * sizeof(NSVGmask*));
+				if (grown == NULL) {
+					free(masks);
+					return B_NO_MEMORY;
+				}
+				masks = grown;
+			}
+			masks[maskCount++] = shape->mask;
+		}
+	}
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+
+	for (int32 list = -1; list < maskCount; list++) {
+		NSVGshape* first = list < 0 ? image->shapes : masks[list]->shapes;
+		for (NSVGshape* shape = first; shape != NULL; shape = shape->next) {
+			header.shapeCount++;
+			if (list < 0)
+				header.rootShapeCount++;
+
+			const NSVGpaint* paints[2] = { &shape->fill, &shape->stroke };
+			for (int32 i = 0; i < 2; i++) {
+				if (is_gradient(paints[i]->type) && paints[i]->gradient != NULL) {
+					header.gradientCount++;
+					header.stopCount += paints[i]->gradient->nstops;
+				}
+			}
+
+			for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
+				header.pathCount++;
+				header.pointCount += (uint64)path->npts * 2;
+			}
+		}
+	}
+
+	header.magic = kCacheMagic;
+	header.version = kCacheVersion;
+	header.imageSize = sizeof(NSVGimage);
+	header.shapeSize = sizeof(NSVGshape);
+	header.pathSize = sizeof(NSVGpath);
+	header.gradientSize = sizeof(NSVGgradient);
+	header.stopSize = sizeof(NSVGgradientStop);
+	header.maskSize = sizeof(NSVGmask);
+	header.fileSize = key.fileSize;
+	header.fileTime = key.fileTime;
+	header.contentHash = key.contentHash;
+	header.dpi = key.dpi;
+	memcpy(header.units, key.units, sizeof(header.units));
+	header.width = image->width;
+	header.height = image->height;
+	header.pathLength = strlen(key.path);
+	header.maskCount = maskCount;
+
+	header.pathOffset = align8(sizeof(CacheHeader));
+	header.shapesOffset = align8(header.pathOffset + header.pathLength + 1);
+	header.pathsOffset = align8(header.shapesOffset
+		+ (uint64)header.shapeCount * sizeof(ShapeRecord));
+	header.gradientsOffset = align8(header.pathsOffset
+		+ (uint64)header.pathCount * sizeof(PathRecord));
+	header.stopsOffset = align8(header.gradientsOffset
+		+ (uint64)header.gradientCount * sizeof(GradientRecord));
+	header.masksOffset = align8(header.stopsOffset
+		+ (uint64)header.stopCount * sizeof(StopRecord));
+	header.pointsOffset = align8(header.masksOffset
+		+ (uint64)header.maskCount * sizeof(MaskRecord));
+
+	// An entry over the limit would only be trimmed right away
+	if (header.pointsOffset + header.pointCount * sizeof(float) > fLimit) {
+		free(masks);
+		return B_NO_MEMORY;
+	}
+
+	ShapeRecord* shapeRecords = (ShapeRecord*)calloc(header.shapeCount + 1,
+		sizeof(ShapeRecord));
+	PathRecord* pathRecords = (PathRecord*)calloc(header.pathCount + 1,
+		sizeof(PathRecord));
+	GradientRecord* gradientRecords = (GradientRecord*)calloc(
+		header.gradientCount + 1, sizeof(GradientRecord));
+	StopRecord* stopRecords = (StopRecord*)calloc(header.stopCount + 1,
+		sizeof(StopRecord));
+	MaskRecord* maskRecords = (MaskRecord*)calloc(header.maskCount + 1,
+		sizeof(MaskRecord));
+	float* points = (float*)malloc((header.pointCount + 1) * sizeof(float));
+
+	status_t status = B_OK;
+	if (!shapeRecords || !pathRecords || !gradientRecords || !stopRecords
+		|| !maskRecords || !points)
+		status = B_NO_MEMORY;
+
+	uint32 shapeIndex = 0;
+	uint32 pathIndex = 0;
+	uint32 gradientIndex = 0;
+	uint32 stopIndex = 0;
+	uint64 pointIndex = 0;
+
+	for (int32 list = -1; status == B_OK && list < maskCount; list++) {
+		NSVGshape* first = list < 0 ? image->shapes : masks[list]->shapes;
+		if (list >= 0)
+			maskRecords[list].firstShape = shapeIndex;
+
+		for (NSVGshape* shape = first; shape != NULL; shape = shape->next) {
+			ShapeRecord& record = shapeRecords[shapeIndex++];
+
+			copy_string(record.id, sizeof(record.id), shape->id,
+				sizeof(shape->id));
+			const NSVGpaint* paints[2] = { &shape->fill, &shape->stroke };
+			PaintRecord* paintRecords[2] = { &record.fill, &record.stroke };
+			for (int32 i = 0; i < 2; i++) {
+				const NSVGpaint& paint = *paints[i];
+				PaintRecord& paintRecord = *paintRecords[i];
+				paintRecord.type = paint.type;
+				paintRecord.gradient = -1;
+				if (paint.type == NSVG_PAINT_COLOR)
+					paintRecord.color = paint.color;
+				else if (is_gradient(paint.type) && paint.gradient != NULL) {
+					NSVGgradient* gradient = paint.gradient;
+					GradientRecord& gradientRecord
+						= gradientRecords[gradientIndex];
+					memcpy(gradientRecord.xform, gradient->xform,
+						sizeof(gradientRecord.xform));
+					gradientRecord.spread = gradient->spread;
+					gradientRecord.fx = gradient->fx;
+					gradientRecord.fy = gradient->fy;
+					gradientRecord.firstStop = stopIndex;
+					gradientRecord.stopCount = gradient->nstops;
+					for (int32 j = 0; j < gradient->nstops; j++) {
+						stopRecords[stopIndex].color = gradient->stops[j].color;
+						stopRecords[stopIndex].offset
+							= gradient->stops[j].offset;
+						stopIndex++;
+					}
+					paintRecord.gradient = gradientIndex++;
+				}
+			}
+
+			record.opacity = shape->opacity;
+			record.strokeWidth = shape->strokeWidth;
+			record.strokeDashOffset = shape->strokeDashOffset;
+			memcpy(record.strokeDashArray, shape->strokeDashArray,
+				sizeof(record.strokeDashArray));
+			record.strokeDashCount = shape->strokeDashCount;
+			record.strokeLineJoin = shape->strokeLineJoin;
+			record.strokeLineCap = shape->strokeLineCap;
+			record.miterLimit = shape->miterLimit;
+			record.fillRule = shape->fillRule;
+			record.flags = shape->flags;
+			memcpy(record.bounds, shape->bounds, sizeof(record.bounds));
+			copy_string(record.fillGradient, sizeof(record.fillGradient),
+				shape->fillGradient, sizeof(shape->fillGradient));
+			copy_string(record.strokeGradient, sizeof(record.strokeGradient),
+				shape->strokeGradient, sizeof(shape->strokeGradient));
+			memcpy(record.xform, shape->xform, sizeof(record.xform));
+			record.mask = shape->mask != NULL
+				? find_mask(masks, maskCount, shape->mask) : -1;
+
+			record.firstPath = pathIndex;
+			for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
+				PathRecord& pathRecord = pathRecords[pathIndex++];
+				pathRecord.firstPoint = pointIndex;
+				pathRecord.pointCount = path->npts;
+				pathRecord.closed = path->closed;
+				memcpy(pathRecord.bounds, path->bounds,
+					sizeof(pathRecord.bounds));
+				memcpy(points + pointIndex, path->pts,
+					path->npts * 2 * sizeof(float));
+				pointIndex += (uint64)path->npts * 2;
+			}
+			record.pathCount = pathIndex - record.firstPath;
+		}
+
+		if (list >= 0) {
+			maskRecords[list].shapeCount
+				= shapeIndex - maskRecords[list].firstShape;
+		}
+	}
+
+	// Write to a temporary file first, so that readers never see a
+	// partially written entry
+	char entryPath[1024];
+	char tempPath[1100];
+	FILE* file = NULL;
+	if (status == B_OK) {
+		mkdir(fDirectory, 0755);
+		_EntryPath(key.path, entryPath, sizeof(entryPath));
+		snprintf(tempPath, sizeof(tempPath), "%s.%d.tmp", entryPath,
+			(int)getpid());
+		file = fopen(tempPath, "wb");
+		if (file == NULL)
+			status = B_ERROR;
+	}
+
+	if (file != NULL) {
+		uint64 position = 0;
+		bool written = write_section(file, position, 0, &header,
+				sizeof(header))
+			&& write_section(file, position, header.pathOffset, key.path,
+				header.pathLength + 1)
+			&& write_section(file, position, header.shapesOffset,
+				shapeRecords, (uint64)header.shapeCount * sizeof(ShapeRecord))
+			&& write_section(file, position, header.pathsOffset,
+				pathRecords, (uint64)header.pathCount * sizeof(PathRecord))
+			&& write_section(file, position, header.gradientsOffset,
+				gradientRecords,
+				(uint64)header.gradientCount * sizeof(GradientRecord))
+			&& write_section(file, position, header.stopsOffset,
+				stopRecords, (uint64)header.stopCount * sizeof(StopRecord))
+			&& write_section(file, position, header.masksOffset,
+				maskRecords, (uint64)header.maskCount * sizeof(MaskRecord))
+			&& write_section(file, position, header.pointsOffset,
+				points, header.pointCount * sizeof(float));
+
+		if (fclose(file) != 0 || !written
+			|| rename(tempPath, entryPath) != 0) {
+			unlink(tempPath);
+			status = B_ERROR;
+		}
+	}
+
+	free(shapeRecords);
+	free(pathRecords);
+	free(gradientRecords);
+	free(stopRecords);
+	free(maskRecords);
+	free(points);
+	free(masks);
+
+	if (status == B_OK)
+		_Trim();
+	return status;
+}
+
+
+void
+SVGDocumentCache::_EntryPath(const char* path, char* buffer, size_t size) const
+{
+	snprintf(buffer, size, "%s/%016llx%s", fDirectory,
+		(unsigned long long)fnv1a(path, strlen(path)), kEntrySuffix);
+}
+
+
+// Removes the least recently used entries until the directory fits the
+// limit. Temporary files of other writers are left alone.
+void
+SVGDocumentCache::_Trim() const
+{
+	DIR* dir = opendir(fDirectory);
+	if (dir == NULL)
+		return;
+
+	EntryFile* entries = NULL;
+	int32 count = 0;
+	int32 capacity = 0;
+	uint64 total = 0;
+	char path[1024];
+
+	while (struct dirent* dirent = readdir(dir)) {
+		if (!is_entry_name(dirent->d_name))
+			continue;
+
+		struct stat st;
+		snprintf(path, sizeof(path), "%s/%s", fDirectory, dirent->d_name);
+		if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+			continue;
+
+		if (count == capacity) {
+			capacity = capacity > 0 ? capacity * 2 : 64;
+			EntryFile* grown = (EntryFile*)realloc(entries,
+				capacity * sizeof(EntryFile));
+			if (grown == NULL)
+				break;
+			entries = grown;
+		}
+
+		EntryFile& entry = entries[count++];
+		strcpy(entry.name, dirent->d_name);
+		entry.time = st.st_mtime;
+		entry.size = st.st_size;
+		total += entry.size;
+	}
+	closedir(dir);
+
+	if (total > fLimit) {
+		qsort(entries, count, sizeof(EntryFile), compare_entry_time);
+		for (int32 i = 0; i < count && total > fLimit; i++) {
+			snprintf(path, sizeof(path), "%s/%s", fDirectory, entries[i].name);
+			if (unlink(path) == 0)
+				total -= entries[i].size;
+		}
+	}
+
+	free(entries);
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_DOCUMENT_CACHE_H
+#define SVG_DOCUMENT_CACHE_H
+
+#include "SVGPlatform.h"
+
+#include "nanosvg.h"
+
+// Identifies one parse of one file. An entry is only used when every
+// field matches, so editing, replacing or reparsing the file with other
+// units invalidates it.
+struct SVGCacheKey {
+	const char*				path;
+	uint64					fileSize;
+	int64					fileTime;
+	uint64					contentHash;
+	float					dpi;
+	char					units[8];
+};
+
+// A document restored from the cache. The NSVGimage and all its structs
+// live in a single arena and the points stay in the mapped cache file, so
+// the image must not be passed to nsvgDelete().
+class SVGCachedImage {
+public:
+							~SVGCachedImage();
+
+	NSVGimage*				Image() const { return fImage; }
+
+private:
+	friend class SVGDocumentCache;
+
+							SVGCachedImage();
+
+	NSVGimage*				fImage;
+	void*					fArena;
+	void*					fMapping;
+	size_t					fMappingSize;
+};
+
+// On-disk cache of parsed documents in a flat binary format, one file per
+// source path. Reading an entry maps it and rebuilds the nanosvg structs
+// without any XML or float parsing.
+//
+// Storing an entry trims the directory to the size limit, removing the
+// least recently used entries first.
+class SVGDocumentCache {
+public:
+							SVGDocumentCache();
+							~SVGDocumentCache();
+
+	status_t				SetDirectory(const char* directory);
+	const char*				Directory() const { return fDirectory; }
+	bool					IsEnabled() const { return fDirectory != NULL; }
+
+	void					SetLimit(uint64 bytes) { fLimit = bytes; }
+	uint64					Limit() const { return fLimit; }
+
+	// The content hash is taken from data, which must still hold the
+	// unmodified file
+	static void				MakeKey(SVGCacheKey& key, const char* path,
+								uint64 fileSize, int64 fileTime,
+								const char* data, size_t length,
+								const char* units, float dpi);
+
+	SVGCachedImage*			Lookup(const SVGCacheKey& key) const;
+	status_t				Store(const SVGCacheKey& key,
+								NSVGimage* image) const;
+
+private:
+	void					_EntryPath(const char* path, char* buffer,
+								size_t size) const;
+	void					_Trim() const;
+
+private:
+	char*					fDirectory;
+	uint64					fLimit;
+};
+
+#endif
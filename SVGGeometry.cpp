@@ -0,0 +1,387 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGGeometry.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+#include <unordered_map>
+
+
+static uint32
+hash_id(const char* id)
+{
+	// FNV-1a
+	uint32 hash = 2166136261u;
+	for (; *id != '\0'; id++)
+		hash = (hash ^ (uint8)*id) * 16777619u;
+	return hash;
+}
+
+
+static bool
+is_transparent_paint(const SVGPaint& paint)
+{
+	switch (paint.type) {
+		case NSVG_PAINT_COLOR:
+			return (paint.color >> 24) == 0;
+
+		case NSVG_PAINT_LINEAR_GRADIENT:
+		case NSVG_PAINT_RADIAL_GRADIENT:
+			if (paint.gradient == NULL)
+				return true;
+			for (int i = 0; i < paint.gradient->nstops; i++) {
+				if ((paint.gradient->stops[i].color >> 24) != 0)
+					return false;
+			}
+			return true;
+
+		default:
+			return true;
+	}
+}
+
+
+static bool
+is_transparent_shape(const SVGShapeStyle& style)
+{
+	if (style.opacity <= 0.0f)
+		return true;
+
+	return is_transparent_paint(style.fill)
+		&& (style.strokeWidth <= 0.0f || is_transparent_paint(style.stroke));
+}
+
+
+SVGGeometry::SVGGeometry()
+	:
+	fImage(NULL),
+	fShapeCount(0),
+	fTotalShapeCount(0),
+	fShapes(NULL),
+	fStyles(NULL),
+	fShapeBounds(NULL),
+	fShapeFirstPath(NULL),
+	fShapeMask(NULL),
+	fVisibleCount(0),
+	fVisibleShapes(NULL),
+	fMaskCount(0),
+	fMaskFirstShape(NULL),
+	fPathCount(0),
+	fPathFirstPoint(NULL),
+	fPathClosed(NULL),
+	fPointCount(0),
+	fPoints(NULL),
+	fIdTable(NULL),
+	fIdTableMask(0)
+{
+}
+
+
+SVGGeometry::~SVGGeometry()
+{
+	Unset();
+}
+
+
+status_t
+SVGGeometry::SetTo(NSVGimage* image)
+{
+	Unset();
+
+	if (image == NULL)
+		return B_BAD_VALUE;
+
+	// Masks may be shared by several shapes, so they are numbered in
+	// order of first use
+	std::unordered_map<NSVGmask*, int32> maskIndices;
+	int32 maskShapeCount = 0;
+	int64 pathCount = 0;
+	int64 pointCount = 0;
+
+	for (NSVGshape* shape = image->shapes; shape != NULL;
+			shape = shape->next) {
+		fShapeCount++;
+		for (NSVGpath* path = shape->paths; path != NULL; path = path->next) {
+			pathCount++;
+			pointCount += path->npts;
+		}
+
+		NSVGmask* mask = shape->mask;
+		if (mask == NULL || mask->shapes == NULL
+			|| maskIndices.find(mask) != maskIndices.end())
+			continue;
+
+		maskIndices[mask] = fMaskCount++;
+		for (NSVGshape* maskShape = mask->shapes; maskShape != NULL;
+				maskShape = maskShape->next) {
+			maskShapeCount++;
+			for (NSVGpath* path = maskShape->paths; path != NULL;
+					path = path->next) {
+				pathCount++;
+				pointCount += path->npts;
+			}
+		}
+	}
+
+	if (pathCount >= 0x7fffffff || pointCount >= 0x3fffffff)
+		return B_NO_MEMORY;
+
+	fTotalShapeCount = fShapeCount + maskShapeCount;
+	fPathCount = (int32)pathCount;
+	fPointCount = (int32)pointCount;
+
+	fShapes = new(std::nothrow) NSVGshape*[fTotalShapeCount];
+	fStyles = new(std::nothrow) SVGShapeStyle[fTotalShapeCount];
+	fShapeBounds = new(std::nothrow) float[fTotalShapeCount * 4];
+	fShapeFirstPath = new(std::nothrow) int32[fTotalShapeCount + 1];
+	fShapeMask = new(std::nothrow) int32[fTotalShapeCount];
+	fVisibleShapes = new(std::nothrow) int32[fShapeCount + 1];
+	fMaskFirstShape = new(std::nothrow) int32[fMaskCount + 1];
+	fPathFirstPoint = new(std::nothrow) int32[fPathCount + 1];
+	fPathClosed = new(std::nothrow) uint8[fPathCount + 1];
+	fPoints = new(std::nothrow) float[(size_t)fPointCount * 2 + 1];
+	if (!fShapes || !fStyles || !fShapeBounds || !fShapeFirstPath
+		|| !fShapeMask || !fVisibleShapes || !fMaskFirstShape
+		|| !fPathFirstPoint || !fPathClosed || !fPoints) {
+		Unset();
+		return B_NO_MEMORY;
+	}
+
+	int32 shapeIndex = 0;
+	int32 pathIndex = 0;
+	int32 pointIndex = 0;
+
+	// Document shapes first, then the mask shapes in mask order
+	NSVGmask** masks = new(std::nothrow) NSVGmask*[fMaskCount + 1];
+	if (masks == NULL) {
+		Unset();
+		return B_NO_MEMORY;
+	}
+	for (std::unordered_map<NSVGmask*, int32>::const_iterator it
+			= maskIndices.begin(); it != maskIndices.end(); ++it) {
+		masks[it->second] = it->first;
+	}
+
+	NSVGshape* shape = image->shapes;
+	int32 mask = -1;
+	NSVGshape* maskShape = NULL;
+	while (shapeIndex < fTotalShapeCount) {
+		NSVGshape* current;
+		if (shapeIndex < fShapeCount) {
+			current = shape;
+			shape = shape->next;
+		} else {
+			while (maskShape == NULL) {
+				mask++;
+				fMaskFirstShape[mask] = shapeIndex;
+				maskShape = masks[mask]->shapes;
+			}
+			current = maskShape;
+			maskShape = maskShape->next;
+		}
+
+		fShapes[shapeIndex] = current;
+
+		SVGShapeStyle& style = fStyles[shapeIndex];
+		style.fill.gradient = current->fill.gradient;
+		style.fill.color = current->fill.color;
+		style.fill.type = current->fill.type;
+		style.stroke.gradient = current->stroke.gradient;
+		style.stroke.color = current->stroke.color;
+		style.stroke.type = current->stroke.type;
+		style.opacity = current->opacity;
+		style.strokeWidth = current->strokeWidth;
+		style.miterLimit = current->miterLimit;
+		style.fillRule = current->fillRule;
+		style.strokeLineCap = current->strokeLineCap;
+		style.strokeLineJoin = current->strokeLineJoin;
+		style.flags = current->flags;
+		if (is_transparent_shape(style))
+			style.flags |= SVG_SHAPE_TRANSPARENT;
+
+		memcpy(fShapeBounds + shapeIndex * 4, current->bounds,
+			sizeof(float) * 4);
+
+		fShapeMask[shapeIndex] = -1;
+		if (shapeIndex < fShapeCount && current->mask != NULL
+			&& current->mask->shapes != NULL) {
+			fShapeMask[shapeIndex] = maskIndices[current->mask];
+		}
+
+		if (shapeIndex < fShapeCount
+			&& (current->flags & NSVG_FLAGS_VISIBLE) != 0)
+			fVisibleShapes[fVisibleCount++] = shapeIndex;
+
+		fShapeFirstPath[shapeIndex] = pathIndex;
+		for (NSVGpath* path = current->paths; path != NULL;
+				path = path->next) {
+			fPathFirstPoint[pathIndex] = pointIndex;
+			fPathClosed[pathIndex] = path->closed ? 1 : 0;
+			memcpy(fPoints + (size_t)pointIndex * 2, path->pts,
+				sizeof(float) * 2 * path->npts);
+			pointIndex += path->npts;
+			pathIndex++;
+		}
+
+		shapeIndex++;
+	}
+
+	fShapeFirstPath[fTotalShapeCount] = pathIndex;
+	fPathFirstPoint[fPathCount] = pointIndex;
+	fMaskFirstShape[fMaskCount] = fTotalShapeCount;
+	delete[] masks;
+
+	if (_BuildIdTable() != B_OK) {
+		Unset();
+		return B_NO_MEMORY;
+	}
+
+	fImage = image;
+	return B_OK;
+}
+
+
+void
+SVGGeometry::Unset()
+{
+	delete[] fShapes;
+	delete[] fStyles;
+	delete[] fShapeBounds;
+	delete[] fShapeFirstPath;
+	delete[] fShapeMask;
+	delete[] fVisibleShapes;
+	delete[] fMaskFirstShape;
+	delete[] fPathFirstPoint;
+	delete[] fPathClosed;
+	delete[] fPoints;
+	delete[] fIdTable;
+
+	fImage = NULL;
+	fShapeCount = 0;
+	fTotalShapeCount = 0;
+	fShapes = NULL;
+	fStyles = NULL;
+	fShapeBounds = NULL;
+	fShapeFirstPath = NULL;
+	fShapeMask = NULL;
+	fVisibleCount = 0;
+	fVisibleShapes = NULL;
+	fMaskCount = 0;
+	fMaskFirstShape = NULL;
+	fPathCount = 0;
+	fPathFirstPoint = NULL;
+	fPathClosed = NULL;
+	fPointCount = 0;
+	fPoints = NULL;
+	fIdTable = NULL;
+	fIdTableMask = 0;
+}
+
+
+void
+SVGGeometry::ShapeSize(int32 shape, float& width, float& height) const
+{
+	const SVGShapeStyle& style = fStyles[shape];
+	const float* bounds = fShapeBounds + shape * 4;
+
+	float stroke = 0.0f;
+	if (style.stroke.type != NSVG_PAINT_NONE && style.strokeWidth > 0.0f)
+		stroke = style.strokeWidth;
+
+	width = bounds[2] - bounds[0] + stroke;
+	height = bounds[3] - bounds[1] + stroke;
+}
+
+
+int32
+SVGGeometry::PathShape(int32 path) const
+{
+	// Shapes without paths share their start with the next shape, so the
+	// last shape starting at or before the path is the one that owns it
+	const int32* first = fShapeFirstPath;
+	const int32* end = first + fTotalShapeCount;
+	return (int32)(std::upper_bound(first, end, path) - first) - 1;
+}
+
+
+int32
+SVGGeometry::FindShapeById(const char* id) const
+{
+	if (fIdTable == NULL || id == NULL || id[0] == '\0')
+		return -1;
+
+	for (uint32 slot = hash_id(id) & fIdTableMask; fIdTable[slot] >= 0;
+			slot = (slot + 1) & fIdTableMask) {
+		if (strcmp(fShapes[fIdTable[slot]]->id, id) == 0)
+			return fIdTable[slot];
+	}
+	return -1;
+}
+
+
+uint32
+SVGGeometry::AverageColor(const SVGPaint& paint)
+{
+	if (paint.type == NSVG_PAINT_COLOR)
+		return paint.color;
+
+	const NSVGgradient* gradient = paint.gradient;
+	if (gradient == NULL || gradient->nstops == 0)
+		return 0;
+
+	uint32 sum[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < gradient->nstops; i++) {
+		uint32 color = gradient->stops[i].color;
+		for (int32 channel = 0; channel < 4; channel++)
+			sum[channel] += (color >> (channel * 8)) & 0xff;
+	}
+
+	uint32 color = 0;
+	for (int32 channel = 0; channel < 4; channel++)
+		color |= (sum[channel] / gradient->nstops) << (channel * 8);
+	return color;
+}
+
+
+status_t
+SVGGeometry::_BuildIdTable()
+{
+	int32 idCount = 0;
+	for (int32 shape = 0; shape < fShapeCount; shape++) {
+		if (fShapes[shape]->id[0] != '\0')
+			idCount++;
+	}
+	if (idCount == 0)
+		return B_OK;
+
+	// Keep the table at most half full so that probe runs stay short
+	uint32 size = 16;
+	while (size < (uint32)idCount * 2)
+		size <<= 1;
+
+	fIdTable = new(std::nothrow) int32[size];
+	if (fIdTable == NULL)
+		return B_NO_MEMORY;
+	fIdTableMask = size - 1;
+	for (uint32 slot = 0; slot < size; slot++)
+		fIdTable[slot] = -1;
+
+	for (int32 shape = 0; shape < fShapeCount; shape++) {
+		const char* id = fShapes[shape]->id;
+		if (id[0] == '\0')
+			continue;
+
+		uint32 slot = hash_id(id) & fIdTableMask;
+		while (fIdTable[slot] >= 0
+			&& strcmp(fShapes[fIdTable[slot]]->id, id) != 0)
+			slot = (slot + 1) & fIdTableMask;
+		if (fIdTable[slot] < 0)
+			fIdTable[slot] = shape;
+	}
+	return B_OK;
+}
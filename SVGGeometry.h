@@ -0,0 +1,151 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_GEOMETRY_H
+#define SVG_GEOMETRY_H
+
+#include "SVGPlatform.h"
+
+#include "nanosvg.h"
+
+// Fill or stroke paint of a shape, packed so that the style of a shape
+// fits into one or two cache lines
+struct SVGPaint {
+	NSVGgradient*			gradient;
+	uint32					color;
+	int8					type;
+};
+
+// Set in SVGShapeStyle::flags, next to the nanosvg flags, for shapes that
+// cannot put any color on the screen
+#define SVG_SHAPE_TRANSPARENT	0x80
+
+struct SVGShapeStyle {
+	SVGPaint				fill;
+	SVGPaint				stroke;
+	float					opacity;
+	float					strokeWidth;
+	float					miterLimit;
+	int8					fillRule;
+	int8					strokeLineCap;
+	int8					strokeLineJoin;
+	uint8					flags;
+};
+
+// Structure of arrays copy of the document geometry. All points live in
+// one contiguous array and shapes and paths are described by offset/count
+// tables, so walking the document does not chase list pointers.
+//
+// Shapes keep their document order and index, including invisible ones.
+// The shapes of all masks are appended after the document shapes, each
+// mask being a contiguous range of them.
+class SVGGeometry {
+public:
+							SVGGeometry();
+							~SVGGeometry();
+
+	status_t				SetTo(NSVGimage* image);
+	void					Unset();
+
+	NSVGimage*				Image() const { return fImage; }
+
+	// Number of document shapes, without the mask shapes
+	int32					CountShapes() const { return fShapeCount; }
+	int32					CountVisibleShapes() const
+								{ return fVisibleCount; }
+	int32					CountMasks() const { return fMaskCount; }
+	int32					CountPaths() const { return fPathCount; }
+	int32					CountPoints() const { return fPointCount; }
+
+	// The nanosvg shape, for attributes that are not part of the store
+	NSVGshape*				ShapeAt(int32 shape) const
+								{ return fShapes[shape]; }
+	const SVGShapeStyle&	ShapeStyle(int32 shape) const
+								{ return fStyles[shape]; }
+	bool					IsShapeVisible(int32 shape) const
+								{ return (fStyles[shape].flags
+									& NSVG_FLAGS_VISIBLE) != 0; }
+	// Zero opacity or fully transparent paint. Such shapes are only drawn
+	// in outline mode.
+	bool					IsShapeTransparent(int32 shape) const
+								{ return (fStyles[shape].flags
+									& SVG_SHAPE_TRANSPARENT) != 0; }
+	const float*			ShapeBounds(int32 shape) const
+								{ return fShapeBounds + shape * 4; }
+	int32					ShapeFirstPath(int32 shape) const
+								{ return fShapeFirstPath[shape]; }
+	int32					ShapePathCount(int32 shape) const
+								{ return fShapeFirstPath[shape + 1]
+									- fShapeFirstPath[shape]; }
+	// Painted size in document units, the stroke included
+	void					ShapeSize(int32 shape, float& width,
+								float& height) const;
+	// Mask index or -1 if the shape is not masked by a non-empty mask
+	int32					ShapeMask(int32 shape) const
+								{ return fShapeMask[shape]; }
+
+	int32					MaskFirstShape(int32 mask) const
+								{ return fMaskFirstShape[mask]; }
+	int32					MaskShapeCount(int32 mask) const
+								{ return fMaskFirstShape[mask + 1]
+									- fMaskFirstShape[mask]; }
+
+	// Points are x/y pairs in document units
+	const float*			PathPoints(int32 path) const
+								{ return fPoints
+									+ (size_t)fPathFirstPoint[path] * 2; }
+	int32					PathPointCount(int32 path) const
+								{ return fPathFirstPoint[path + 1]
+									- fPathFirstPoint[path]; }
+	bool					IsPathClosed(int32 path) const
+								{ return fPathClosed[path] != 0; }
+	// The shape, or mask shape, a path belongs to
+	int32					PathShape(int32 path) const;
+
+	// Document shape with the given SVG id, or -1. The first shape wins
+	// if an id is used more than once.
+	int32					FindShapeById(const char* id) const;
+
+	// Position of the i-th visible shape in document order. Transparent
+	// shapes are listed too, so that they can be outlined and hit.
+	const int32*			VisibleShapes() const { return fVisibleShapes; }
+
+	// The paint color averaged over the gradient stops, in the nanosvg
+	// ABGR layout
+	static uint32			AverageColor(const SVGPaint& paint);
+
+private:
+	status_t				_BuildIdTable();
+
+private:
+	NSVGimage*				fImage;
+
+	int32					fShapeCount;
+	int32					fTotalShapeCount;
+	NSVGshape**				fShapes;
+	SVGShapeStyle*			fStyles;
+	float*					fShapeBounds;
+	int32*					fShapeFirstPath;
+	int32*					fShapeMask;
+
+	int32					fVisibleCount;
+	int32*					fVisibleShapes;
+
+	int32					fMaskCount;
+	int32*					fMaskFirstShape;
+
+	int32					fPathCount;
+	int32*					fPathFirstPoint;
+	uint8*					fPathClosed;
+
+	int32					fPointCount;
+	float*					fPoints;
+
+	// Open addressing table of document shape indices hashed by id
+	int32*					fIdTable;
+	uint32					fIdTableMask;
+};
+
+#endif
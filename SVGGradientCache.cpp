@@ -0,0 +1,272 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGGradientCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+
+struct SVGGradientCache::Entry {
+	SVGGradientKey			key;
+	Entry*					previous;
+	Entry*					next;
+	size_t					size;
+	void*					data;
+	BBitmap*				bitmap;
+	BRect					frame;
+
+							Entry(const SVGGradientKey& key)
+								: key(key), previous(NULL), next(NULL),
+								size(0), data(NULL), bitmap(NULL) {}
+							~Entry() { free(data); delete bitmap; }
+};
+
+
+static inline size_t
+hash_bytes(size_t hash, const void* data, size_t length)
+{
+	const uint8* bytes = (const uint8*)data;
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+
+static inline size_t
+hash_float(size_t hash, float value)
+{
+	// Equal keys need equal hashes, and -0.0f == 0.0f
+	value += 0.0f;
+	return hash_bytes(hash, &value, sizeof(value));
+}
+
+
+SVGGradientKey::SVGGradientKey(const NSVGgradient* gradient, int32 resource)
+	:
+	gradient(gradient),
+	resource(resource),
+	type(0),
+	shape(-1),
+	opacity(1.0f),
+	scale(1.0f),
+	offsetX(0.0f),
+	offsetY(0.0f),
+	bounds()
+{
+}
+
+
+bool
+SVGGradientKey::operator==(const SVGGradientKey& other) const
+{
+	return gradient == other.gradient && resource == other.resource
+		&& type == other.type && shape == other.shape
+		&& opacity == other.opacity && scale == other.scale
+		&& offsetX == other.offsetX && offsetY == other.offsetY
+		&& bounds == other.bounds;
+}
+
+
+size_t
+SVGGradientKey::Hash() const
+{
+	size_t hash = (size_t)14695981039346656037ULL;
+	hash = hash_bytes(hash, &gradient, sizeof(gradient));
+	hash = hash_bytes(hash, &resource, sizeof(resource));
+	hash = hash_bytes(hash, &type, sizeof(type));
+	hash = hash_bytes(hash, &shape, sizeof(shape));
+	hash = hash_float(hash, opacity);
+	hash = hash_float(hash, scale);
+	hash = hash_float(hash, offsetX);
+	hash = hash_float(hash, offsetY);
+	hash = hash_float(hash, bounds.left);
+	hash = hash_float(hash, bounds.top);
+	hash = hash_float(hash, bounds.right);
+	hash = hash_float(hash, bounds.bottom);
+	return hash;
+}
+
+
+//	#pragma mark - SVGGradientCache
+
+
+SVGGradientCache::SVGGradientCache()
+	:
+	fFirst(NULL),
+	fLast(NULL),
+	fSize(0),
+	fLimit(16 * 1024 * 1024)
+{
+}
+
+
+SVGGradientCache::~SVGGradientCache()
+{
+	Clear();
+}
+
+
+void
+SVGGradientCache::SetLimit(size_t bytes)
+{
+	fLimit = bytes;
+	_MakeRoom(0);
+}
+
+
+void
+SVGGradientCache::Clear()
+{
+	while (fLast != NULL)
+		_Remove(fLast);
+}
+
+
+const void*
+SVGGradientCache::Find(const SVGGradientKey& key)
+{
+	Entry* entry = _Lookup(key);
+	return entry != NULL ? entry->data : NULL;
+}
+
+
+void*
+SVGGradientCache::Add(const SVGGradientKey& key, size_t size)
+{
+	void* data = malloc(size);
+	if (data == NULL)
+		return NULL;
+
+	Entry* entry = _Insert(key, size);
+	if (entry == NULL) {
+		free(data);
+		return NULL;
+	}
+
+	entry->data = data;
+	return data;
+}
+
+
+BBitmap*
+SVGGradientCache::FindBitmap(const SVGGradientKey& key, BRect* frame)
+{
+	Entry* entry = _Lookup(key);
+	if (entry == NULL || entry->bitmap == NULL)
+		return NULL;
+
+	if (frame != NULL)
+		*frame = entry->frame;
+	return entry->bitmap;
+}
+
+
+bool
+SVGGradientCache::AddBitmap(const SVGGradientKey& key, BBitmap* bitmap,
+	BRect frame)
+{
+	if (bitmap == NULL)
+		return false;
+
+	Entry* entry = _Insert(key, bitmap->BitsLength());
+	if (entry == NULL)
+		return false;
+
+	entry->bitmap = bitmap;
+	entry->frame = frame;
+	return true;
+}
+
+
+bool
+SVGGradientCache::Accepts(size_t size) const
+{
+	return size + sizeof(Entry) <= fLimit;
+}
+
+
+SVGGradientCache::Entry*
+SVGGradientCache::_Lookup(const SVGGradientKey& key)
+{
+	EntryMap::iterator found = fEntries.find(key);
+	if (found == fEntries.end())
+		return NULL;
+
+	// Move to the front of the LRU list
+	Entry* entry = found->second;
+	if (entry != fFirst) {
+		entry->previous->next = entry->next;
+		if (entry->next != NULL)
+			entry->next->previous = entry->previous;
+		else
+			fLast = entry->previous;
+
+		entry->previous = NULL;
+		entry->next = fFirst;
+		fFirst->previous = entry;
+		fFirst = entry;
+	}
+	return entry;
+}
+
+
+SVGGradientCache::Entry*
+SVGGradientCache::_Insert(const SVGGradientKey& key, size_t size)
+{
+	size += sizeof(Entry);
+	if (size > fLimit)
+		return NULL;
+
+	EntryMap::iterator found = fEntries.find(key);
+	if (found != fEntries.end())
+		_Remove(found->second);
+
+	_MakeRoom(size);
+
+	Entry* entry = new(std::nothrow) Entry(key);
+	if (entry == NULL)
+		return NULL;
+
+	fEntries[key] = entry;
+	entry->size = size;
+	entry->next = fFirst;
+	if (fFirst != NULL)
+		fFirst->previous = entry;
+	fFirst = entry;
+	if (fLast == NULL)
+		fLast = entry;
+
+	fSize += size;
+	return entry;
+}
+
+
+void
+SVGGradientCache::_Remove(Entry* entry)
+{
+	if (entry->previous != NULL)
+		entry->previous->next = entry->next;
+	else
+		fFirst = entry->next;
+	if (entry->next != NULL)
+		entry->next->previous = entry->previous;
+	else
+		fLast = entry->previous;
+
+	fEntries.erase(entry->key);
+	fSize -= entry->size;
+	delete entry;
+}
+
+
+void
+SVGGradientCache::_MakeRoom(size_t size)
+{
+	while (fLast != NULL && fSize + size > fLimit)
+		_Remove(fLast);
+}
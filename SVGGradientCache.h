@@ -0,0 +1,94 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_GRADIENT_CACHE_H
+#define SVG_GRADIENT_CACHE_H
+
+#include <Bitmap.h>
+#include <Rect.h>
+
+#include <unordered_map>
+
+#include "nanosvg.h"
+
+enum svg_gradient_resource {
+	SVG_GRADIENT_TABLE = 0,
+	SVG_GRADIENT_INVERSE,
+	SVG_GRADIENT_FILL_BITMAP,
+	SVG_GRADIENT_STROKE_BITMAP
+};
+
+// Identifies one derived gradient resource. Fields a resource does not
+// depend on are left at their defaults.
+struct SVGGradientKey {
+	const NSVGgradient*		gradient;
+	int32					resource;
+	int32					type;
+	int32					shape;
+	float					opacity;
+	float					scale;
+	float					offsetX;
+	float					offsetY;
+	BRect					bounds;
+
+							SVGGradientKey(const NSVGgradient* gradient,
+								int32 resource);
+
+	bool					operator==(const SVGGradientKey& other) const;
+	size_t					Hash() const;
+};
+
+// Resources derived from the gradients of a document: inverse transforms,
+// color tables and rasterized bitmaps. The least recently used entries
+// are dropped when the cache grows over its byte limit.
+//
+// Returned pointers stay valid until the next call that adds an entry.
+class SVGGradientCache {
+public:
+							SVGGradientCache();
+							~SVGGradientCache();
+
+	void					SetLimit(size_t bytes);
+	size_t					Limit() const { return fLimit; }
+	size_t					Size() const { return fSize; }
+	void					Clear();
+
+	// Plain data entries
+	const void*				Find(const SVGGradientKey& key);
+	// Returns a buffer of the given size to fill, or NULL if it does not
+	// fit into the cache
+	void*					Add(const SVGGradientKey& key, size_t size);
+
+	// Bitmaps together with the view rectangle they are drawn to
+	BBitmap*				FindBitmap(const SVGGradientKey& key,
+								BRect* frame = NULL);
+	// Takes ownership of the bitmap on success
+	bool					AddBitmap(const SVGGradientKey& key,
+								BBitmap* bitmap, BRect frame);
+	// Whether an entry of that many bytes fits under the limit at all
+	bool					Accepts(size_t size) const;
+
+private:
+	struct Entry;
+	struct KeyHash {
+		size_t operator()(const SVGGradientKey& key) const
+			{ return key.Hash(); }
+	};
+	typedef std::unordered_map<SVGGradientKey, Entry*, KeyHash> EntryMap;
+
+	Entry*					_Lookup(const SVGGradientKey& key);
+	Entry*					_Insert(const SVGGradientKey& key, size_t size);
+	void					_Remove(Entry* entry);
+	void					_MakeRoom(size_t size);
+
+private:
+	EntryMap				fEntries;
+	Entry*					fFirst;
+	Entry*					fLast;
+	size_t					fSize;
+	size_t					fLimit;
+};
+
+#endif
@@ -0,0 +1,705 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGGradientKernel.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nanosvg.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <emmintrin.h>
+#define SVG_GRADIENT_SSE2 1
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#define SVG_GRADIENT_AVX2 1
+#endif
+#endif
+
+// All variants evaluate the same float expressions in the same order.
+// The AVX2 code is compiled without FMA on purpose, fused multiply-adds
+// would round differently than the scalar code.
+
+
+//	#pragma mark - color
+
+
+void
+svg_gradient_color(const NSVGgradient* gradient, float t, float opacity,
+	uint8* rgba)
+{
+	if (!gradient || gradient->nstops <= 0) {
+		memset(rgba, 0, 4);
+		return;
+	}
+
+	if (t < 0.0f)
+		t = 0.0f;
+	if (t > 1.0f)
+		t = 1.0f;
+
+	int stop0 = 0;
+	int stop1 = gradient->nstops - 1;
+
+	for (int i = 0; i < gradient->nstops - 1; i++) {
+		if (t >= gradient->stops[i].offset && t <= gradient->stops[i + 1].offset) {
+			stop0 = i;
+			stop1 = i + 1;
+			break;
+		}
+	}
+
+	float offset0 = gradient->stops[stop0].offset;
+	float offset1 = gradient->stops[stop1].offset;
+	float range = offset1 - offset0;
+	float localT = (range > 0.0001f) ? (t - offset0) / range : 0.0f;
+	if (localT < 0.0f)
+		localT = 0.0f;
+	if (localT > 1.0f)
+		localT = 1.0f;
+
+	unsigned int c0 = gradient->stops[stop0].color;
+	unsigned int c1 = gradient->stops[stop1].color;
+
+	uint8 r0 = (c0 >> 0) & 0xFF;
+	uint8 g0 = (c0 >> 8) & 0xFF;
+	uint8 b0 = (c0 >> 16) & 0xFF;
+	uint8 a0 = (c0 >> 24) & 0xFF;
+
+	uint8 r1 = (c1 >> 0) & 0xFF;
+	uint8 g1 = (c1 >> 8) & 0xFF;
+	uint8 b1 = (c1 >> 16) & 0xFF;
+	uint8 a1 = (c1 >> 24) & 0xFF;
+
+	float alpha0 = a0 / 255.0f;
+	float alpha1 = a1 / 255.0f;
+	float alpha = alpha0 + (alpha1 - alpha0) * localT;
+
+	rgba[0] = (uint8)(r0 + (int)(r1 - r0) * localT);
+	rgba[1] = (uint8)(g0 + (int)(g1 - g0) * localT);
+	rgba[2] = (uint8)(b0 + (int)(b1 - b0) * localT);
+	rgba[3] = (uint8)(alpha * opacity * 255.0f);
+}
+
+
+//	#pragma mark - scalar
+
+
+static inline float
+spread_scalar(int8 spread, float t)
+{
+	switch (spread) {
+		case NSVG_SPREAD_REPEAT:
+			t = t - floorf(t);
+			if (t < 0.0f)
+				t += 1.0f;
+			return t;
+
+		case NSVG_SPREAD_REFLECT:
+		{
+			t = fabsf(t);
+			int period = (int)floorf(t);
+			t = t - period;
+			if (period % 2 != 0)
+				t = 1.0f - t;
+			return t;
+		}
+
+		case NSVG_SPREAD_PAD:
+		default:
+			if (t < 0.0f)
+				return 0.0f;
+			if (t > 1.0f)
+				return 1.0f;
+			return t;
+	}
+}
+
+
+static inline const uint8*
+lookup_scalar(const SVGGradientRow& row, float cx, float cy, int32 i)
+{
+	const float* m = row.xform;
+	float x = row.startX + (float)i * row.stepX;
+	float gx = m[0] * x + cx;
+	float gy = m[1] * x + cy;
+
+	float t;
+	if (row.type == NSVG_PAINT_LINEAR_GRADIENT)
+		t = gy;
+	else
+		t = sqrtf(gx * gx + gy * gy);
+
+	t = spread_scalar(row.spread, t);
+
+	int idx = (int)(t * 255.0f + 0.5f);
+	if (idx < 0)
+		idx = 0;
+	if (idx > 255)
+		idx = 255;
+
+	return row.lut + idx * 4;
+}
+
+
+static void
+fill_scalar(const SVGGradientRow& row, uint8* dst, int32 first, int32 count)
+{
+	float cx = row.xform[2] * row.y + row.xform[4];
+	float cy = row.xform[3] * row.y + row.xform[5];
+
+	for (int32 i = first; i < count; i++)
+		memcpy(dst + i * 4, lookup_scalar(row, cx, cy, i), 4);
+}
+
+
+static void
+apply_scalar(const SVGGradientRow& row, uint8* dst, int32 first, int32 count)
+{
+	float cx = row.xform[2] * row.y + row.xform[4];
+	float cy = row.xform[3] * row.y + row.xform[5];
+
+	for (int32 i = first; i < count; i++) {
+		uint8* pixel = dst + i * 4;
+		uint8 alpha = pixel[3];
+		if (alpha == 0)
+			continue;
+
+		const uint8* c = lookup_scalar(row, cx, cy, i);
+		pixel[0] = c[0];
+		pixel[1] = c[1];
+		pixel[2] = c[2];
+		pixel[3] = (uint8)(((uint16)c[3] * alpha) / 255);
+	}
+}
+
+
+//	#pragma mark - focal
+
+
+static const int32 kFocalAnchorInterval = 64;
+static const float kMaxFocalDistance = 0.99f;
+
+
+static inline bool
+has_focal_point(const SVGGradientRow& row)
+{
+	return row.type == NSVG_PAINT_RADIAL_GRADIENT
+		&& row.fx * row.fx + row.fy * row.fy >= 0.001f * 0.001f;
+}
+
+
+// For the focal point F on the unit circle and D = P - F, the parameter
+// t of P solves |F + D / t| = 1. With b = F.D and k = 1 - |F|^2 that is
+// t = (b + sqrt(b^2 + k |D|^2)) / k. Along a row D changes linearly, so
+// b is updated by a constant and |D|^2 by second order differences. The
+// differences are restarted from exact values every few pixels. Near the
+// circle k gets small and the division magnifies every rounding error, so
+// the quadratic is evaluated in double precision, and t is reduced to a
+// couple of periods before it is narrowed again.
+static void
+focal_row(const SVGGradientRow& row, uint8* dst, int32 count, bool apply)
+{
+	const float* m = row.xform;
+	double fx = row.fx;
+	double fy = row.fy;
+	double distance = sqrt(fx * fx + fy * fy);
+	if (distance > kMaxFocalDistance) {
+		fx *= kMaxFocalDistance / distance;
+		fy *= kMaxFocalDistance / distance;
+	}
+	double k = 1.0 - (fx * fx + fy * fy);
+	double invK = 1.0 / k;
+
+	double cx = (double)m[2] * row.y + m[4];
+	double cy = (double)m[3] * row.y + m[5];
+	double dgx = (double)m[0] * row.stepX;
+	double dgy = (double)m[1] * row.stepX;
+	double db = fx * dgx + fy * dgy;
+	double ddq = 2.0 * (dgx * dgx + dgy * dgy);
+
+	for (int32 first = 0; first < count; first += kFocalAnchorInterval) {
+		int32 last = first + kFocalAnchorInterval;
+		if (last > count)
+			last = count;
+
+		double x = (double)row.startX + (double)first * row.stepX;
+		double dx = m[0] * x + cx - fx;
+		double dy = m[1] * x + cy - fy;
+		double b = fx * dx + fy * dy;
+		double q = dx * dx + dy * dy;
+		double dq = 2.0 * (dx * dgx + dy * dgy) + 0.5 * ddq;
+
+		for (int32 i = first; i < last; i++, b += db, q += dq, dq += ddq) {
+			uint8* pixel = dst + i * 4;
+			if (apply && pixel[3] == 0)
+				continue;
+
+			double discriminant = b * b + k * q;
+			double t = (b + sqrt(discriminant > 0.0 ? discriminant : 0.0))
+				* invK;
+			// Both repeat and reflect have a period of two
+			if (row.spread != NSVG_SPREAD_PAD)
+				t -= 2.0 * floor(t * 0.5);
+			float spread = spread_scalar(row.spread, (float)t);
+
+			int idx = (int)(spread * 255.0f + 0.5f);
+			if (idx < 0)
+				idx = 0;
+			if (idx > 255)
+				idx = 255;
+
+			const uint8* c = row.lut + idx * 4;
+			if (apply) {
+				uint8 alpha = pixel[3];
+				pixel[0] = c[0];
+				pixel[1] = c[1];
+				pixel[2] = c[2];
+				pixel[3] = (uint8)(((uint16)c[3] * alpha) / 255);
+			} else
+				memcpy(pixel, c, 4);
+		}
+	}
+}
+
+
+//	#pragma mark - SSE2
+
+
+#ifdef SVG_GRADIENT_SSE2
+
+static inline __m128
+floor_sse2(__m128 t)
+{
+	// Truncation only works below 2^23, above that every float is integral
+	__m128 absT = _mm_andnot_ps(_mm_set1_ps(-0.0f), t);
+	__m128 small = _mm_cmplt_ps(absT, _mm_set1_ps(8388608.0f));
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+	__m128 floored = _mm_sub_ps(truncated,
+		_mm_and_ps(_mm_cmpgt_ps(truncated, t), _mm_set1_ps(1.0f)));
+	return _mm_or_ps(_mm_and_ps(small, floored), _mm_andnot_ps(small, t));
+}
+
+
+static inline __m128
+spread_sse2(int8 spread, __m128 t)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	switch (spread) {
+		case NSVG_SPREAD_REPEAT:
+			t = _mm_sub_ps(t, floor_sse2(t));
+			return _mm_add_ps(t, _mm_and_ps(_mm_cmplt_ps(t, zero), one));
+
+		case NSVG_SPREAD_REFLECT:
+		{
+			// For t >= 0 truncation is the same as (int)floorf(t)
+			t = _mm_andnot_ps(_mm_set1_ps(-0.0f), t);
+			__m128i period = _mm_cvttps_epi32(t);
+			t = _mm_sub_ps(t, _mm_cvtepi32_ps(period));
+			__m128 odd = _mm_castsi128_ps(_mm_cmpeq_epi32(
+				_mm_and_si128(period, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+			return _mm_or_ps(_mm_and_ps(odd, _mm_sub_ps(one, t)),
+				_mm_andnot_ps(odd, t));
+		}
+
+		case NSVG_SPREAD_PAD:
+		default:
+			// Operand order keeps NaN like the scalar comparisons do
+			return _mm_max_ps(zero, _mm_min_ps(one, t));
+	}
+}
+
+
+static inline __m128i
+index_sse2(const SVGGradientRow& row, __m128 x, __m128 ax, __m128 cx,
+	__m128 ay, __m128 cy)
+{
+	__m128 gy = _mm_add_ps(_mm_mul_ps(ay, x), cy);
+
+	__m128 t;
+	if (row.type == NSVG_PAINT_LINEAR_GRADIENT)
+		t = gy;
+	else {
+		__m128 gx = _mm_add_ps(_mm_mul_ps(ax, x), cx);
+		t = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)));
+	}
+
+	t = spread_sse2(row.spread, t);
+
+	__m128i idx = _mm_cvttps_epi32(_mm_add_ps(
+		_mm_mul_ps(t, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+	idx = _mm_andnot_si128(_mm_cmplt_epi32(idx, _mm_setzero_si128()), idx);
+	__m128i max = _mm_set1_epi32(255);
+	__m128i over = _mm_cmpgt_epi32(idx, max);
+	return _mm_or_si128(_mm_andnot_si128(over, idx), _mm_and_si128(over, max));
+}
+
+
+static inline __m128i
+gather_sse2(const uint8* lut, __m128i idx)
+{
+	int32 index[4];
+	uint32 pixels[4];
+	_mm_storeu_si128((__m128i*)index, idx);
+	for (int32 k = 0; k < 4; k++)
+		memcpy(&pixels[k], lut + index[k] * 4, 4);
+	return _mm_loadu_si128((const __m128i*)pixels);
+}
+
+
+static void
+fill_sse2(const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	const float* m = row.xform;
+	__m128 ax = _mm_set1_ps(m[0]);
+	__m128 ay = _mm_set1_ps(m[1]);
+	__m128 cx = _mm_set1_ps(m[2] * row.y + m[4]);
+	__m128 cy = _mm_set1_ps(m[3] * row.y + m[5]);
+	__m128 startX = _mm_set1_ps(row.startX);
+	__m128 stepX = _mm_set1_ps(row.stepX);
+	__m128 i4 = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	__m128 four = _mm_set1_ps(4.0f);
+
+	int32 i = 0;
+	for (; i + 4 <= count; i += 4, i4 = _mm_add_ps(i4, four)) {
+		__m128 x = _mm_add_ps(startX, _mm_mul_ps(i4, stepX));
+		__m128i idx = index_sse2(row, x, ax, cx, ay, cy);
+		_mm_storeu_si128((__m128i*)(dst + i * 4), gather_sse2(row.lut, idx));
+	}
+
+	fill_scalar(row, dst, i, count);
+}
+
+
+static void
+apply_sse2(const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	const float* m = row.xform;
+	__m128 ax = _mm_set1_ps(m[0]);
+	__m128 ay = _mm_set1_ps(m[1]);
+	__m128 cx = _mm_set1_ps(m[2] * row.y + m[4]);
+	__m128 cy = _mm_set1_ps(m[3] * row.y + m[5]);
+	__m128 startX = _mm_set1_ps(row.startX);
+	__m128 stepX = _mm_set1_ps(row.stepX);
+	__m128 i4 = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	__m128 four = _mm_set1_ps(4.0f);
+	__m128i colorMask = _mm_set1_epi32(0x00ffffff);
+
+	int32 i = 0;
+	for (; i + 4 <= count; i += 4, i4 = _mm_add_ps(i4, four)) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(dst + i * 4));
+		__m128i alpha = _mm_srli_epi32(pixels, 24);
+		__m128i transparent = _mm_cmpeq_epi32(alpha, _mm_setzero_si128());
+		if (_mm_movemask_epi8(transparent) == 0xffff)
+			continue;
+
+		__m128 x = _mm_add_ps(startX, _mm_mul_ps(i4, stepX));
+		__m128i color = gather_sse2(row.lut,
+			index_sse2(row, x, ax, cx, ay, cy));
+
+		// (a * alpha) / 255 is exact as (v * 0x8081) >> 23 for v < 65536;
+		// the products fit into the low 16 bit lanes
+		__m128i product = _mm_mullo_epi16(_mm_srli_epi32(color, 24), alpha);
+		__m128i newAlpha = _mm_srli_epi32(
+			_mm_mulhi_epu16(product, _mm_set1_epi32(0x8081)), 7);
+		color = _mm_or_si128(_mm_and_si128(color, colorMask),
+			_mm_slli_epi32(newAlpha, 24));
+
+		pixels = _mm_or_si128(_mm_and_si128(transparent, pixels),
+			_mm_andnot_si128(transparent, color));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), pixels);
+	}
+
+	apply_scalar(row, dst, i, count);
+}
+
+#endif	// SVG_GRADIENT_SSE2
+
+
+//	#pragma mark - AVX2
+
+
+#ifdef SVG_GRADIENT_AVX2
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+AVX2_FUNCTION static inline __m256
+spread_avx2(int8 spread, __m256 t)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	switch (spread) {
+		case NSVG_SPREAD_REPEAT:
+			t = _mm256_sub_ps(t, _mm256_floor_ps(t));
+			return _mm256_add_ps(t,
+				_mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_LT_OQ), one));
+
+		case NSVG_SPREAD_REFLECT:
+		{
+			t = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), t);
+			__m256i period = _mm256_cvttps_epi32(t);
+			t = _mm256_sub_ps(t, _mm256_cvtepi32_ps(period));
+			__m256i odd = _mm256_slli_epi32(period, 31);
+			return _mm256_blendv_ps(t, _mm256_sub_ps(one, t),
+				_mm256_castsi256_ps(odd));
+		}
+
+		case NSVG_SPREAD_PAD:
+		default:
+			return _mm256_max_ps(zero, _mm256_min_ps(one, t));
+	}
+}
+
+
+AVX2_FUNCTION static inline __m256i
+color_avx2(const SVGGradientRow& row, __m256 x, __m256 ax, __m256 cx,
+	__m256 ay, __m256 cy)
+{
+	__m256 gy = _mm256_add_ps(_mm256_mul_ps(ay, x), cy);
+
+	__m256 t;
+	if (row.type == NSVG_PAINT_LINEAR_GRADIENT)
+		t = gy;
+	else {
+		__m256 gx = _mm256_add_ps(_mm256_mul_ps(ax, x), cx);
+		t = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx),
+			_mm256_mul_ps(gy, gy)));
+	}
+
+	t = spread_avx2(row.spread, t);
+
+	__m256i idx = _mm256_cvttps_epi32(_mm256_add_ps(
+		_mm256_mul_ps(t, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+	idx = _mm256_min_epi32(_mm256_max_epi32(idx, _mm256_setzero_si256()),
+		_mm256_set1_epi32(255));
+
+	return _mm256_i32gather_epi32((const int*)row.lut, idx, 4);
+}
+
+
+AVX2_FUNCTION static void
+fill_avx2(const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	const float* m = row.xform;
+	__m256 ax = _mm256_set1_ps(m[0]);
+	__m256 ay = _mm256_set1_ps(m[1]);
+	__m256 cx = _mm256_set1_ps(m[2] * row.y + m[4]);
+	__m256 cy = _mm256_set1_ps(m[3] * row.y + m[5]);
+	__m256 startX = _mm256_set1_ps(row.startX);
+	__m256 stepX = _mm256_set1_ps(row.stepX);
+	__m256 i8 = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f,
+		7.0f);
+	__m256 eight = _mm256_set1_ps(8.0f);
+
+	int32 i = 0;
+	for (; i + 8 <= count; i += 8, i8 = _mm256_add_ps(i8, eight)) {
+		__m256 x = _mm256_add_ps(startX, _mm256_mul_ps(i8, stepX));
+		_mm256_storeu_si256((__m256i*)(dst + i * 4),
+			color_avx2(row, x, ax, cx, ay, cy));
+	}
+
+	fill_scalar(row, dst, i, count);
+}
+
+
+AVX2_FUNCTION static void
+apply_avx2(const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	const float* m = row.xform;
+	__m256 ax = _mm256_set1_ps(m[0]);
+	__m256 ay = _mm256_set1_ps(m[1]);
+	__m256 cx = _mm256_set1_ps(m[2] * row.y + m[4]);
+	__m256 cy = _mm256_set1_ps(m[3] * row.y + m[5]);
+	__m256 startX = _mm256_set1_ps(row.startX);
+	__m256 stepX = _mm256_set1_ps(row.stepX);
+	__m256 i8 = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f,
+		7.0f);
+	__m256 eight = _mm256_set1_ps(8.0f);
+	__m256i colorMask = _mm256_set1_epi32(0x00ffffff);
+
+	int32 i = 0;
+	for (; i + 8 <= count; i += 8, i8 = _mm256_add_ps(i8, eight)) {
+		__m256i pixels = _mm256_loadu_si256((const __m256i*)(dst + i * 4));
+		__m256i alpha = _mm256_srli_epi32(pixels, 24);
+		__m256i transparent = _mm256_cmpeq_epi32(alpha,
+			_mm256_setzero_si256());
+		if (_mm256_movemask_epi8(transparent) == -1)
+			continue;
+
+		__m256 x = _mm256_add_ps(startX, _mm256_mul_ps(i8, stepX));
+		__m256i color = color_avx2(row, x, ax, cx, ay, cy);
+
+		__m256i product = _mm256_mullo_epi32(_mm256_srli_epi32(color, 24),
+			alpha);
+		__m256i newAlpha = _mm256_srli_epi32(
+			_mm256_mullo_epi32(product, _mm256_set1_epi32(0x8081)), 23);
+		color = _mm256_or_si256(_mm256_and_si256(color, colorMask),
+			_mm256_slli_epi32(newAlpha, 24));
+
+		pixels = _mm256_blendv_epi8(color, pixels, transparent);
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), pixels);
+	}
+
+	apply_scalar(row, dst, i, count);
+}
+
+#endif	// SVG_GRADIENT_AVX2
+
+
+//	#pragma mark - dispatch
+
+
+static bool
+kernel_supported(svg_gradient_kernel kernel)
+{
+	switch (kernel) {
+		case SVG_GRADIENT_KERNEL_SCALAR:
+			return true;
+#ifdef SVG_GRADIENT_SSE2
+		case SVG_GRADIENT_KERNEL_SSE2:
+			return true;
+#endif
+#ifdef SVG_GRADIENT_AVX2
+		case SVG_GRADIENT_KERNEL_AVX2:
+		{
+			static const bool sHasAVX2 = __builtin_cpu_supports("avx2");
+			return sHasAVX2;
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+
+static svg_gradient_kernel
+select_kernel()
+{
+	svg_gradient_kernel kernel = SVG_GRADIENT_KERNEL_AVX2;
+
+	const char* name = getenv("SVG_GRADIENT_KERNEL");
+	if (name != NULL) {
+		for (int32 i = SVG_GRADIENT_KERNEL_SCALAR;
+				i <= SVG_GRADIENT_KERNEL_AVX2; i++) {
+			if (strcmp(name, svg_gradient_kernel_name(
+					(svg_gradient_kernel)i)) == 0)
+				kernel = (svg_gradient_kernel)i;
+		}
+	}
+
+	while (!kernel_supported(kernel))
+		kernel = (svg_gradient_kernel)(kernel - 1);
+	return kernel;
+}
+
+
+svg_gradient_kernel
+svg_gradient_active_kernel()
+{
+	static const svg_gradient_kernel sKernel = select_kernel();
+	return sKernel;
+}
+
+
+const char*
+svg_gradient_kernel_name(svg_gradient_kernel kernel)
+{
+	switch (kernel) {
+		case SVG_GRADIENT_KERNEL_SSE2:
+			return "sse2";
+		case SVG_GRADIENT_KERNEL_AVX2:
+			return "avx2";
+		case SVG_GRADIENT_KERNEL_SCALAR:
+		default:
+			return "scalar";
+	}
+}
+
+
+bool
+svg_gradient_kernel_supported(svg_gradient_kernel kernel)
+{
+	return kernel_supported(kernel);
+}
+
+
+void
+svg_gradient_fill_row_with(svg_gradient_kernel kernel,
+	const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	if (has_focal_point(row)) {
+		focal_row(row, dst, count, false);
+		return;
+	}
+
+	while (!kernel_supported(kernel))
+		kernel = (svg_gradient_kernel)(kernel - 1);
+
+	switch (kernel) {
+#ifdef SVG_GRADIENT_AVX2
+		case SVG_GRADIENT_KERNEL_AVX2:
+			fill_avx2(row, dst, count);
+			break;
+#endif
+#ifdef SVG_GRADIENT_SSE2
+		case SVG_GRADIENT_KERNEL_SSE2:
+			fill_sse2(row, dst, count);
+			break;
+#endif
+		default:
+			fill_scalar(row, dst, 0, count);
+			break;
+	}
+}
+
+
+void
+svg_gradient_apply_row_with(svg_gradient_kernel kernel,
+	const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	if (has_focal_point(row)) {
+		focal_row(row, dst, count, true);
+		return;
+	}
+
+	while (!kernel_supported(kernel))
+		kernel = (svg_gradient_kernel)(kernel - 1);
+
+	switch (kernel) {
+#ifdef SVG_GRADIENT_AVX2
+		case SVG_GRADIENT_KERNEL_AVX2:
+			apply_avx2(row, dst, count);
+			break;
+#endif
+#ifdef SVG_GRADIENT_SSE2
+		case SVG_GRADIENT_KERNEL_SSE2:
+			apply_sse2(row, dst, count);
+			break;
+#endif
+		default:
+			apply_scalar(row, dst, 0, count);
+			break;
+	}
+}
+
+
+void
+svg_gradient_fill_row(const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	svg_gradient_fill_row_with(svg_gradient_active_kernel(), row, dst, count);
+}
+
+
+void
+svg_gradient_apply_row(const SVGGradientRow& row, uint8* dst, int32 count)
+{
+	svg_gradient_apply_row_with(svg_gradient_active_kernel(), row, dst,
+		count);
+}
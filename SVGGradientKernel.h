@@ -0,0 +1,77 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_GRADIENT_KERNEL_H
+#define SVG_GRADIENT_KERNEL_H
+
+#include "SVGPlatform.h"
+
+struct NSVGgradient;
+
+// Gradient span kernels. A row of pixels is mapped to gradient space, the
+// spread mode is applied and the color is looked up in a 256 entry table.
+// The SIMD variants are selected at runtime and produce exactly the same
+// bytes as the scalar one.
+//
+// Radial gradients with a focal point use the closed form of two-point
+// conical gradients, evaluated with forward differences along the row.
+// They run the same scalar code in every variant.
+
+enum svg_gradient_kernel {
+	SVG_GRADIENT_KERNEL_SCALAR = 0,
+	SVG_GRADIENT_KERNEL_SSE2,
+	SVG_GRADIENT_KERNEL_AVX2
+};
+
+struct SVGGradientRow {
+	// 256 pixels of 4 bytes, already in the byte order of the target
+	const uint8*			lut;
+	// Gradient transform, document to gradient space
+	const float*			xform;
+	int8					type;
+	int8					spread;
+	// Focal point of radial gradients in gradient space, where the end
+	// circle is the unit circle
+	float					fx;
+	float					fy;
+	// Document coordinates of pixel i are (startX + i * stepX, y)
+	float					startX;
+	float					stepX;
+	float					y;
+};
+
+// Color of the gradient at t, clamped to [0, 1], as red, green, blue and
+// alpha bytes with the opacity applied. A gradient without stops is
+// transparent. Every color table is built from this, so that the native
+// and the software renderer agree.
+void	svg_gradient_color(const NSVGgradient* gradient, float t,
+			float opacity, uint8* rgba);
+
+// Writes count pixels of the gradient
+void	svg_gradient_fill_row(const SVGGradientRow& row, uint8* dst,
+			int32 count);
+
+// Replaces the color of count B_RGBA32 pixels by the gradient, scaling the
+// gradient alpha by the existing alpha. Transparent pixels are skipped.
+void	svg_gradient_apply_row(const SVGGradientRow& row, uint8* dst,
+			int32 count);
+
+// The kernel in use. It can be forced with the SVG_GRADIENT_KERNEL
+// environment variable ("scalar", "sse2" or "avx2"); a kernel that is not
+// supported falls back to the best available one.
+svg_gradient_kernel		svg_gradient_active_kernel();
+const char*				svg_gradient_kernel_name(svg_gradient_kernel kernel);
+// Whether the kernel runs on this CPU, the _with functions below fall back
+// to the best supported one otherwise
+bool					svg_gradient_kernel_supported(
+							svg_gradient_kernel kernel);
+
+// Runs a specific kernel, for comparing the variants against each other
+void	svg_gradient_fill_row_with(svg_gradient_kernel kernel,
+			const SVGGradientRow& row, uint8* dst, int32 count);
+void	svg_gradient_apply_row_with(svg_gradient_kernel kernel,
+			const SVGGradientRow& row, uint8* dst, int32 count);
+
+#endif
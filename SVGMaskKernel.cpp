@@ -0,0 +1,373 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGMaskKernel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <emmintrin.h>
+#define SVG_MASK_SSE2 1
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <immintrin.h>
+#define SVG_MASK_AVX2 1
+#endif
+#endif
+
+// The divisions by 255 use (x + 1 + (x >> 8)) >> 8, which is exact for
+// every product of two bytes. The ratio of the new and the old alpha is
+// divided in single precision: both operands are below 2^16, so the
+// quotient is never rounded up to the next integer.
+
+// A mask pixel that leaves the content unchanged
+static const uint32 kOpaqueMask = 0xffffffff;
+
+
+//	#pragma mark - scalar
+
+
+// Straight alpha content only has its alpha scaled
+template<bool kScaleColors>
+static void
+apply_scalar(uint8* content, const uint8* mask, int32 start, int32 count)
+{
+	for (int32 i = start; i < count; i++) {
+		uint8* pixel = content + i * 4;
+		const uint8* maskPixel = mask + i * 4;
+
+		uint32 luminance = (54 * maskPixel[2] + 183 * maskPixel[1]
+			+ 19 * maskPixel[0]) >> 8;
+		if (luminance > 255)
+			luminance = 255;
+
+		uint32 maskOpacity = (luminance * maskPixel[3]) / 255;
+
+		uint8 contentA = pixel[3];
+		uint32 newAlpha = (contentA * maskOpacity) / 255;
+
+		pixel[3] = (uint8)newAlpha;
+
+		if (kScaleColors && contentA > 0 && newAlpha < contentA) {
+			uint32 ratio = (newAlpha * 255) / contentA;
+			pixel[0] = (uint8)((pixel[0] * ratio) / 255);
+			pixel[1] = (uint8)((pixel[1] * ratio) / 255);
+			pixel[2] = (uint8)((pixel[2] * ratio) / 255);
+		}
+	}
+}
+
+
+//	#pragma mark - SSE2
+
+
+#ifdef SVG_MASK_SSE2
+
+static inline __m128i
+div255_sse2(__m128i x)
+{
+	return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(x, _mm_set1_epi32(1)),
+		_mm_srli_epi32(x, 8)), 8);
+}
+
+
+// Products of values below 2^16 in 32 bit lanes whose upper halves are zero
+static inline __m128i
+mul16_sse2(__m128i a, __m128i b)
+{
+	return _mm_mullo_epi16(a, b);
+}
+
+
+template<bool kScaleColors>
+static inline __m128i
+apply4_sse2(__m128i c, __m128i m)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xff);
+
+	__m128i maskB = _mm_and_si128(m, byteMask);
+	__m128i maskG = _mm_and_si128(_mm_srli_epi32(m, 8), byteMask);
+	__m128i maskR = _mm_and_si128(_mm_srli_epi32(m, 16), byteMask);
+	__m128i maskA = _mm_srli_epi32(m, 24);
+
+	__m128i luminance = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(
+		mul16_sse2(maskR, _mm_set1_epi32(54)),
+		mul16_sse2(maskG, _mm_set1_epi32(183))),
+		mul16_sse2(maskB, _mm_set1_epi32(19))), 8);
+	__m128i maskOpacity = div255_sse2(mul16_sse2(luminance, maskA));
+
+	__m128i contentA = _mm_srli_epi32(c, 24);
+	__m128i newAlpha = div255_sse2(mul16_sse2(contentA, maskOpacity));
+	if (!kScaleColors) {
+		return _mm_or_si128(_mm_and_si128(c, _mm_set1_epi32(0x00ffffff)),
+			_mm_slli_epi32(newAlpha, 24));
+	}
+
+	// Transparent content keeps its colors, which a ratio of 255 does
+	__m128i transparent = _mm_cmpeq_epi32(contentA, _mm_setzero_si128());
+	__m128 numerator = _mm_cvtepi32_ps(
+		mul16_sse2(newAlpha, _mm_set1_epi32(255)));
+	__m128 denominator = _mm_cvtepi32_ps(
+		_mm_or_si128(contentA, _mm_and_si128(transparent, _mm_set1_epi32(1))));
+	__m128i ratio = _mm_cvttps_epi32(_mm_div_ps(numerator, denominator));
+	ratio = _mm_or_si128(_mm_andnot_si128(transparent, ratio),
+		_mm_and_si128(transparent, _mm_set1_epi32(255)));
+
+	__m128i b = div255_sse2(mul16_sse2(_mm_and_si128(c, byteMask), ratio));
+	__m128i g = div255_sse2(mul16_sse2(
+		_mm_and_si128(_mm_srli_epi32(c, 8), byteMask), ratio));
+	__m128i r = div255_sse2(mul16_sse2(
+		_mm_and_si128(_mm_srli_epi32(c, 16), byteMask), ratio));
+
+	return _mm_or_si128(_mm_or_si128(b, _mm_slli_epi32(g, 8)),
+		_mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(newAlpha, 24)));
+}
+
+
+template<bool kScaleColors>
+static void
+apply_sse2(uint8* content, const uint8* mask, int32 count)
+{
+	const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+	const __m128i opaque = _mm_set1_epi32(kOpaqueMask);
+
+	int32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i c = _mm_loadu_si128((const __m128i*)(content + i * 4));
+		__m128i m = _mm_loadu_si128((const __m128i*)(mask + i * 4));
+
+		// Nothing changes under transparent content or an opaque mask
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(c, alphaMask),
+				_mm_setzero_si128())) == 0xffff
+			|| _mm_movemask_epi8(_mm_cmpeq_epi32(m, opaque)) == 0xffff)
+			continue;
+
+		_mm_storeu_si128((__m128i*)(content + i * 4),
+			apply4_sse2<kScaleColors>(c, m));
+	}
+
+	apply_scalar<kScaleColors>(content, mask, i, count);
+}
+
+#endif	// SVG_MASK_SSE2
+
+
+//	#pragma mark - AVX2
+
+
+#ifdef SVG_MASK_AVX2
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+AVX2_FUNCTION static inline __m256i
+div255_avx2(__m256i x)
+{
+	return _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(x,
+		_mm256_set1_epi32(1)), _mm256_srli_epi32(x, 8)), 8);
+}
+
+
+template<bool kScaleColors>
+AVX2_FUNCTION static inline __m256i
+apply8_avx2(__m256i c, __m256i m)
+{
+	const __m256i byteMask = _mm256_set1_epi32(0xff);
+
+	__m256i maskB = _mm256_and_si256(m, byteMask);
+	__m256i maskG = _mm256_and_si256(_mm256_srli_epi32(m, 8), byteMask);
+	__m256i maskR = _mm256_and_si256(_mm256_srli_epi32(m, 16), byteMask);
+	__m256i maskA = _mm256_srli_epi32(m, 24);
+
+	__m256i luminance = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(
+		_mm256_mullo_epi16(maskR, _mm256_set1_epi32(54)),
+		_mm256_mullo_epi16(maskG, _mm256_set1_epi32(183))),
+		_mm256_mullo_epi16(maskB, _mm256_set1_epi32(19))), 8);
+	__m256i maskOpacity = div255_avx2(_mm256_mullo_epi16(luminance, maskA));
+
+	__m256i contentA = _mm256_srli_epi32(c, 24);
+	__m256i newAlpha = div255_avx2(_mm256_mullo_epi16(contentA, maskOpacity));
+	if (!kScaleColors) {
+		return _mm256_or_si256(_mm256_and_si256(c,
+			_mm256_set1_epi32(0x00ffffff)), _mm256_slli_epi32(newAlpha, 24));
+	}
+
+	__m256i transparent = _mm256_cmpeq_epi32(contentA,
+		_mm256_setzero_si256());
+	__m256 numerator = _mm256_cvtepi32_ps(
+		_mm256_mullo_epi16(newAlpha, _mm256_set1_epi32(255)));
+	__m256 denominator = _mm256_cvtepi32_ps(_mm256_or_si256(contentA,
+		_mm256_and_si256(transparent, _mm256_set1_epi32(1))));
+	__m256i ratio = _mm256_cvttps_epi32(_mm256_div_ps(numerator, denominator));
+	ratio = _mm256_blendv_epi8(ratio, _mm256_set1_epi32(255), transparent);
+
+	__m256i b = div255_avx2(_mm256_mullo_epi16(
+		_mm256_and_si256(c, byteMask), ratio));
+	__m256i g = div255_avx2(_mm256_mullo_epi16(
+		_mm256_and_si256(_mm256_srli_epi32(c, 8), byteMask), ratio));
+	__m256i r = div255_avx2(_mm256_mullo_epi16(
+		_mm256_and_si256(_mm256_srli_epi32(c, 16), byteMask), ratio));
+
+	return _mm256_or_si256(_mm256_or_si256(b, _mm256_slli_epi32(g, 8)),
+		_mm256_or_si256(_mm256_slli_epi32(r, 16),
+			_mm256_slli_epi32(newAlpha, 24)));
+}
+
+
+template<bool kScaleColors>
+AVX2_FUNCTION static void
+apply_avx2(uint8* content, const uint8* mask, int32 count)
+{
+	const __m256i alphaMask = _mm256_set1_epi32(0xff000000);
+	const __m256i opaque = _mm256_set1_epi32(kOpaqueMask);
+
+	int32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i c = _mm256_loadu_si256((const __m256i*)(content + i * 4));
+		__m256i m = _mm256_loadu_si256((const __m256i*)(mask + i * 4));
+
+		if (_mm256_testz_si256(c, alphaMask)
+			|| _mm256_movemask_epi8(_mm256_cmpeq_epi32(m, opaque)) == -1)
+			continue;
+
+		_mm256_storeu_si256((__m256i*)(content + i * 4),
+			apply8_avx2<kScaleColors>(c, m));
+	}
+
+	apply_scalar<kScaleColors>(content, mask, i, count);
+}
+
+#endif	// SVG_MASK_AVX2
+
+
+//	#pragma mark - dispatch
+
+
+static bool
+kernel_supported(svg_mask_kernel kernel)
+{
+	switch (kernel) {
+		case SVG_MASK_KERNEL_SCALAR:
+			return true;
+#ifdef SVG_MASK_SSE2
+		case SVG_MASK_KERNEL_SSE2:
+			return true;
+#endif
+#ifdef SVG_MASK_AVX2
+		case SVG_MASK_KERNEL_AVX2:
+		{
+			static const bool sHasAVX2 = __builtin_cpu_supports("avx2");
+			return sHasAVX2;
+		}
+#endif
+		default:
+			return false;
+	}
+}
+
+
+static svg_mask_kernel
+select_kernel()
+{
+	svg_mask_kernel kernel = SVG_MASK_KERNEL_AVX2;
+
+	const char* name = getenv("SVG_MASK_KERNEL");
+	if (name != NULL) {
+		for (int32 i = SVG_MASK_KERNEL_SCALAR; i <= SVG_MASK_KERNEL_AVX2;
+				i++) {
+			if (strcmp(name, svg_mask_kernel_name((svg_mask_kernel)i)) == 0)
+				kernel = (svg_mask_kernel)i;
+		}
+	}
+
+	while (!kernel_supported(kernel))
+		kernel = (svg_mask_kernel)(kernel - 1);
+	return kernel;
+}
+
+
+svg_mask_kernel
+svg_mask_active_kernel()
+{
+	static const svg_mask_kernel sKernel = select_kernel();
+	return sKernel;
+}
+
+
+const char*
+svg_mask_kernel_name(svg_mask_kernel kernel)
+{
+	switch (kernel) {
+		case SVG_MASK_KERNEL_SSE2:
+			return "sse2";
+		case SVG_MASK_KERNEL_AVX2:
+			return "avx2";
+		case SVG_MASK_KERNEL_SCALAR:
+		default:
+			return "scalar";
+	}
+}
+
+
+bool
+svg_mask_kernel_supported(svg_mask_kernel kernel)
+{
+	return kernel_supported(kernel);
+}
+
+
+template<bool kScaleColors>
+static void
+apply_with(svg_mask_kernel kernel, uint8* content, const uint8* mask,
+	int32 count)
+{
+	while (!kernel_supported(kernel))
+		kernel = (svg_mask_kernel)(kernel - 1);
+
+	switch (kernel) {
+#ifdef SVG_MASK_AVX2
+		case SVG_MASK_KERNEL_AVX2:
+			apply_avx2<kScaleColors>(content, mask, count);
+			break;
+#endif
+#ifdef SVG_MASK_SSE2
+		case SVG_MASK_KERNEL_SSE2:
+			apply_sse2<kScaleColors>(content, mask, count);
+			break;
+#endif
+		default:
+			apply_scalar<kScaleColors>(content, mask, 0, count);
+			break;
+	}
+}
+
+
+void
+svg_mask_apply_row_with(svg_mask_kernel kernel, uint8* content,
+	const uint8* mask, int32 count)
+{
+	apply_with<true>(kernel, content, mask, count);
+}
+
+
+void
+svg_mask_apply_row(uint8* content, const uint8* mask, int32 count)
+{
+	apply_with<true>(svg_mask_active_kernel(), content, mask, count);
+}
+
+
+void
+svg_mask_apply_alpha_row_with(svg_mask_kernel kernel, uint8* content,
+	const uint8* mask, int32 count)
+{
+	apply_with<false>(kernel, content, mask, count);
+}
+
+
+void
+svg_mask_apply_alpha_row(uint8* content, const uint8* mask, int32 count)
+{
+	apply_with<false>(svg_mask_active_kernel(), content, mask, count);
+}
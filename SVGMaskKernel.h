@@ -0,0 +1,44 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_MASK_KERNEL_H
+#define SVG_MASK_KERNEL_H
+
+#include "SVGPlatform.h"
+
+// Luminance mask compositing. The alpha of every content pixel is scaled
+// by the luminance of the mask pixel times its alpha, and the color
+// channels are scaled by the same ratio. The SIMD variants are selected at
+// runtime and produce exactly the same bytes as the scalar one.
+
+enum svg_mask_kernel {
+	SVG_MASK_KERNEL_SCALAR = 0,
+	SVG_MASK_KERNEL_SSE2,
+	SVG_MASK_KERNEL_AVX2
+};
+
+// Applies count B_RGBA32 mask pixels to the content pixels in place
+void	svg_mask_apply_row(uint8* content, const uint8* mask, int32 count);
+// Same for straight alpha content: only the alpha is scaled and the color
+// channels are kept
+void	svg_mask_apply_alpha_row(uint8* content, const uint8* mask,
+			int32 count);
+
+// The kernel in use. It can be forced with the SVG_MASK_KERNEL environment
+// variable ("scalar", "sse2" or "avx2"); a kernel that is not supported
+// falls back to the best available one.
+svg_mask_kernel			svg_mask_active_kernel();
+const char*				svg_mask_kernel_name(svg_mask_kernel kernel);
+// Whether the kernel runs on this CPU, the _with functions below fall back
+// to the best supported one otherwise
+bool					svg_mask_kernel_supported(svg_mask_kernel kernel);
+
+// Runs a specific kernel, for comparing the variants against each other
+void	svg_mask_apply_row_with(svg_mask_kernel kernel, uint8* content,
+			const uint8* mask, int32 count);
+void	svg_mask_apply_alpha_row_with(svg_mask_kernel kernel,
+			uint8* content, const uint8* mask, int32 count);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_PLATFORM_H
+#define SVG_PLATFORM_H
+
+// The software rendering engine only needs the basic integer types and
+// status codes, so it can also be built outside of Haiku (headless tools,
+// benchmarks).
+
+#ifdef __HAIKU__
+#include <SupportDefs.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int8_t		int8;
+typedef uint8_t		uint8;
+typedef int16_t		int16;
+typedef uint16_t	uint16;
+typedef int32_t		int32;
+typedef uint32_t	uint32;
+typedef int64_t		int64;
+typedef uint64_t	uint64;
+typedef int32		status_t;
+typedef int64		bigtime_t;
+
+#define B_OK			((status_t)0)
+#define B_ERROR			((status_t)-1)
+#define B_NO_MEMORY		((status_t)-2147483647 - 1)
+#define B_BAD_VALUE		((status_t)-2147483647 + 4)
+#define B_CANCELED		((status_t)-2147483647 + 6)
+#endif
+
+#endif
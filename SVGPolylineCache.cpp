@@ -0,0 +1,251 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGPolylineCache.h"
+
+#include <math.h>
+
+#include <new>
+
+#include "SVGGeometry.h"
+
+
+static const int32 kBucketsPerOctave = 2;
+static const int32 kMaxSegments = 1024;
+
+const float SVGPolylineCache::kTolerance = 0.25f;
+
+
+struct SVGPolylineCache::Entry {
+	uint64					key;
+	Entry*					previous;
+	Entry*					next;
+	size_t					size;
+	uint32					frame;
+	SVGPolyline				polyline;
+};
+
+
+// Uniform subdivision of a cubic. With Wang's formula the number of
+// segments follows from the second differences of the control points, so
+// the deviation is bounded without the recursion of AGG's curve_div.
+static void
+flatten_cubic(std::vector<float>& points, const float* pt, float tolerance)
+{
+	float x0 = pt[0], y0 = pt[1];
+	float x1 = pt[2], y1 = pt[3];
+	float x2 = pt[4], y2 = pt[5];
+	float x3 = pt[6], y3 = pt[7];
+
+	float d1 = hypotf(x0 - 2 * x1 + x2, y0 - 2 * y1 + y2);
+	float d2 = hypotf(x1 - 2 * x2 + x3, y1 - 2 * y2 + y3);
+	float segments = ceilf(sqrtf(0.75f * fmaxf(d1, d2) / tolerance));
+
+	int32 count = 1;
+	if (segments > 1.0f)
+		count = segments < kMaxSegments ? (int32)segments : kMaxSegments;
+
+	float step = 1.0f / count;
+	for (int32 i = 1; i < count; i++) {
+		float t = i * step;
+		float u = 1.0f - t;
+		float b0 = u * u * u;
+		float b1 = 3.0f * u * u * t;
+		float b2 = 3.0f * u * t * t;
+		float b3 = t * t * t;
+		points.push_back(b0 * x0 + b1 * x1 + b2 * x2 + b3 * x3);
+		points.push_back(b0 * y0 + b1 * y1 + b2 * y2 + b3 * y3);
+	}
+
+	// The end point is exact, so that closed paths stay closed
+	points.push_back(x3);
+	points.push_back(y3);
+}
+
+
+size_t
+SVGPolyline::MemorySize() const
+{
+	return sizeof(SVGPolyline) + fPoints.capacity() * sizeof(float)
+		+ fPathFirstPoint.capacity() * sizeof(int32);
+}
+
+
+//	#pragma mark - SVGPolylineCache
+
+
+SVGPolylineCache::SVGPolylineCache()
+	:
+	fGeometry(NULL),
+	fFirst(NULL),
+	fLast(NULL),
+	fSize(0),
+	fLimit(16 * 1024 * 1024),
+	fFrame(0)
+{
+}
+
+
+SVGPolylineCache::~SVGPolylineCache()
+{
+	Clear();
+}
+
+
+void
+SVGPolylineCache::SetGeometry(const SVGGeometry* geometry)
+{
+	Clear();
+	fGeometry = geometry;
+}
+
+
+void
+SVGPolylineCache::SetLimit(size_t bytes)
+{
+	fLimit = bytes;
+	_MakeRoom(0);
+}
+
+
+void
+SVGPolylineCache::Clear()
+{
+	while (fLast != NULL)
+		_Remove(fLast);
+}
+
+
+const SVGPolyline*
+SVGPolylineCache::Polyline(int32 shape, float scale)
+{
+	if (fGeometry == NULL || scale <= 0.0f)
+		return NULL;
+
+	int32 bucket = _Bucket(scale);
+	uint64 key = _Key(shape, bucket);
+
+	EntryMap::iterator found = fEntries.find(key);
+	if (found != fEntries.end()) {
+		// Move to the front of the LRU list
+		Entry* entry = found->second;
+		entry->frame = fFrame;
+		if (entry != fFirst) {
+			entry->previous->next = entry->next;
+			if (entry->next != NULL)
+				entry->next->previous = entry->previous;
+			else
+				fLast = entry->previous;
+
+			entry->previous = NULL;
+			entry->next = fFirst;
+			fFirst->previous = entry;
+			fFirst = entry;
+		}
+		return &entry->polyline;
+	}
+
+	Entry* entry = new(std::nothrow) Entry;
+	if (entry == NULL)
+		return NULL;
+
+	_Flatten(shape, bucket, entry->polyline);
+
+	entry->key = key;
+	entry->frame = fFrame;
+	entry->size = entry->polyline.MemorySize() + sizeof(Entry);
+	_MakeRoom(entry->size);
+
+	fEntries[key] = entry;
+	entry->previous = NULL;
+	entry->next = fFirst;
+	if (fFirst != NULL)
+		fFirst->previous = entry;
+	fFirst = entry;
+	if (fLast == NULL)
+		fLast = entry;
+
+	fSize += entry->size;
+	return &entry->polyline;
+}
+
+
+const SVGPolyline*
+SVGPolylineCache::Find(int32 shape, float scale) const
+{
+	if (scale <= 0.0f)
+		return NULL;
+
+	EntryMap::const_iterator found = fEntries.find(
+		_Key(shape, _Bucket(scale)));
+	return found != fEntries.end() ? &found->second->polyline : NULL;
+}
+
+
+int32
+SVGPolylineCache::_Bucket(float scale)
+{
+	return (int32)ceilf(log2f(scale) * kBucketsPerOctave);
+}
+
+
+void
+SVGPolylineCache::_Flatten(int32 shape, int32 bucket,
+	SVGPolyline& polyline) const
+{
+	// The largest scale of the bucket needs the finest subdivision
+	float scale = exp2f((float)bucket / kBucketsPerOctave);
+	float tolerance = kTolerance / scale;
+
+	int32 firstPath = fGeometry->ShapeFirstPath(shape);
+	int32 pathCount = fGeometry->ShapePathCount(shape);
+	polyline.fFirstPath = firstPath;
+
+	polyline.fPathFirstPoint.reserve(pathCount + 1);
+	for (int32 path = firstPath; path < firstPath + pathCount; path++) {
+		polyline.fPathFirstPoint.push_back(
+			(int32)(polyline.fPoints.size() / 2));
+
+		int32 count = fGeometry->PathPointCount(path);
+		if (count < 2)
+			continue;
+
+		const float* pt = fGeometry->PathPoints(path);
+		polyline.fPoints.push_back(pt[0]);
+		polyline.fPoints.push_back(pt[1]);
+		for (int32 i = 1; i + 2 < count; i += 3, pt += 6)
+			flatten_cubic(polyline.fPoints, pt, tolerance);
+	}
+	polyline.fPathFirstPoint.push_back((int32)(polyline.fPoints.size() / 2));
+}
+
+
+void
+SVGPolylineCache::_Remove(Entry* entry)
+{
+	if (entry->previous != NULL)
+		entry->previous->next = entry->next;
+	else
+		fFirst = entry->next;
+	if (entry->next != NULL)
+		entry->next->previous = entry->previous;
+	else
+		fLast = entry->previous;
+
+	fEntries.erase(entry->key);
+	fSize -= entry->size;
+	delete entry;
+}
+
+
+void
+SVGPolylineCache::_MakeRoom(size_t size)
+{
+	// Entries of the current frame are at the front of the list, and may
+	// still be in use
+	while (fLast != NULL && fLast->frame != fFrame
+		&& fSize + size > fLimit)
+		_Remove(fLast);
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_POLYLINE_CACHE_H
+#define SVG_POLYLINE_CACHE_H
+
+#include "SVGPlatform.h"
+
+#include <unordered_map>
+#include <vector>
+
+class SVGGeometry;
+
+// The paths of one shape with their curves flattened to line segments, in
+// document units. Paths keep the global path indices of the geometry.
+class SVGPolyline {
+public:
+	int32					FirstPath() const { return fFirstPath; }
+	int32					CountPaths() const
+								{ return (int32)fPathFirstPoint.size() - 1; }
+
+	// Points are x/y pairs; the first one starts the path
+	const float*			PathPoints(int32 path) const
+								{ return fPoints.data()
+									+ (size_t)fPathFirstPoint[path
+										- fFirstPath] * 2; }
+	int32					PathPointCount(int32 path) const
+								{ return fPathFirstPoint[path - fFirstPath + 1]
+									- fPathFirstPoint[path - fFirstPath]; }
+
+	size_t					MemorySize() const;
+
+private:
+	friend class SVGPolylineCache;
+
+	int32					fFirstPath;
+	std::vector<float>		fPoints;
+	std::vector<int32>		fPathFirstPoint;
+};
+
+// Flattened shapes per zoom bucket. A shape is flattened once for the
+// largest scale of its bucket, so that the deviation from the curves stays
+// below a fixed pixel error at any scale of the bucket, and the result is
+// reused for panning, fill, stroke and highlight.
+//
+// Polylines returned since the last NextFrame() are never evicted, the
+// cache may grow over its limit until the next frame instead. Polyline()
+// must not be called concurrently; Find() does not modify the cache and
+// may be called from several threads as long as nothing else does.
+class SVGPolylineCache {
+public:
+							SVGPolylineCache();
+							~SVGPolylineCache();
+
+	void					SetGeometry(const SVGGeometry* geometry);
+
+	void					SetLimit(size_t bytes);
+	size_t					Limit() const { return fLimit; }
+	size_t					Size() const { return fSize; }
+	void					Clear();
+
+	void					NextFrame() { fFrame++; }
+
+	// Flattens the shape if it is not cached yet
+	const SVGPolyline*		Polyline(int32 shape, float scale);
+	const SVGPolyline*		Find(int32 shape, float scale) const;
+
+	// Maximum distance of the polylines from the curves, in pixels
+	static const float		kTolerance;
+
+private:
+	struct Entry;
+	typedef std::unordered_map<uint64, Entry*> EntryMap;
+
+	static int32			_Bucket(float scale);
+	static uint64			_Key(int32 shape, int32 bucket)
+								{ return ((uint64)(uint32)shape << 32)
+									| (uint32)bucket; }
+
+	void					_Flatten(int32 shape, int32 bucket,
+								SVGPolyline& polyline) const;
+	void					_Remove(Entry* entry);
+	void					_MakeRoom(size_t size);
+
+private:
+	const SVGGeometry*		fGeometry;
+	EntryMap				fEntries;
+	Entry*					fFirst;
+	Entry*					fLast;
+	size_t					fSize;
+	size_t					fLimit;
+	uint32					fFrame;
+};
+
+#endif
@@ -0,0 +1,1137 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGRenderer.h"
+#include "SVGGradientKernel.h"
+#include "SVGMaskKernel.h"
+#include "SVGSpatialIndex.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+#include <agg_color_rgba.h>
+#include <agg_conv_stroke.h>
+#include <agg_pixfmt_rgba.h>
+#include <agg_rasterizer_scanline_aa.h>
+#include <agg_renderer_base.h>
+#include <agg_renderer_scanline.h>
+#include <agg_rendering_buffer.h>
+#include <agg_scanline_p.h>
+#include <agg_span_allocator.h>
+
+typedef agg::pixfmt_bgra32_plain pixfmt;
+typedef agg::renderer_base<pixfmt> renderer_base;
+typedef agg::renderer_scanline_aa_solid<renderer_base> renderer_solid;
+typedef agg::span_allocator<agg::rgba8> span_allocator;
+typedef agg::conv_stroke<agg::path_storage> stroke_type;
+
+static const int32 kParallelTileSize = 128;
+static const int32 kMaxWorkers = 64;
+
+
+// AGG state that is reused from shape to shape. Every worker thread owns
+// one, so nothing is shared while tiles are rendered in parallel.
+struct SVGRenderer::Scratch {
+	agg::rasterizer_scanline_aa<>	rasterizer;
+	agg::scanline_p8		scanline;
+	span_allocator			spanAllocator;
+	agg::path_storage		path;
+
+	// Content and mask of masked shapes, one after the other, and a row
+	// of blended colors. They only ever grow.
+	uint8*					maskArea;
+	size_t					maskAreaSize;
+	agg::rgba8*				row;
+	int32					rowCapacity;
+
+	Scratch() : maskArea(NULL), maskAreaSize(0), row(NULL), rowCapacity(0) {}
+	~Scratch() { free(maskArea); delete[] row; }
+};
+
+
+// State of one render pass. All targets use document buffer coordinates,
+// and the rasterizer always clips against the whole document buffer, so
+// a shape produces exactly the same cells whichever target or tile it is
+// drawn into; only the renderer clip box differs.
+struct SVGRenderer::Context {
+	renderer_base*			renderer;
+	Scratch*				scratch;
+	svg_display_mode		displayMode;
+	float					scale;
+	float					offsetX;
+	float					offsetY;
+	agg::rect_i				bufferRect;
+	agg::rect_i				clip;
+};
+
+
+// Thread pool running a batch of jobs. Jobs are split into contiguous
+// ranges, one per worker; a worker that runs out steals from the end of
+// the other ranges. The calling thread acts as worker 0.
+class SVGRenderer::WorkerPool {
+public:
+	typedef void (*job_func)(void* cookie, int32 job, int32 worker);
+
+								WorkerPool(int32 workerCount);
+								~WorkerPool();
+
+			int32				CountWorkers() const { return fWorkerCount; }
+
+			void				Run(int32 jobCount, job_func func,
+									void* cookie);
+
+private:
+	struct Queue {
+		std::mutex				lock;
+		int32					next;
+		int32					end;
+	};
+
+			void				_Loop(int32 worker);
+			void				_Work(int32 worker);
+			bool				_NextJob(int32 worker, int32& job);
+
+			int32				fWorkerCount;
+			std::thread*		fThreads;
+			int32				fThreadCount;
+			Queue*				fQueues;
+
+			std::mutex			fLock;
+			std::condition_variable	fStartCondition;
+			std::condition_variable	fDoneCondition;
+			uint32				fGeneration;
+			int32				fActive;
+			bool				fQuit;
+
+			job_func			fFunc;
+			void*				fCookie;
+};
+
+
+// One parallel render pass, shared by all workers
+struct SVGRenderer::TileJob {
+	SVGRenderer*			renderer;
+	const Context*			base;
+	int32					columns;
+};
+
+
+static agg::rgba8
+convert_color(unsigned int color, float opacity)
+{
+	return agg::rgba8((color >> 0) & 0xFF, (color >> 8) & 0xFF,
+		(color >> 16) & 0xFF, (uint8)(((color >> 24) & 0xFF) * opacity));
+}
+
+
+// Span generator evaluating nanosvg gradients per pixel, with the same
+// mapping as BSVGView::_ApplyGradientToBuffer(). The color table is laid
+// out like the span, so the kernels can write agg::rgba8 directly.
+class GradientSpan {
+public:
+	GradientSpan(NSVGgradient* gradient, char type, float opacity, float scale,
+		float offsetX, float offsetY)
+		:
+		fGradient(gradient),
+		fType(type),
+		fInvScale(1.0f / scale),
+		fOffsetX(offsetX),
+		fOffsetY(offsetY)
+	{
+		uint8 color[4];
+		for (int i = 0; i < 256; i++) {
+			svg_gradient_color(gradient, i / 255.0f, opacity, color);
+			fLUT[i] = agg::rgba8(color[0], color[1], color[2], color[3]);
+		}
+	}
+
+	void prepare()
+	{
+	}
+
+	void generate(agg::rgba8* span, int x, int y, unsigned len)
+	{
+		SVGGradientRow row;
+		row.lut = (const uint8*)fLUT;
+		row.xform = fGradient->xform;
+		row.type = fType;
+		row.spread = fGradient->spread;
+		row.fx = fGradient->fx;
+		row.fy = fGradient->fy;
+		row.startX = ((float)x - fOffsetX) * fInvScale;
+		row.stepX = fInvScale;
+		row.y = ((float)y - fOffsetY) * fInvScale;
+		svg_gradient_fill_row(row, (uint8*)span, len);
+	}
+
+private:
+	NSVGgradient*			fGradient;
+	char					fType;
+	float					fInvScale;
+	float					fOffsetX;
+	float					fOffsetY;
+	agg::rgba8				fLUT[256];
+};
+
+
+static bool
+intersect_rect(agg::rect_i& rect, const agg::rect_i& other)
+{
+	if (rect.x1 < other.x1)
+		rect.x1 = other.x1;
+	if (rect.y1 < other.y1)
+		rect.y1 = other.y1;
+	if (rect.x2 > other.x2)
+		rect.x2 = other.x2;
+	if (rect.y2 > other.y2)
+		rect.y2 = other.y2;
+	return rect.x1 <= rect.x2 && rect.y1 <= rect.y2;
+}
+
+
+// Same as agg::render_scanlines(), but starts at the first row of the
+// renderer clip box and stops after its last one. Shapes drawn into a
+// small tile skip the rows of the other tiles without changing a pixel.
+template<class Renderer>
+static void
+render_clipped_scanlines(agg::rasterizer_scanline_aa<>& rasterizer,
+	agg::scanline_p8& scanline, const renderer_base& target, Renderer& ren)
+{
+	if (!rasterizer.rewind_scanlines())
+		return;
+
+	int y = target.ymin() > rasterizer.min_y()
+		? target.ymin() : rasterizer.min_y();
+	if (!rasterizer.navigate_scanline(y))
+		return;
+
+	scanline.reset(rasterizer.min_x(), rasterizer.max_x());
+	ren.prepare();
+	while (rasterizer.sweep_scanline(scanline)) {
+		if (scanline.y() > target.ymax())
+			break;
+		ren.render(scanline);
+	}
+}
+
+
+// Attaches a scratch buffer that covers only the given area so that it can
+// be addressed with document buffer coordinates
+static void
+attach_area(agg::rendering_buffer& buffer, uint8* bits,
+	const agg::rect_i& area, int32 bytesPerRow)
+{
+	buffer.attach(bits - (ptrdiff_t)area.y1 * bytesPerRow
+			- (ptrdiff_t)area.x1 * 4,
+		area.x2 + 1, area.y2 + 1, bytesPerRow);
+}
+
+
+//	#pragma mark - WorkerPool
+
+
+SVGRenderer::WorkerPool::WorkerPool(int32 workerCount)
+	:
+	fWorkerCount(workerCount),
+	fThreads(NULL),
+	fThreadCount(0),
+	fQueues(new(std::nothrow) Queue[workerCount]),
+	fGeneration(0),
+	fActive(0),
+	fQuit(false),
+	fFunc(NULL),
+	fCookie(NULL)
+{
+	// Without the tables the pool runs on the calling thread only, which
+	// the renderer treats as no pool at all
+	if (fQueues != NULL)
+		fThreads = new(std::nothrow) std::thread[workerCount - 1];
+	for (int32 i = 1; fThreads != NULL && i < workerCount; i++) {
+		try {
+			fThreads[i - 1] = std::thread(&WorkerPool::_Loop, this, i);
+		} catch (...) {
+			break;
+		}
+		fThreadCount++;
+	}
+	fWorkerCount = fThreadCount + 1;
+}
+
+
+SVGRenderer::WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> locker(fLock);
+		fQuit = true;
+	}
+	fStartCondition.notify_all();
+
+	for (int32 i = 0; i < fThreadCount; i++)
+		fThreads[i].join();
+
+	delete[] fThreads;
+	delete[] fQueues;
+}
+
+
+void
+SVGRenderer::WorkerPool::Run(int32 jobCount, job_func func, void* cookie)
+{
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		std::lock_guard<std::mutex> locker(fQueues[i].lock);
+		fQueues[i].next = (int32)((int64)jobCount * i / fWorkerCount);
+		fQueues[i].end = (int32)((int64)jobCount * (i + 1) / fWorkerCount);
+	}
+
+	{
+		std::lock_guard<std::mutex> locker(fLock);
+		fFunc = func;
+		fCookie = cookie;
+		fActive = fWorkerCount - 1;
+		fGeneration++;
+	}
+	fStartCondition.notify_all();
+
+	_Work(0);
+
+	std::unique_lock<std::mutex> locker(fLock);
+	while (fActive > 0)
+		fDoneCondition.wait(locker);
+}
+
+
+void
+SVGRenderer::WorkerPool::_Loop(int32 worker)
+{
+	uint32 generation = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> locker(fLock);
+			while (!fQuit && fGeneration == generation)
+				fStartCondition.wait(locker);
+			if (fQuit)
+				return;
+			generation = fGeneration;
+		}
+
+		_Work(worker);
+
+		std::lock_guard<std::mutex> locker(fLock);
+		if (--fActive == 0)
+			fDoneCondition.notify_one();
+	}
+}
+
+
+void
+SVGRenderer::WorkerPool::_Work(int32 worker)
+{
+	int32 job;
+	while (_NextJob(worker, job))
+		fFunc(fCookie, job, worker);
+}
+
+
+bool
+SVGRenderer::WorkerPool::_NextJob(int32 worker, int32& job)
+{
+	{
+		Queue& own = fQueues[worker];
+		std::lock_guard<std::mutex> locker(own.lock);
+		if (own.next < own.end) {
+			job = own.next++;
+			return true;
+		}
+	}
+
+	for (int32 i = 1; i < fWorkerCount; i++) {
+		Queue& victim = fQueues[(worker + i) % fWorkerCount];
+		std::lock_guard<std::mutex> locker(victim.lock);
+		if (victim.next < victim.end) {
+			job = --victim.end;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+//	#pragma mark - SVGRenderer
+
+
+SVGRenderer::SVGRenderer()
+	:
+	fGeometry(NULL),
+	fIndex(NULL),
+	fShapes(NULL),
+	fShapeCount(0),
+	fQueryItems(NULL),
+	fItemBounds(NULL),
+	fDisplayMode(SVG_DISPLAY_NORMAL),
+	fDetailThreshold(0.0f),
+	fSkippedCount(0),
+	fCanceled(false),
+	fThreadCount(0),
+	fWorkerCount(0),
+	fScratch(NULL),
+	fPool(NULL),
+	fBinStart(NULL),
+	fBinStartCapacity(0),
+	fBinItems(NULL),
+	fBinItemsCapacity(0)
+{
+	_ResizeScratch(1);
+}
+
+
+SVGRenderer::~SVGRenderer()
+{
+	SetGeometry(NULL);
+
+	delete fPool;
+	for (int32 i = 0; i < fWorkerCount; i++)
+		delete fScratch[i];
+	delete[] fScratch;
+	delete[] fBinStart;
+	delete[] fBinItems;
+}
+
+
+status_t
+SVGRenderer::SetThreadCount(int32 count)
+{
+	if (count < 0)
+		return B_BAD_VALUE;
+
+	// The pool is started again by the next parallel render
+	fThreadCount = count;
+	if (fPool != NULL && fPool->CountWorkers() != _RequestedWorkers()) {
+		delete fPool;
+		fPool = NULL;
+		_ResizeScratch(1);
+	}
+	return B_OK;
+}
+
+
+void
+SVGRenderer::SetGeometry(const SVGGeometry* geometry,
+	const SVGSpatialIndex* index)
+{
+	delete[] fQueryItems;
+	delete[] fItemBounds;
+	fQueryItems = NULL;
+	fItemBounds = NULL;
+	fShapes = NULL;
+	fShapeCount = 0;
+	fGeometry = geometry;
+	fIndex = index;
+	fPolylines.SetGeometry(geometry);
+
+	if (geometry == NULL || geometry->CountVisibleShapes() == 0)
+		return;
+
+	int32 count = geometry->CountVisibleShapes();
+	fQueryItems = new(std::nothrow) int32[count];
+	fItemBounds = new(std::nothrow) agg::rect_i[count];
+	if (!fQueryItems || !fItemBounds) {
+		delete[] fQueryItems;
+		delete[] fItemBounds;
+		fQueryItems = NULL;
+		fItemBounds = NULL;
+		return;
+	}
+
+	fShapes = geometry->VisibleShapes();
+	fShapeCount = count;
+}
+
+
+void
+SVGRenderer::Render(const SVGRenderBuffer& buffer, float scale, float offsetX,
+	float offsetY)
+{
+	Render(buffer, scale, offsetX, offsetY,
+		agg::rect_i(0, 0, buffer.width - 1, buffer.height - 1));
+}
+
+
+void
+SVGRenderer::Render(const SVGRenderBuffer& buffer, float scale, float offsetX,
+	float offsetY, const agg::rect_i& clipRect)
+{
+	fSkippedCount = 0;
+	if (fShapeCount == 0 || fScratch == NULL || !buffer.bits
+		|| scale <= 0.0f)
+		return;
+
+	agg::rect_i bufferRect(0, 0, buffer.width - 1, buffer.height - 1);
+	agg::rect_i clip = clipRect;
+	if (!intersect_rect(clip, bufferRect))
+		return;
+
+	int32 count = _CollectItems(clip, scale, offsetX, offsetY);
+	if (count == 0)
+		return;
+
+	_PreparePolylines(count, scale);
+
+	agg::rendering_buffer rbuf(buffer.bits, buffer.width, buffer.height,
+		buffer.bytesPerRow);
+	pixfmt pixf(rbuf);
+	renderer_base rb(pixf);
+	rb.clip_box(clip.x1, clip.y1, clip.x2, clip.y2);
+
+	Context context;
+	context.renderer = &rb;
+	context.scratch = fScratch[0];
+	context.displayMode = fDisplayMode;
+	context.scale = scale;
+	context.offsetX = offsetX;
+	context.offsetY = offsetY;
+	context.bufferRect = bufferRect;
+	context.clip = clip;
+
+	int32 width = clip.x2 - clip.x1 + 1;
+	int32 height = clip.y2 - clip.y1 + 1;
+	// Without memory for the tile bins, render serially rather than not
+	// at all
+	if ((width > kParallelTileSize || height > kParallelTileSize)
+		&& _StartPool() && _RenderParallel(context, count))
+		return;
+
+	for (int32 i = 0; i < count && !fCanceled; i++)
+		_RenderItem(context, fShapes[fQueryItems[i]]);
+}
+
+
+agg::line_cap_e
+SVGRenderer::LineCap(int nsvgCap)
+{
+	switch (nsvgCap) {
+		case NSVG_CAP_ROUND:
+			return agg::round_cap;
+		case NSVG_CAP_SQUARE:
+			return agg::square_cap;
+		case NSVG_CAP_BUTT:
+		default:
+			return agg::butt_cap;
+	}
+}
+
+
+agg::line_join_e
+SVGRenderer::LineJoin(int nsvgJoin)
+{
+	switch (nsvgJoin) {
+		case NSVG_JOIN_ROUND:
+			return agg::round_join;
+		case NSVG_JOIN_BEVEL:
+			return agg::bevel_join;
+		case NSVG_JOIN_MITER:
+		default:
+			return agg::miter_join;
+	}
+}
+
+
+float
+SVGRenderer::MiterLimit(float miterLimit)
+{
+	if (miterLimit < 1.0f)
+		return 1.0f;
+	if (miterLimit > 100.0f)
+		return 100.0f;
+	return miterLimit;
+}
+
+
+void
+SVGRenderer::ClearBuffer(const SVGRenderBuffer& buffer, const agg::rect_i& clipRect)
+{
+	agg::rect_i clip = clipRect;
+	if (!buffer.bits
+		|| !intersect_rect(clip, agg::rect_i(0, 0, buffer.width - 1,
+			buffer.height - 1)))
+		return;
+
+	for (int32 y = clip.y1; y <= clip.y2; y++) {
+		memset(buffer.bits + y * buffer.bytesPerRow + clip.x1 * 4, 0,
+			(clip.x2 - clip.x1 + 1) * 4);
+	}
+}
+
+
+int32
+SVGRenderer::_RequestedWorkers() const
+{
+	int32 workers = fThreadCount;
+	if (workers == 0)
+		workers = (int32)std::thread::hardware_concurrency();
+	if (workers < 1)
+		workers = 1;
+	if (workers > kMaxWorkers)
+		workers = kMaxWorkers;
+	return workers;
+}
+
+
+// Renderers that never draw a large area, like the ones of a view in
+// native mode, do not keep idle threads around
+bool
+SVGRenderer::_StartPool()
+{
+	if (fPool != NULL)
+		return true;
+
+	int32 workers = _RequestedWorkers();
+	if (workers == 1)
+		return false;
+
+	fPool = new(std::nothrow) WorkerPool(workers);
+	if (fPool == NULL)
+		return false;
+
+	if (fPool->CountWorkers() == 1
+		|| _ResizeScratch(fPool->CountWorkers()) != B_OK) {
+		delete fPool;
+		fPool = NULL;
+		return false;
+	}
+	return true;
+}
+
+
+status_t
+SVGRenderer::_ResizeScratch(int32 workers)
+{
+	if (workers == fWorkerCount)
+		return B_OK;
+
+	// Keep the scratch of the calling thread, it has all the memory that
+	// AGG has grown so far
+	Scratch** scratch = new(std::nothrow) Scratch*[workers];
+	if (scratch == NULL)
+		return B_NO_MEMORY;
+
+	for (int32 i = 0; i < workers; i++)
+		scratch[i] = i < fWorkerCount ? fScratch[i] : NULL;
+	for (int32 i = workers; i < fWorkerCount; i++)
+		delete fScratch[i];
+	delete[] fScratch;
+	fScratch = scratch;
+	fWorkerCount = workers;
+
+	for (int32 i = 0; i < fWorkerCount; i++) {
+		if (fScratch[i] == NULL)
+			fScratch[i] = new Scratch;
+	}
+	return B_OK;
+}
+
+
+int32
+SVGRenderer::_CollectItems(const agg::rect_i& clip, float scale,
+	float offsetX, float offsetY)
+{
+	int32 count = fShapeCount;
+	if (fIndex != NULL && fIndex->CountItems() == fShapeCount) {
+		float invScale = 1.0f / scale;
+		count = fIndex->Query(
+			(clip.x1 - 1 - offsetX) * invScale,
+			(clip.y1 - 1 - offsetY) * invScale,
+			(clip.x2 + 2 - offsetX) * invScale,
+			(clip.y2 + 2 - offsetY) * invScale,
+			fQueryItems);
+	} else {
+		for (int32 i = 0; i < fShapeCount; i++)
+			fQueryItems[i] = i;
+	}
+
+	// Shapes that cannot put any color on the screen are only outlined
+	if (fDisplayMode != SVG_DISPLAY_OUTLINE) {
+		int32 painted = 0;
+		for (int32 i = 0; i < count; i++) {
+			if (!fGeometry->IsShapeTransparent(fShapes[fQueryItems[i]]))
+				fQueryItems[painted++] = fQueryItems[i];
+		}
+		count = painted;
+	}
+
+	// Counted here rather than while drawing, so that the parallel path
+	// does not need to share a counter between the workers
+	if (fDetailThreshold > 0.0f) {
+		for (int32 i = 0; i < count; i++) {
+			if (_IsBelowDetail(fShapes[fQueryItems[i]], scale))
+				fSkippedCount++;
+		}
+	}
+	return count;
+}
+
+
+// Returns false if nothing was rendered because the bins could not be
+// allocated
+bool
+SVGRenderer::_RenderParallel(const Context& base, int32 count)
+{
+	const agg::rect_i& clip = base.clip;
+	int32 columns = (clip.x2 - clip.x1 + kParallelTileSize)
+		/ kParallelTileSize;
+	int32 rows = (clip.y2 - clip.y1 + kParallelTileSize) / kParallelTileSize;
+	int32 tiles = columns * rows;
+
+	if (fBinStartCapacity < tiles + 1) {
+		delete[] fBinStart;
+		fBinStart = new(std::nothrow) int32[tiles + 1];
+		fBinStartCapacity = fBinStart != NULL ? tiles + 1 : 0;
+	}
+	if (fBinStart == NULL)
+		return false;
+
+	// Bin the shapes by their clipped pixel bounds. Shapes stay in
+	// document order inside each bin.
+	memset(fBinStart, 0, (tiles + 1) * sizeof(int32));
+	int32 total = 0;
+	for (int32 i = 0; i < count; i++) {
+		agg::rect_i& bounds = fItemBounds[i];
+		if (!_ShapeViewBounds(fShapes[fQueryItems[i]], base.scale,
+				base.offsetX, base.offsetY, bounds)
+			|| !intersect_rect(bounds, clip)) {
+			bounds.x1 = 1;
+			bounds.x2 = 0;
+			continue;
+		}
+
+		int32 column1 = (bounds.x1 - clip.x1) / kParallelTileSize;
+		int32 column2 = (bounds.x2 - clip.x1) / kParallelTileSize;
+		int32 row1 = (bounds.y1 - clip.y1) / kParallelTileSize;
+		int32 row2 = (bounds.y2 - clip.y1) / kParallelTileSize;
+		for (int32 row = row1; row <= row2; row++) {
+			for (int32 column = column1; column <= column2; column++)
+				fBinStart[row * columns + column + 1]++;
+		}
+		total += (row2 - row1 + 1) * (column2 - column1 + 1);
+	}
+
+	if (total == 0)
+		return true;
+
+	if (fBinItemsCapacity < total) {
+		delete[] fBinItems;
+		fBinItems = new(std::nothrow) int32[total];
+		fBinItemsCapacity = fBinItems != NULL ? total : 0;
+	}
+	if (fBinItems == NULL)
+		return false;
+
+	for (int32 i = 0; i < tiles; i++)
+		fBinStart[i + 1] += fBinStart[i];
+
+	// Fill the bins, using the start offsets as cursors and shifting
+	// them back afterwards
+	for (int32 i = 0; i < count; i++) {
+		const agg::rect_i& bounds = fItemBounds[i];
+		if (bounds.x1 > bounds.x2)
+			continue;
+
+		int32 column1 = (bounds.x1 - clip.x1) / kParallelTileSize;
+		int32 column2 = (bounds.x2 - clip.x1) / kParallelTileSize;
+		int32 row1 = (bounds.y1 - clip.y1) / kParallelTileSize;
+		int32 row2 = (bounds.y2 - clip.y1) / kParallelTileSize;
+		for (int32 row = row1; row <= row2; row++) {
+			for (int32 column = column1; column <= column2; column++)
+				fBinItems[fBinStart[row * columns + column]++] = fQueryItems[i];
+		}
+	}
+	for (int32 i = tiles; i > 0; i--)
+		fBinStart[i] = fBinStart[i - 1];
+	fBinStart[0] = 0;
+
+	TileJob job;
+	job.renderer = this;
+	job.base = &base;
+	job.columns = columns;
+	fPool->Run(tiles, &_RenderTileJob, &job);
+	return true;
+}
+
+
+void
+SVGRenderer::_RenderTileJob(void* cookie, int32 index, int32 worker)
+{
+	TileJob* job = (TileJob*)cookie;
+	SVGRenderer* self = job->renderer;
+	const Context& base = *job->base;
+
+	int32 first = self->fBinStart[index];
+	int32 last = self->fBinStart[index + 1];
+	if (first == last)
+		return;
+
+	agg::rect_i tile;
+	tile.x1 = base.clip.x1 + (index % job->columns) * kParallelTileSize;
+	tile.y1 = base.clip.y1 + (index / job->columns) * kParallelTileSize;
+	tile.x2 = tile.x1 + kParallelTileSize - 1;
+	tile.y2 = tile.y1 + kParallelTileSize - 1;
+	intersect_rect(tile, base.clip);
+
+	// Every tile gets its own renderer over the shared buffer; tiles never
+	// overlap, so the workers do not touch each other's pixels
+	renderer_base rb(base.renderer->ren());
+	rb.clip_box(tile.x1, tile.y1, tile.x2, tile.y2);
+
+	Context context = base;
+	context.renderer = &rb;
+	context.scratch = self->fScratch[worker];
+	context.clip = tile;
+
+	for (int32 i = first; i < last && !self->fCanceled; i++)
+		self->_RenderItem(context, self->fShapes[self->fBinItems[i]]);
+}
+
+
+// The polyline cache is not thread safe, so everything the workers will
+// look up is flattened here
+void
+SVGRenderer::_PreparePolylines(int32 count, float scale)
+{
+	fPolylines.NextFrame();
+	for (int32 i = 0; i < count; i++) {
+		int32 shape = fShapes[fQueryItems[i]];
+		if (fDetailThreshold > 0.0f && _IsBelowDetail(shape, scale))
+			continue;
+
+		fPolylines.Polyline(shape, scale);
+
+		int32 mask = fGeometry->ShapeMask(shape);
+		if (mask < 0)
+			continue;
+
+		int32 maskShape = fGeometry->MaskFirstShape(mask);
+		int32 maskEnd = maskShape + fGeometry->MaskShapeCount(mask);
+		for (; maskShape < maskEnd; maskShape++)
+			fPolylines.Polyline(maskShape, scale);
+	}
+}
+
+
+bool
+SVGRenderer::_IsBelowDetail(int32 shape, float scale) const
+{
+	float width;
+	float height;
+	fGeometry->ShapeSize(shape, width, height);
+	return fmaxf(width, height) * scale < fDetailThreshold;
+}
+
+
+void
+SVGRenderer::_RenderItem(Context& context, int32 shape)
+{
+	if (fDetailThreshold > 0.0f && _IsBelowDetail(shape, context.scale))
+		_RenderDot(context, shape);
+	else if (fGeometry->ShapeMask(shape) >= 0)
+		_RenderMaskedShape(context, shape);
+	else
+		_RenderShape(context, shape);
+}
+
+
+void
+SVGRenderer::_RenderDot(Context& context, int32 shape)
+{
+	const SVGShapeStyle& style = fGeometry->ShapeStyle(shape);
+
+	uint32 color;
+	switch (context.displayMode) {
+		case SVG_DISPLAY_OUTLINE:
+			color = 0xff000000;
+			break;
+		case SVG_DISPLAY_FILL_ONLY:
+			if (style.fill.type == NSVG_PAINT_NONE)
+				return;
+			color = SVGGeometry::AverageColor(style.fill);
+			break;
+		case SVG_DISPLAY_STROKE_ONLY:
+			if (style.stroke.type == NSVG_PAINT_NONE
+				|| style.strokeWidth <= 0.0f)
+				return;
+			color = SVGGeometry::AverageColor(style.stroke);
+			break;
+		default:
+			color = SVGGeometry::AverageColor(
+				style.fill.type != NSVG_PAINT_NONE ? style.fill : style.stroke);
+			break;
+	}
+
+	// The area of a pixel the shape would have covered at most
+	float width;
+	float height;
+	fGeometry->ShapeSize(shape, width, height);
+	float coverage = fminf(fmaxf(width, 0.0f) * fmaxf(height, 0.0f)
+		* context.scale * context.scale, 1.0f);
+
+	agg::rgba8 dot = convert_color(color, style.opacity * coverage);
+	if (dot.a == 0)
+		return;
+
+	// The renderer clips, so a dot on a tile edge is drawn by one tile only
+	const float* bounds = fGeometry->ShapeBounds(shape);
+	int x = (int)floorf((bounds[0] + bounds[2]) * 0.5f * context.scale
+		+ context.offsetX);
+	int y = (int)floorf((bounds[1] + bounds[3]) * 0.5f * context.scale
+		+ context.offsetY);
+	context.renderer->blend_pixel(x, y, dot, agg::cover_full);
+}
+
+
+void
+SVGRenderer::_RenderShape(Context& context, int32 shape)
+{
+	const SVGShapeStyle& style = fGeometry->ShapeStyle(shape);
+
+	agg::rect_i bounds;
+	if (!_ShapeViewBounds(shape, context.scale, context.offsetX,
+			context.offsetY, bounds)
+		|| !intersect_rect(bounds, context.clip))
+		return;
+
+	agg::rasterizer_scanline_aa<>& rasterizer = context.scratch->rasterizer;
+	agg::scanline_p8& scanline = context.scratch->scanline;
+	agg::path_storage& path = context.scratch->path;
+
+	path.remove_all();
+	_BuildPath(shape, path, context.scale, context.offsetX, context.offsetY);
+
+	rasterizer.clip_box(context.bufferRect.x1, context.bufferRect.y1,
+		context.bufferRect.x2 + 1, context.bufferRect.y2 + 1);
+
+	if (context.displayMode == SVG_DISPLAY_OUTLINE) {
+		stroke_type stroke(path);
+		stroke.width(1.0);
+		stroke.line_cap(agg::butt_cap);
+		stroke.line_join(agg::miter_join);
+		stroke.miter_limit(4.0);
+
+		rasterizer.reset();
+		rasterizer.filling_rule(agg::fill_non_zero);
+		rasterizer.add_path(stroke);
+
+		renderer_solid ren(*context.renderer);
+		ren.color(agg::rgba8(0, 0, 0, 255));
+		render_clipped_scanlines(rasterizer, scanline, *context.renderer, ren);
+		return;
+	}
+
+	bool drawFill = context.displayMode == SVG_DISPLAY_NORMAL
+		|| context.displayMode == SVG_DISPLAY_FILL_ONLY;
+	bool drawStroke = context.displayMode == SVG_DISPLAY_NORMAL
+		|| context.displayMode == SVG_DISPLAY_STROKE_ONLY;
+
+	if (drawFill && style.fill.type != NSVG_PAINT_NONE) {
+		rasterizer.reset();
+		if (style.fillRule == NSVG_FILLRULE_EVENODD)
+			rasterizer.filling_rule(agg::fill_even_odd);
+		else
+			rasterizer.filling_rule(agg::fill_non_zero);
+		rasterizer.add_path(path);
+
+		_RenderPaint(context, style.fill, style.opacity);
+	}
+
+	if (drawStroke && style.stroke.type != NSVG_PAINT_NONE
+		&& style.strokeWidth > 0.0f) {
+		stroke_type stroke(path);
+
+		float strokeWidth = style.strokeWidth * context.scale;
+		if (strokeWidth < 0.1f)
+			strokeWidth = 0.1f;
+		stroke.width(strokeWidth);
+		stroke.line_cap(LineCap(style.strokeLineCap));
+		stroke.line_join(LineJoin(style.strokeLineJoin));
+		stroke.miter_limit(MiterLimit(style.miterLimit));
+
+		rasterizer.reset();
+		rasterizer.filling_rule(agg::fill_non_zero);
+		rasterizer.add_path(stroke);
+
+		_RenderPaint(context, style.stroke, style.opacity);
+	}
+}
+
+
+void
+SVGRenderer::_RenderMaskedShape(Context& context, int32 shape)
+{
+	// The scratch buffers only cover the clipped part of the shape, but
+	// they are addressed in document coordinates like any other target
+	agg::rect_i bounds;
+	if (!_ShapeViewBounds(shape, context.scale, context.offsetX,
+			context.offsetY, bounds)
+		|| !intersect_rect(bounds, context.clip))
+		return;
+
+	int32 width = bounds.x2 - bounds.x1 + 1;
+	int32 height = bounds.y2 - bounds.y1 + 1;
+	int32 bpr = width * 4;
+
+	Scratch& scratch = *context.scratch;
+	size_t areaSize = (size_t)bpr * height * 2;
+	if (scratch.maskAreaSize < areaSize) {
+		free(scratch.maskArea);
+		scratch.maskArea = (uint8*)malloc(areaSize);
+		scratch.maskAreaSize = scratch.maskArea != NULL ? areaSize : 0;
+	}
+	if (scratch.rowCapacity < width) {
+		delete[] scratch.row;
+		scratch.row = new(std::nothrow) agg::rgba8[width];
+		scratch.rowCapacity = scratch.row != NULL ? width : 0;
+	}
+	if (scratch.maskArea == NULL || scratch.row == NULL)
+		return;
+
+	uint8* content = scratch.maskArea;
+	uint8* mask = content + (size_t)bpr * height;
+	agg::rgba8* row = scratch.row;
+	memset(content, 0, areaSize);
+
+	Context local = context;
+	local.displayMode = SVG_DISPLAY_NORMAL;
+	local.clip = bounds;
+
+	agg::rendering_buffer contentBuffer;
+	attach_area(contentBuffer, content, bounds, bpr);
+	pixfmt contentFormat(contentBuffer);
+	renderer_base contentRenderer(contentFormat);
+	contentRenderer.clip_box(bounds.x1, bounds.y1, bounds.x2, bounds.y2);
+	local.renderer = &contentRenderer;
+	_RenderShape(local, shape);
+
+	agg::rendering_buffer maskBuffer;
+	attach_area(maskBuffer, mask, bounds, bpr);
+	pixfmt maskFormat(maskBuffer);
+	renderer_base maskRenderer(maskFormat);
+	maskRenderer.clip_box(bounds.x1, bounds.y1, bounds.x2, bounds.y2);
+	local.renderer = &maskRenderer;
+	int32 maskIndex = fGeometry->ShapeMask(shape);
+	int32 maskShape = fGeometry->MaskFirstShape(maskIndex);
+	int32 maskEnd = maskShape + fGeometry->MaskShapeCount(maskIndex);
+	for (; maskShape < maskEnd; maskShape++) {
+		if (fGeometry->IsShapeVisible(maskShape))
+			_RenderShape(local, maskShape);
+	}
+
+	// Luminance mask; the content keeps straight alpha so only its alpha
+	// channel is scaled before it is blended into the target
+	for (int32 y = 0; y < height; y++) {
+		uint8* c = content + y * bpr;
+		svg_mask_apply_alpha_row(c, mask + y * bpr, width);
+		for (int32 x = 0; x < width; x++, c += 4)
+			row[x] = agg::rgba8(c[2], c[1], c[0], c[3]);
+		context.renderer->blend_color_hspan(bounds.x1, bounds.y1 + y, width,
+			row, NULL, agg::cover_full);
+	}
+}
+
+
+void
+SVGRenderer::_RenderPaint(Context& context, const SVGPaint& paint,
+	float opacity)
+{
+	Scratch& scratch = *context.scratch;
+
+	switch (paint.type) {
+		case NSVG_PAINT_COLOR:
+		{
+			renderer_solid ren(*context.renderer);
+			ren.color(convert_color(paint.color, opacity));
+			render_clipped_scanlines(scratch.rasterizer, scratch.scanline,
+				*context.renderer, ren);
+			break;
+		}
+
+		case NSVG_PAINT_LINEAR_GRADIENT:
+		case NSVG_PAINT_RADIAL_GRADIENT:
+		{
+			if (!paint.gradient || paint.gradient->nstops == 0)
+				break;
+
+			GradientSpan span(paint.gradient, paint.type, opacity,
+				context.scale, context.offsetX, context.offsetY);
+			agg::renderer_scanline_aa<renderer_base, span_allocator,
+				GradientSpan> ren(*context.renderer, scratch.spanAllocator,
+					span);
+			render_clipped_scanlines(scratch.rasterizer, scratch.scanline,
+				*context.renderer, ren);
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+
+void
+SVGRenderer::_BuildPath(int32 shape, agg::path_storage& path, float scale,
+	float offsetX, float offsetY)
+{
+	// Flattened by _PreparePolylines(), before the workers were started
+	const SVGPolyline* polyline = fPolylines.Find(shape, scale);
+	if (polyline == NULL)
+		return;
+
+	int32 first = polyline->FirstPath();
+	int32 end = first + polyline->CountPaths();
+	for (int32 p = first; p < end; p++) {
+		int32 count = polyline->PathPointCount(p);
+		if (count < 2)
+			continue;
+
+		const float* pt = polyline->PathPoints(p);
+		path.move_to(pt[0] * scale + offsetX, pt[1] * scale + offsetY);
+		for (int32 i = 1; i < count; i++) {
+			pt += 2;
+			path.line_to(pt[0] * scale + offsetX, pt[1] * scale + offsetY);
+		}
+
+		if (fGeometry->IsPathClosed(p))
+			path.close_polygon();
+	}
+}
+
+
+bool
+SVGRenderer::_ShapeViewBounds(int32 shape, float scale, float offsetX,
+	float offsetY, agg::rect_i& bounds)
+{
+	const SVGShapeStyle& style = fGeometry->ShapeStyle(shape);
+	const float* shapeBounds = fGeometry->ShapeBounds(shape);
+	float expand = style.strokeWidth * scale * style.miterLimit;
+	float left = shapeBounds[0] * scale + offsetX - expand;
+	float top = shapeBounds[1] * scale + offsetY - expand;
+	float right = shapeBounds[2] * scale + offsetX + expand;
+	float bottom = shapeBounds[3] * scale + offsetY + expand;
+
+	// Guard against coordinates that do not fit into the integer range
+	if (right < -1e6f || bottom < -1e6f || left > 1e6f || top > 1e6f)
+		return false;
+
+	bounds.x1 = (int)floorf(fmaxf(left, -1e6f)) - 1;
+	bounds.y1 = (int)floorf(fmaxf(top, -1e6f)) - 1;
+	bounds.x2 = (int)ceilf(fminf(right, 1e6f)) + 1;
+	bounds.y2 = (int)ceilf(fminf(bottom, 1e6f)) + 1;
+	return true;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_RENDERER_H
+#define SVG_RENDERER_H
+
+#include "SVGPlatform.h"
+
+#include <atomic>
+
+#include <agg_basics.h>
+#include <agg_math_stroke.h>
+#include <agg_path_storage.h>
+
+#include "SVGGeometry.h"
+#include "SVGPolylineCache.h"
+
+class SVGSpatialIndex;
+
+enum svg_display_mode {
+	SVG_DISPLAY_NORMAL = 0,
+	SVG_DISPLAY_OUTLINE,
+	SVG_DISPLAY_FILL_ONLY,
+	SVG_DISPLAY_STROKE_ONLY
+};
+
+// A 32 bit B_RGBA32 (BGRA byte order) pixel buffer with straight alpha
+struct SVGRenderBuffer {
+	uint8*					bits;
+	int32					width;
+	int32					height;
+	int32					bytesPerRow;
+
+							SVGRenderBuffer()
+								: bits(NULL), width(0), height(0),
+								bytesPerRow(0) {}
+							SVGRenderBuffer(uint8* bits, int32 width,
+								int32 height, int32 bytesPerRow)
+								: bits(bits), width(width), height(height),
+								bytesPerRow(bytesPerRow) {}
+};
+
+// Software renderer that draws a whole document with AGG into a single
+// buffer. It does not depend on app_server and can run headless.
+// Large areas are split into tiles that are rendered in parallel; the
+// result is bit-identical to a single threaded pass.
+class SVGRenderer {
+public:
+							SVGRenderer();
+							~SVGRenderer();
+
+	// 0 selects one thread per CPU core, 1 disables parallel rendering.
+	// The threads are only started by the first parallel render, until
+	// then CountWorkers() is 1.
+	status_t				SetThreadCount(int32 count);
+	int32					ThreadCount() const { return fThreadCount; }
+	int32					CountWorkers() const { return fWorkerCount; }
+
+	// A canceled renderer returns from Render() after the current shape.
+	// SetCanceled() may be called from any thread.
+	void					SetCanceled(bool canceled)
+								{ fCanceled = canceled; }
+	bool					IsCanceled() const { return fCanceled; }
+
+	// The geometry and index are shared and must stay valid until they
+	// are replaced or unset
+	void					SetGeometry(const SVGGeometry* geometry,
+								const SVGSpatialIndex* index = NULL);
+	const SVGGeometry*		Geometry() const { return fGeometry; }
+
+	void					SetDisplayMode(svg_display_mode mode)
+								{ fDisplayMode = mode; }
+	svg_display_mode		DisplayMode() const { return fDisplayMode; }
+
+	// Shapes whose painted size is below the threshold (in pixels) are
+	// drawn as a single pixel of their average color, weighted by their
+	// area. 0 disables it.
+	void					SetDetailThreshold(float pixels)
+								{ fDetailThreshold = pixels; }
+	float					DetailThreshold() const
+								{ return fDetailThreshold; }
+	// Shapes drawn as a pixel by the last Render() call
+	int32					CountSkipped() const { return fSkippedCount; }
+
+	// Curves are flattened once per zoom bucket and kept up to this size
+	void					SetPolylineCacheLimit(size_t bytes)
+								{ fPolylines.SetLimit(bytes); }
+	size_t					PolylineCacheLimit() const
+								{ return fPolylines.Limit(); }
+
+	// Draws the document over the existing buffer contents. Only pixels
+	// inside the clip rectangle (inclusive, buffer coordinates) are touched.
+	void					Render(const SVGRenderBuffer& buffer, float scale,
+								float offsetX, float offsetY,
+								const agg::rect_i& clip);
+	void					Render(const SVGRenderBuffer& buffer, float scale,
+								float offsetX, float offsetY);
+
+	static void				ClearBuffer(const SVGRenderBuffer& buffer,
+								const agg::rect_i& clip);
+
+	// Stroke attributes of a shape in AGG terms. BSVGView strokes with
+	// these too, so that both paths draw the same outlines.
+	static agg::line_cap_e	LineCap(int nsvgCap);
+	static agg::line_join_e	LineJoin(int nsvgJoin);
+	static float			MiterLimit(float miterLimit);
+
+private:
+	struct Context;
+	struct Scratch;
+	struct TileJob;
+	class WorkerPool;
+
+	int32					_RequestedWorkers() const;
+	bool					_StartPool();
+	status_t				_ResizeScratch(int32 workers);
+	int32					_CollectItems(const agg::rect_i& clip,
+								float scale, float offsetX, float offsetY);
+	bool					_RenderParallel(const Context& base,
+								int32 count);
+	static void				_RenderTileJob(void* cookie, int32 job,
+								int32 worker);
+	void					_PreparePolylines(int32 count, float scale);
+	bool					_IsBelowDetail(int32 shape, float scale) const;
+	void					_RenderItem(Context& context, int32 shape);
+	void					_RenderDot(Context& context, int32 shape);
+	void					_RenderShape(Context& context, int32 shape);
+	void					_RenderMaskedShape(Context& context,
+								int32 shape);
+	void					_RenderPaint(Context& context,
+								const SVGPaint& paint, float opacity);
+	void					_BuildPath(int32 shape,
+								agg::path_storage& path, float scale,
+								float offsetX, float offsetY);
+	bool					_ShapeViewBounds(int32 shape, float scale,
+								float offsetX, float offsetY,
+								agg::rect_i& bounds);
+
+private:
+	const SVGGeometry*		fGeometry;
+	const SVGSpatialIndex*	fIndex;
+	const int32*			fShapes;
+	int32					fShapeCount;
+	int32*					fQueryItems;
+	agg::rect_i*			fItemBounds;
+	svg_display_mode		fDisplayMode;
+	float					fDetailThreshold;
+	int32					fSkippedCount;
+	std::atomic<bool>		fCanceled;
+	SVGPolylineCache		fPolylines;
+
+	int32					fThreadCount;
+	int32					fWorkerCount;
+	Scratch**				fScratch;
+	WorkerPool*				fPool;
+
+	// Shapes binned per parallel tile, as offsets into fBinItems
+	int32*					fBinStart;
+	int32					fBinStartCapacity;
+	int32*					fBinItems;
+	int32					fBinItemsCapacity;
+};
+
+#endif
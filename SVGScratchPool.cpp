@@ -0,0 +1,218 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGScratchPool.h"
+
+#include <string.h>
+
+
+static const int32 kSizeClassStep = 64;
+static const size_t kDefaultScratchLimit = 32 * 1024 * 1024;
+
+
+static inline int32
+size_class(int32 size)
+{
+	return (size + kSizeClassStep - 1) / kSizeClassStep * kSizeClassStep;
+}
+
+
+SVGScratchPool::SVGScratchPool()
+	:
+	fLimit(kDefaultScratchLimit),
+	fIdleBytes(0),
+	fClock(0)
+{
+	memset(&fStats, 0, sizeof(fStats));
+}
+
+
+SVGScratchPool::~SVGScratchPool()
+{
+	for (size_t i = 0; i < fSlots.size(); i++)
+		delete fSlots[i].bitmap;
+}
+
+
+BBitmap*
+SVGScratchPool::AcquireBitmap(int32 width, int32 height)
+{
+	if (width < 1)
+		width = 1;
+	if (height < 1)
+		height = 1;
+
+	int32 classWidth = size_class(width);
+	int32 classHeight = size_class(height);
+
+	// Smallest idle bitmap that fits without wasting too much memory
+	int32 best = -1;
+	int64 bestArea = (int64)classWidth * classHeight * 4 + 1;
+	for (size_t i = 0; i < fSlots.size(); i++) {
+		const Slot& slot = fSlots[i];
+		if (slot.inUse || slot.width < width || slot.height < height)
+			continue;
+		int64 area = (int64)slot.width * slot.height;
+		if (area < bestArea) {
+			best = i;
+			bestArea = area;
+		}
+	}
+
+	if (best >= 0) {
+		Slot& slot = fSlots[best];
+		BBitmap* bitmap = slot.bitmap;
+
+		// Outside of the dirty area the bitmap is still clear
+		int32 clearWidth = width < slot.dirtyWidth ? width : slot.dirtyWidth;
+		int32 clearHeight = height < slot.dirtyHeight
+			? height : slot.dirtyHeight;
+		uint8* bits = (uint8*)bitmap->Bits();
+		int32 bpr = bitmap->BytesPerRow();
+		for (int32 y = 0; y < clearHeight; y++)
+			memset(bits + y * bpr, 0, clearWidth * 4);
+		fStats.bytesCleared += (uint64)clearWidth * clearHeight * 4;
+
+		if (width > slot.dirtyWidth)
+			slot.dirtyWidth = width;
+		if (height > slot.dirtyHeight)
+			slot.dirtyHeight = height;
+		slot.inUse = true;
+		fIdleBytes -= bitmap->BitsLength();
+		fStats.bitmapsReused++;
+		return bitmap;
+	}
+
+	BBitmap* bitmap = new BBitmap(
+		BRect(0, 0, classWidth - 1, classHeight - 1), B_RGBA32);
+	if (!bitmap || bitmap->InitCheck() != B_OK) {
+		delete bitmap;
+		return NULL;
+	}
+	memset(bitmap->Bits(), 0, bitmap->BitsLength());
+	fStats.bytesCleared += bitmap->BitsLength();
+	fStats.bitmapsAllocated++;
+
+	Slot slot;
+	slot.bitmap = bitmap;
+	slot.width = classWidth;
+	slot.height = classHeight;
+	slot.dirtyWidth = width;
+	slot.dirtyHeight = height;
+	slot.lastUsed = 0;
+	slot.inUse = true;
+	fSlots.push_back(slot);
+	return bitmap;
+}
+
+
+void
+SVGScratchPool::ReleaseBitmap(BBitmap* bitmap)
+{
+	if (bitmap == NULL)
+		return;
+
+	for (size_t i = 0; i < fSlots.size(); i++) {
+		Slot& slot = fSlots[i];
+		if (slot.bitmap != bitmap || !slot.inUse)
+			continue;
+
+		slot.inUse = false;
+		slot.lastUsed = ++fClock;
+		fIdleBytes += bitmap->BitsLength();
+		_MakeRoom(0);
+		return;
+	}
+
+	delete bitmap;
+}
+
+
+void
+SVGScratchPool::SetLimit(size_t bytes)
+{
+	fLimit = bytes;
+	_MakeRoom(0);
+}
+
+
+void
+SVGScratchPool::Flush()
+{
+	for (int32 i = (int32)fSlots.size() - 1; i >= 0; i--) {
+		if (!fSlots[i].inUse)
+			_Free(i);
+	}
+}
+
+
+void
+SVGScratchPool::GetStats(SVGScratchStats& stats) const
+{
+	stats = fStats;
+	stats.pooledBitmaps = 0;
+	for (size_t i = 0; i < fSlots.size(); i++) {
+		if (!fSlots[i].inUse)
+			stats.pooledBitmaps++;
+	}
+	stats.pooledBytes = fIdleBytes;
+}
+
+
+agg::rasterizer_scanline_aa<>&
+SVGScratchPool::Rasterizer()
+{
+	fRasterizer.reset();
+	fRasterizer.reset_clipping();
+	fRasterizer.filling_rule(agg::fill_non_zero);
+	return fRasterizer;
+}
+
+
+agg::path_storage&
+SVGScratchPool::Path()
+{
+	fPath.remove_all();
+	return fPath;
+}
+
+
+agg::path_storage&
+SVGScratchPool::StrokePath()
+{
+	fStrokePath.remove_all();
+	return fStrokePath;
+}
+
+
+void
+SVGScratchPool::_MakeRoom(size_t bytes)
+{
+	while (fIdleBytes + bytes > fLimit) {
+		int32 victim = -1;
+		for (size_t i = 0; i < fSlots.size(); i++) {
+			if (!fSlots[i].inUse && (victim < 0
+					|| fSlots[i].lastUsed < fSlots[victim].lastUsed))
+				victim = i;
+		}
+		if (victim < 0)
+			return;
+		_Free(victim);
+	}
+}
+
+
+void
+SVGScratchPool::_Free(int32 index)
+{
+	Slot& slot = fSlots[index];
+	if (!slot.inUse)
+		fIdleBytes -= slot.bitmap->BitsLength();
+	delete slot.bitmap;
+	fStats.bitmapsFreed++;
+
+	slot = fSlots.back();
+	fSlots.pop_back();
+}
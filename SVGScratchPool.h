@@ -0,0 +1,81 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_SCRATCH_POOL_H
+#define SVG_SCRATCH_POOL_H
+
+#include <Bitmap.h>
+
+#include <vector>
+
+#include <agg_path_storage.h>
+#include <agg_rasterizer_scanline_aa.h>
+#include <agg_scanline_p.h>
+
+struct SVGScratchStats {
+	uint64					bitmapsAllocated;
+	uint64					bitmapsReused;
+	uint64					bitmapsFreed;
+	uint64					bytesCleared;
+	int32					pooledBitmaps;
+	size_t					pooledBytes;
+};
+
+// Temporary resources of the offscreen raster paths. Bitmaps are recycled
+// by size class and the AGG rasterizer, scanline and paths keep their
+// blocks from shape to shape. The pool is not thread safe and the AGG
+// objects must not be used by two callers at the same time.
+class SVGScratchPool {
+public:
+								SVGScratchPool();
+								~SVGScratchPool();
+
+	// Returns a B_RGBA32 bitmap at least width by height pixels large. Only
+	// the requested area is cleared; it is all the caller may touch.
+	BBitmap*					AcquireBitmap(int32 width, int32 height);
+	void						ReleaseBitmap(BBitmap* bitmap);
+
+	// Bytes of idle bitmaps kept for reuse
+	void						SetLimit(size_t bytes);
+	size_t						Limit() const { return fLimit; }
+	void						Flush();
+
+	void						GetStats(SVGScratchStats& stats) const;
+
+	// The AGG objects in their default state
+	agg::rasterizer_scanline_aa<>&	Rasterizer();
+	agg::scanline_p8&			Scanline() { return fScanline; }
+	agg::path_storage&			Path();
+	agg::path_storage&			StrokePath();
+
+private:
+	struct Slot {
+		BBitmap*				bitmap;
+		int32					width;
+		int32					height;
+		// Area that may hold pixels from the last use
+		int32					dirtyWidth;
+		int32					dirtyHeight;
+		uint32					lastUsed;
+		bool					inUse;
+	};
+
+	void						_MakeRoom(size_t bytes);
+	void						_Free(int32 index);
+
+private:
+	std::vector<Slot>			fSlots;
+	size_t						fLimit;
+	size_t						fIdleBytes;
+	uint32						fClock;
+	SVGScratchStats				fStats;
+
+	agg::rasterizer_scanline_aa<>	fRasterizer;
+	agg::scanline_p8			fScanline;
+	agg::path_storage			fPath;
+	agg::path_storage			fStrokePath;
+};
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#include "SVGSpatialIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const int32 kMaxGridDimension = 512;
+static const int32 kMaxCellsPerItem = 64;
+
+
+static int
+compare_items(const void* a, const void* b)
+{
+	return *(const int32*)a - *(const int32*)b;
+}
+
+
+SVGSpatialIndex::SVGSpatialIndex()
+	:
+	fBounds(NULL),
+	fItemCount(0),
+	fLeft(0.0f),
+	fTop(0.0f),
+	fCellWidth(1.0f),
+	fCellHeight(1.0f),
+	fColumns(0),
+	fRows(0),
+	fCellStart(NULL),
+	fCellItems(NULL),
+	fLargeItems(NULL),
+	fLargeItemCount(0)
+{
+}
+
+
+SVGSpatialIndex::~SVGSpatialIndex()
+{
+	Unset();
+}
+
+
+status_t
+SVGSpatialIndex::SetTo(const float* bounds, int32 count)
+{
+	Unset();
+
+	if (count <= 0)
+		return B_OK;
+	if (!bounds)
+		return B_BAD_VALUE;
+
+	fBounds = (float*)malloc(count * 4 * sizeof(float));
+	if (!fBounds)
+		return B_NO_MEMORY;
+	memcpy(fBounds, bounds, count * 4 * sizeof(float));
+	fItemCount = count;
+
+	float left = bounds[0];
+	float top = bounds[1];
+	float right = bounds[2];
+	float bottom = bounds[3];
+	for (int32 i = 1; i < count; i++) {
+		const float* b = bounds + i * 4;
+		left = fminf(left, b[0]);
+		top = fminf(top, b[1]);
+		right = fmaxf(right, b[2]);
+		bottom = fmaxf(bottom, b[3]);
+	}
+
+	float width = fmaxf(right - left, 1.0f);
+	float height = fmaxf(bottom - top, 1.0f);
+
+	// Aim for about one item per cell, keeping cells roughly square
+	float cells = sqrtf((float)count);
+	float aspect = sqrtf(width / height);
+	fColumns = (int32)ceilf(cells * aspect);
+	fRows = (int32)ceilf(cells / aspect);
+	if (fColumns < 1)
+		fColumns = 1;
+	if (fRows < 1)
+		fRows = 1;
+	if (fColumns > kMaxGridDimension)
+		fColumns = kMaxGridDimension;
+	if (fRows > kMaxGridDimension)
+		fRows = kMaxGridDimension;
+
+	fLeft = left;
+	fTop = top;
+	fCellWidth = width / fColumns;
+	fCellHeight = height / fRows;
+
+	int32 cellCount = fColumns * fRows;
+	fCellStart = (int32*)calloc(cellCount + 1, sizeof(int32));
+	fLargeItems = (int32*)malloc(count * sizeof(int32));
+	if (!fCellStart || !fLargeItems) {
+		Unset();
+		return B_NO_MEMORY;
+	}
+
+	// Items covering many cells go to a separate list that every query
+	// scans, so a background rectangle does not bloat the grid.
+	for (int32 i = 0; i < count; i++) {
+		int32 firstX, firstY, lastX, lastY;
+		_CellRange(fBounds + i * 4, firstX, firstY, lastX, lastY);
+		if ((lastX - firstX + 1) * (lastY - firstY + 1) > kMaxCellsPerItem)
+			continue;
+		for (int32 y = firstY; y <= lastY; y++) {
+			for (int32 x = firstX; x <= lastX; x++)
+				fCellStart[y * fColumns + x + 1]++;
+		}
+	}
+
+	for (int32 i = 0; i < cellCount; i++)
+		fCellStart[i + 1] += fCellStart[i];
+
+	fCellItems = (int32*)malloc((fCellStart[cellCount] + 1) * sizeof(int32));
+	int32* fill = (int32*)malloc(cellCount * sizeof(int32));
+	if (!fCellItems || !fill) {
+		free(fill);
+		Unset();
+		return B_NO_MEMORY;
+	}
+	memcpy(fill, fCellStart, cellCount * sizeof(int32));
+
+	for (int32 i = 0; i < count; i++) {
+		int32 firstX, firstY, lastX, lastY;
+		_CellRange(fBounds + i * 4, firstX, firstY, lastX, lastY);
+		if ((lastX - firstX + 1) * (lastY - firstY + 1) > kMaxCellsPerItem) {
+			fLargeItems[fLargeItemCount++] = i;
+			continue;
+		}
+		for (int32 y = firstY; y <= lastY; y++) {
+			for (int32 x = firstX; x <= lastX; x++)
+				fCellItems[fill[y * fColumns + x]++] = i;
+		}
+	}
+
+	free(fill);
+	return B_OK;
+}
+
+
+void
+SVGSpatialIndex::Unset()
+{
+	free(fBounds);
+	free(fCellStart);
+	free(fCellItems);
+	free(fLargeItems);
+	fBounds = NULL;
+	fCellStart = NULL;
+	fCellItems = NULL;
+	fLargeItems = NULL;
+	fItemCount = 0;
+	fLargeItemCount = 0;
+	fColumns = 0;
+	fRows = 0;
+}
+
+
+int32
+SVGSpatialIndex::Query(float left, float top, float right, float bottom,
+	int32* items) const
+{
+	if (fItemCount == 0 || !items)
+		return 0;
+
+	int32 count = 0;
+
+	for (int32 i = 0; i < fLargeItemCount; i++) {
+		const float* b = fBounds + fLargeItems[i] * 4;
+		if (b[0] <= right && b[2] >= left && b[1] <= bottom && b[3] >= top)
+			items[count++] = fLargeItems[i];
+	}
+
+	float query[4] = { left, top, right, bottom };
+	int32 firstX, firstY, lastX, lastY;
+	_CellRange(query, firstX, firstY, lastX, lastY);
+
+	for (int32 y = firstY; y <= lastY; y++) {
+		for (int32 x = firstX; x <= lastX; x++) {
+			int32 cell = y * fColumns + x;
+			for (int32 j = fCellStart[cell]; j < fCellStart[cell + 1]; j++) {
+				int32 item = fCellItems[j];
+				const float* b = fBounds + item * 4;
+				if (b[0] > right || b[2] < left || b[1] > bottom || b[3] < top)
+					continue;
+
+				// Report an item spanning several cells only from the
+				// first cell it shares with the query
+				int32 itemX, itemY, itemLastX, itemLastY;
+				_CellRange(b, itemX, itemY, itemLastX, itemLastY);
+				if (x != (itemX > firstX ? itemX : firstX)
+					|| y != (itemY > firstY ? itemY : firstY))
+					continue;
+
+				items[count++] = item;
+			}
+		}
+	}
+
+	qsort(items, count, sizeof(int32), compare_items);
+	return count;
+}
+
+
+void
+SVGSpatialIndex::_CellRange(const float* bounds, int32& firstX,
+	int32& firstY, int32& lastX, int32& lastY) const
+{
+	firstX = (int32)floorf((bounds[0] - fLeft) / fCellWidth);
+	firstY = (int32)floorf((bounds[1] - fTop) / fCellHeight);
+	lastX = (int32)floorf((bounds[2] - fLeft) / fCellWidth);
+	lastY = (int32)floorf((bounds[3] - fTop) / fCellHeight);
+
+	if (firstX < 0)
+		firstX = 0;
+	if (firstY < 0)
+		firstY = 0;
+	if (lastX >= fColumns)
+		lastX = fColumns - 1;
+	if (lastY >= fRows)
+		lastY = fRows - 1;
+	if (firstX >= fColumns)
+		firstX = fColumns - 1;
+	if (firstY >= fRows)
+		firstY = fRows - 1;
+	if (lastX < 0)
+		lastX = 0;
+	if (lastY < 0)
+		lastY = 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+#ifndef SVG_SPATIAL_INDEX_H
+#define SVG_SPATIAL_INDEX_H
+
+#include "SVGPlatform.h"
+
+// Uniform grid over item bounding boxes. Items are identified by their
+// position in the bounds array and queries return them in that order, so
+// the result can be painted directly.
+class SVGSpatialIndex {
+public:
+							SVGSpatialIndex();
+							~SVGSpatialIndex();
+
+	status_t				SetTo(const float* bounds, int32 count);
+	void					Unset();
+
+	int32					CountItems() const { return fItemCount; }
+	const float*			ItemBounds(int32 index) const
+								{ return fBounds + index * 4; }
+
+	int32					Query(float left, float top, float right,
+								float bottom, int32* items) const;
+
+private:
+	void					_CellRange(const float* bounds, int32& firstX,
+								int32& firstY, int32& lastX,
+								int32& lastY) const;
+
+private:
+	float*					fBounds;
+	int32					fItemCount;
+
+	float					fLeft;
+	float					fTop;
+	float					fCellWidth;
+	float					fCellHeight;
+	int32					fColumns;
+	int32					fRows;
+
+	int32*					fCellStart;
+	int32*					fCellItems;
+	int32*					fLargeItems;
+	int32					fLargeItemCount;
+};
+
+#endif
@@ -0,0 +1,758 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+// Headless benchmark of the software rendering engine. It runs on any
+// POSIX system with AGG and prints its results as JSON:
+//
+//	svgbench [-r runs] [-s WIDTHxHEIGHT] [-t 1,2,4,0] [-o file] [files...]
+//	svgbench -c [-s WIDTHxHEIGHT] [-t 2,4,0] [files...]
+//
+// Without files, every .svg file in the "corpus" directory is measured.
+// Times are in milliseconds, memory in kilobytes.
+//
+// With -c nothing is measured. Every document is rendered with one thread
+// and with each of the given thread counts at several scales and offsets,
+// and the exit status is 1 if any parallel frame differs from the single
+// threaded one.
+
+#define NANOSVG_IMPLEMENTATION
+#include "nanosvg.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "SVGGeometry.h"
+#include "SVGGradientKernel.h"
+#include "SVGMaskKernel.h"
+#include "SVGRenderer.h"
+#include "SVGSpatialIndex.h"
+
+
+static const int32 kDefaultRuns = 20;
+static const int32 kDefaultWidth = 1024;
+static const int32 kDefaultHeight = 768;
+static const int32 kPanStepX = 48;
+static const int32 kPanStepY = 32;
+static const int32 kZoomSteps = 4;
+static const float kZoomFactor = 1.25f;
+// The default of the viewer
+static const float kDetailThreshold = 0.5f;
+// Thread count of the parallel check if none is given
+static const int32 kCheckThreads = 4;
+
+
+struct BenchOptions {
+	int32					runs;
+	int32					width;
+	int32					height;
+	std::vector<int32>		threads;
+	const char*				output;
+	bool					check;
+	std::vector<std::string> files;
+};
+
+typedef std::vector<double> Samples;
+
+
+static double
+now_msecs()
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+
+//	#pragma mark - memory
+
+
+// Resets the peak resident set size where the kernel allows it, so that
+// every document reports its own high-water mark
+static bool
+reset_peak_memory()
+{
+	int fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd < 0)
+		return false;
+	bool reset = write(fd, "5", 1) == 1;
+	close(fd);
+	return reset;
+}
+
+
+static long
+peak_memory_kb()
+{
+	FILE* file = fopen("/proc/self/status", "r");
+	if (file == NULL)
+		return -1;
+
+	char line[256];
+	long peak = -1;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (strncmp(line, "VmHWM:", 6) == 0) {
+			peak = strtol(line + 6, NULL, 10);
+			break;
+		}
+	}
+	fclose(file);
+	return peak;
+}
+
+
+//	#pragma mark - output
+
+
+static void
+write_samples(FILE* out, const char* name, Samples samples,
+	const char* indent)
+{
+	fprintf(out, "%s\"%s\": {", indent, name);
+	if (samples.empty()) {
+		fprintf(out, "\"runs\": 0}");
+		return;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < samples.size(); i++)
+		sum += samples[i];
+
+	// Nearest rank percentiles
+	size_t count = samples.size();
+	size_t p50 = (count * 50 + 99) / 100;
+	size_t p90 = (count * 90 + 99) / 100;
+	size_t p99 = (count * 99 + 99) / 100;
+
+	fprintf(out, "\"runs\": %zu, \"min\": %.4f, \"p50\": %.4f, "
+		"\"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"mean\": %.4f}",
+		count, samples[0], samples[p50 - 1], samples[p90 - 1],
+		samples[p99 - 1], samples[count - 1], sum / count);
+}
+
+
+static void
+write_string(FILE* out, const char* string)
+{
+	fputc('"', out);
+	for (; *string != '\0'; string++) {
+		if (*string == '"' || *string == '\\')
+			fputc('\\', out);
+		if ((unsigned char)*string >= 0x20)
+			fputc(*string, out);
+	}
+	fputc('"', out);
+}
+
+
+//	#pragma mark - document
+
+
+class BenchDocument {
+public:
+							BenchDocument(const BenchOptions& options);
+							~BenchDocument();
+
+	status_t				Load(const char* path);
+	void					Run(FILE* out);
+	int32					Check();
+
+private:
+	void					_Render(SVGRenderer& renderer, float scale,
+								float offsetX, float offsetY);
+	void					_BuildIndex();
+	Samples					_MeasureRerender(SVGRenderer& renderer);
+	void					_MeasureGradients(FILE* out);
+	void					_MeasureMasks(FILE* out);
+
+private:
+	const BenchOptions&		fOptions;
+	std::string				fPath;
+	char*					fData;
+	NSVGimage*				fImage;
+	SVGGeometry				fGeometry;
+	SVGSpatialIndex			fIndex;
+	SVGRenderBuffer			fBuffer;
+	float					fScale;
+	float					fOffsetX;
+	float					fOffsetY;
+	Samples					fParse;
+	Samples					fPrepare;
+};
+
+
+BenchDocument::BenchDocument(const BenchOptions& options)
+	:
+	fOptions(options),
+	fData(NULL),
+	fImage(NULL),
+	fScale(1.0f),
+	fOffsetX(0.0f),
+	fOffsetY(0.0f)
+{
+	fBuffer.width = options.width;
+	fBuffer.height = options.height;
+	fBuffer.bytesPerRow = options.width * 4;
+	fBuffer.bits = (uint8*)malloc((size_t)fBuffer.bytesPerRow
+		* options.height);
+}
+
+
+BenchDocument::~BenchDocument()
+{
+	fGeometry.Unset();
+	if (fImage != NULL)
+		nsvgDelete(fImage);
+	free(fData);
+	free(fBuffer.bits);
+}
+
+
+status_t
+BenchDocument::Load(const char* path)
+{
+	if (fBuffer.bits == NULL)
+		return B_NO_MEMORY;
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return B_ERROR;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	fData = (char*)malloc(size + 1);
+	if (fData == NULL || fread(fData, 1, size, file) != (size_t)size) {
+		fclose(file);
+		return B_ERROR;
+	}
+	fData[size] = '\0';
+	fclose(file);
+	fPath = path;
+
+	// nsvgParse() modifies its input, so every run parses a fresh copy
+	for (int32 run = 0; run < fOptions.runs; run++) {
+		char* copy = (char*)malloc(size + 1);
+		if (copy == NULL)
+			return B_NO_MEMORY;
+		memcpy(copy, fData, size + 1);
+
+		double start = now_msecs();
+		NSVGimage* image = nsvgParse(copy, "px", 96.0f);
+		fParse.push_back(now_msecs() - start);
+		free(copy);
+
+		if (image == NULL)
+			return B_ERROR;
+		if (fImage != NULL)
+			nsvgDelete(fImage);
+		fImage = image;
+	}
+
+	for (int32 run = 0; run < fOptions.runs; run++) {
+		double start = now_msecs();
+		fGeometry.SetTo(fImage);
+		_BuildIndex();
+		fPrepare.push_back(now_msecs() - start);
+	}
+
+	// Fit the document into the buffer, like the viewer does
+	if (fImage->width > 0 && fImage->height > 0) {
+		fScale = std::min(fBuffer.width / fImage->width,
+			fBuffer.height / fImage->height);
+	}
+	fOffsetX = (fBuffer.width - fImage->width * fScale) / 2.0f;
+	fOffsetY = (fBuffer.height - fImage->height * fScale) / 2.0f;
+	return B_OK;
+}
+
+
+void
+BenchDocument::Run(FILE* out)
+{
+	fprintf(out, "    {\n      \"file\": ");
+	write_string(out, fPath.c_str());
+	fprintf(out, ",\n      \"shapes\": %d, \"masks\": %d, \"paths\": %d, "
+		"\"points\": %d,\n", (int)fGeometry.CountShapes(),
+		(int)fGeometry.CountMasks(), (int)fGeometry.CountPaths(),
+		(int)fGeometry.CountPoints());
+
+	write_samples(out, "parse", fParse, "      ");
+	fprintf(out, ",\n");
+	write_samples(out, "prepare", fPrepare, "      ");
+	fprintf(out, ",\n");
+
+	// A new renderer each run, including the start of its worker threads
+	Samples first;
+	for (int32 run = 0; run < fOptions.runs; run++) {
+		double start = now_msecs();
+		SVGRenderer renderer;
+		renderer.SetThreadCount(fOptions.threads[0]);
+		renderer.SetGeometry(&fGeometry, &fIndex);
+		_Render(renderer, fScale, fOffsetX, fOffsetY);
+		first.push_back(now_msecs() - start);
+	}
+	write_samples(out, "first_render", first, "      ");
+	fprintf(out, ",\n");
+
+	SVGRenderer renderer;
+	renderer.SetThreadCount(fOptions.threads[0]);
+	renderer.SetGeometry(&fGeometry, &fIndex);
+
+	write_samples(out, "rerender", _MeasureRerender(renderer), "      ");
+	fprintf(out, ",\n");
+
+	Samples pan;
+	for (int32 run = 0; run < fOptions.runs; run++) {
+		double start = now_msecs();
+		_Render(renderer, fScale, fOffsetX + (run + 1) * kPanStepX,
+			fOffsetY + (run + 1) * kPanStepY);
+		pan.push_back(now_msecs() - start);
+	}
+	write_samples(out, "pan", pan, "      ");
+	fprintf(out, ",\n");
+
+	// Zoom in and out around the center of the buffer
+	Samples zoom;
+	float centerX = fBuffer.width / 2.0f;
+	float centerY = fBuffer.height / 2.0f;
+	for (int32 run = 0; run < fOptions.runs; run++) {
+		int32 step = run % (kZoomSteps * 2 + 1) - kZoomSteps;
+		float scale = fScale * powf(kZoomFactor, step);
+		float offsetX = centerX - (centerX - fOffsetX) * scale / fScale;
+		float offsetY = centerY - (centerY - fOffsetY) * scale / fScale;
+
+		double start = now_msecs();
+		_Render(renderer, scale, offsetX, offsetY);
+		zoom.push_back(now_msecs() - start);
+	}
+	write_samples(out, "zoom", zoom, "      ");
+	fprintf(out, ",\n");
+
+	fprintf(out, "      \"threads\": [");
+	for (size_t i = 0; i < fOptions.threads.size(); i++) {
+		renderer.SetThreadCount(fOptions.threads[i]);
+		Samples samples = _MeasureRerender(renderer);
+		fprintf(out, "%s\n        {\"threads\": %d, \"workers\": %d, ",
+			i > 0 ? "," : "", (int)fOptions.threads[i],
+			(int)renderer.CountWorkers());
+		write_samples(out, "render", samples, "");
+		fprintf(out, "}");
+	}
+	fprintf(out, "\n      ],\n");
+
+	renderer.SetThreadCount(fOptions.threads[0]);
+	renderer.SetDetailThreshold(kDetailThreshold);
+	Samples detail = _MeasureRerender(renderer);
+	fprintf(out, "      \"detail\": {\"threshold\": %g, \"skipped\": %d, ",
+		kDetailThreshold, (int)renderer.CountSkipped());
+	write_samples(out, "render", detail, "");
+	fprintf(out, "},\n");
+
+	_MeasureGradients(out);
+	fprintf(out, ",\n");
+	_MeasureMasks(out);
+	fprintf(out, ",\n");
+
+	fprintf(out, "      \"peak_memory_kb\": %ld\n    }", peak_memory_kb());
+}
+
+
+// Compares parallel frames with single threaded ones, both with and
+// without the detail threshold and in every display mode. Returns the
+// number of frames that differ.
+int32
+BenchDocument::Check()
+{
+	static const float kScales[] = { 0.3f, 1.0f, 2.7f };
+	static const float kShifts[][2] = {
+		{ 0.0f, 0.0f }, { 37.5f, -53.25f }, { -211.0f, 97.75f }
+	};
+
+	size_t size = (size_t)fBuffer.bytesPerRow * fBuffer.height;
+	uint8* expected = (uint8*)malloc(size);
+	if (expected == NULL)
+		return 1;
+
+	int32 failures = 0;
+	for (int32 mode = SVG_DISPLAY_NORMAL; mode <= SVG_DISPLAY_STROKE_ONLY;
+			mode++) {
+		for (int32 detail = 0; detail < 2; detail++) {
+			SVGRenderer serial;
+			serial.SetThreadCount(1);
+			serial.SetGeometry(&fGeometry, &fIndex);
+			serial.SetDisplayMode((svg_display_mode)mode);
+			serial.SetDetailThreshold(detail ? kDetailThreshold : 0.0f);
+
+			for (size_t t = 0; t < fOptions.threads.size(); t++) {
+				SVGRenderer parallel;
+				parallel.SetThreadCount(fOptions.threads[t]);
+				parallel.SetGeometry(&fGeometry, &fIndex);
+				parallel.SetDisplayMode((svg_display_mode)mode);
+				parallel.SetDetailThreshold(detail ? kDetailThreshold : 0.0f);
+
+				for (size_t s = 0; s < sizeof(kScales) / sizeof(kScales[0]);
+						s++) {
+					for (size_t o = 0;
+							o < sizeof(kShifts) / sizeof(kShifts[0]); o++) {
+						float scale = fScale * kScales[s];
+						float offsetX = fOffsetX * kScales[s] + kShifts[o][0];
+						float offsetY = fOffsetY * kScales[s] + kShifts[o][1];
+
+						_Render(serial, scale, offsetX, offsetY);
+						memcpy(expected, fBuffer.bits, size);
+						_Render(parallel, scale, offsetX, offsetY);
+						if (memcmp(expected, fBuffer.bits, size) == 0)
+							continue;
+
+						fprintf(stderr, "%s: %d workers differ from one in "
+							"display mode %d%s at scale %g, offset %g,%g\n",
+							fPath.c_str(), (int)parallel.CountWorkers(),
+							(int)mode, detail ? " with detail threshold" : "",
+							scale, offsetX, offsetY);
+						failures++;
+					}
+				}
+			}
+		}
+	}
+
+	free(expected);
+	return failures;
+}
+
+
+void
+BenchDocument::_Render(SVGRenderer& renderer, float scale, float offsetX,
+	float offsetY)
+{
+	agg::rect_i clip(0, 0, fBuffer.width - 1, fBuffer.height - 1);
+	SVGRenderer::ClearBuffer(fBuffer, clip);
+	renderer.Render(fBuffer, scale, offsetX, offsetY, clip);
+}
+
+
+// Same expansion of the shape bounds as the viewer index
+void
+BenchDocument::_BuildIndex()
+{
+	int32 count = fGeometry.CountVisibleShapes();
+	std::vector<float> bounds(count * 4);
+	const int32* visibleShapes = fGeometry.VisibleShapes();
+	for (int32 i = 0; i < count; i++) {
+		const SVGShapeStyle& style = fGeometry.ShapeStyle(visibleShapes[i]);
+		const float* shapeBounds = fGeometry.ShapeBounds(visibleShapes[i]);
+		float expand = style.strokeWidth * style.miterLimit;
+		bounds[i * 4 + 0] = shapeBounds[0] - expand;
+		bounds[i * 4 + 1] = shapeBounds[1] - expand;
+		bounds[i * 4 + 2] = shapeBounds[2] + expand;
+		bounds[i * 4 + 3] = shapeBounds[3] + expand;
+	}
+	fIndex.SetTo(count > 0 ? &bounds[0] : NULL, count);
+}
+
+
+Samples
+BenchDocument::_MeasureRerender(SVGRenderer& renderer)
+{
+	// The first pass warms up the caches and the worker pool
+	_Render(renderer, fScale, fOffsetX, fOffsetY);
+
+	Samples samples;
+	for (int32 run = 0; run < fOptions.runs; run++) {
+		double start = now_msecs();
+		_Render(renderer, fScale, fOffsetX, fOffsetY);
+		samples.push_back(now_msecs() - start);
+	}
+	return samples;
+}
+
+
+// Fills the whole buffer with every gradient of the document, as the
+// offscreen gradient fallbacks of the viewer do. The color table is a
+// plain ramp; the kernels do not depend on its contents.
+void
+BenchDocument::_MeasureGradients(FILE* out)
+{
+	std::vector<const NSVGpaint*> paints;
+	for (NSVGshape* shape = fImage->shapes; shape != NULL;
+			shape = shape->next) {
+		if (shape->fill.type == NSVG_PAINT_LINEAR_GRADIENT
+			|| shape->fill.type == NSVG_PAINT_RADIAL_GRADIENT)
+			paints.push_back(&shape->fill);
+		if (shape->stroke.type == NSVG_PAINT_LINEAR_GRADIENT
+			|| shape->stroke.type == NSVG_PAINT_RADIAL_GRADIENT)
+			paints.push_back(&shape->stroke);
+	}
+
+	uint8 lut[256 * 4];
+	for (int32 i = 0; i < 256; i++) {
+		lut[i * 4 + 0] = i;
+		lut[i * 4 + 1] = 255 - i;
+		lut[i * 4 + 2] = i / 2;
+		lut[i * 4 + 3] = 255;
+	}
+
+	fprintf(out, "      \"gradients\": %d,\n      \"gradient_fill\": {",
+		(int)paints.size());
+	for (int32 kernel = SVG_GRADIENT_KERNEL_SCALAR;
+			kernel <= SVG_GRADIENT_KERNEL_AVX2; kernel++) {
+		Samples samples;
+		for (int32 run = 0; !paints.empty() && run < fOptions.runs; run++) {
+			const NSVGpaint* paint = paints[run % paints.size()];
+
+			SVGGradientRow row;
+			row.lut = lut;
+			row.xform = paint->gradient->xform;
+			row.type = paint->type;
+			row.spread = paint->gradient->spread;
+			row.fx = paint->gradient->fx;
+			row.fy = paint->gradient->fy;
+			row.startX = -fOffsetX / fScale;
+			row.stepX = 1.0f / fScale;
+
+			double start = now_msecs();
+			for (int32 y = 0; y < fBuffer.height; y++) {
+				row.y = (y - fOffsetY) / fScale;
+				svg_gradient_fill_row_with((svg_gradient_kernel)kernel, row,
+					fBuffer.bits + y * fBuffer.bytesPerRow, fBuffer.width);
+			}
+			samples.push_back(now_msecs() - start);
+		}
+		fprintf(out, "%s\n        ", kernel > 0 ? "," : "");
+		write_samples(out, svg_gradient_kernel_name(
+			(svg_gradient_kernel)kernel), samples, "");
+	}
+	fprintf(out, "\n      }");
+}
+
+
+// Composites the rendered document with itself as a luminance mask over
+// the whole buffer, as the offscreen mask fallback of the viewer does
+void
+BenchDocument::_MeasureMasks(FILE* out)
+{
+	SVGRenderer renderer;
+	renderer.SetThreadCount(fOptions.threads[0]);
+	renderer.SetGeometry(&fGeometry, &fIndex);
+	_Render(renderer, fScale, fOffsetX, fOffsetY);
+
+	size_t size = (size_t)fBuffer.bytesPerRow * fBuffer.height;
+	uint8* content = (uint8*)malloc(size);
+
+	fprintf(out, "      \"mask_apply\": {");
+	for (int32 kernel = SVG_MASK_KERNEL_SCALAR;
+			kernel <= SVG_MASK_KERNEL_AVX2; kernel++) {
+		Samples samples;
+		for (int32 run = 0; content != NULL && run < fOptions.runs; run++) {
+			memcpy(content, fBuffer.bits, size);
+
+			double start = now_msecs();
+			for (int32 y = 0; y < fBuffer.height; y++) {
+				svg_mask_apply_row_with((svg_mask_kernel)kernel,
+					content + y * fBuffer.bytesPerRow,
+					fBuffer.bits + y * fBuffer.bytesPerRow, fBuffer.width);
+			}
+			samples.push_back(now_msecs() - start);
+		}
+		fprintf(out, "%s\n        ", kernel > 0 ? "," : "");
+		write_samples(out, svg_mask_kernel_name((svg_mask_kernel)kernel),
+			samples, "");
+	}
+	fprintf(out, "\n      }");
+
+	free(content);
+}
+
+
+//	#pragma mark - main
+
+
+static void
+print_usage()
+{
+	fprintf(stderr, "usage: svgbench [-r runs] [-s WIDTHxHEIGHT] "
+		"[-t 1,2,4,0] [-o file] [files...]\n"
+		"       svgbench -c [-s WIDTHxHEIGHT] [-t 2,4,0] [files...]\n");
+}
+
+
+static bool
+parse_threads(const char* list, std::vector<int32>& threads)
+{
+	threads.clear();
+	while (*list != '\0') {
+		char* end;
+		long count = strtol(list, &end, 10);
+		if (end == list || count < 0)
+			return false;
+		threads.push_back(count);
+		list = *end == ',' ? end + 1 : end;
+		if (*end != ',' && *end != '\0')
+			return false;
+	}
+	return !threads.empty();
+}
+
+
+static void
+add_corpus(const char* directory, std::vector<std::string>& files)
+{
+	DIR* dir = opendir(directory);
+	if (dir == NULL)
+		return;
+
+	while (struct dirent* entry = readdir(dir)) {
+		size_t length = strlen(entry->d_name);
+		if (length > 4 && strcmp(entry->d_name + length - 4, ".svg") == 0)
+			files.push_back(std::string(directory) + "/" + entry->d_name);
+	}
+	closedir(dir);
+	std::sort(files.begin(), files.end());
+}
+
+
+static int
+run_check(BenchOptions& options, bool threadsGiven)
+{
+	// A fixed count, so that the tiles are split even on a single core
+	if (!threadsGiven)
+		options.threads.assign(1, kCheckThreads);
+	options.runs = 1;
+
+	int status = 0;
+	for (size_t i = 0; i < options.files.size(); i++) {
+		BenchDocument document(options);
+		if (document.Load(options.files[i].c_str()) != B_OK) {
+			fprintf(stderr, "svgbench: cannot load %s\n",
+				options.files[i].c_str());
+			status = 1;
+			continue;
+		}
+
+		int32 failures = document.Check();
+		printf("%s: %s\n", options.files[i].c_str(),
+			failures == 0 ? "ok" : "FAILED");
+		if (failures > 0)
+			status = 1;
+	}
+	return status;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	BenchOptions options;
+	options.runs = kDefaultRuns;
+	options.width = kDefaultWidth;
+	options.height = kDefaultHeight;
+	options.threads.push_back(0);
+	options.output = NULL;
+	options.check = false;
+	bool threadsGiven = false;
+
+	int option;
+	while ((option = getopt(argc, argv, "cr:s:t:o:h")) != -1) {
+		switch (option) {
+			case 'c':
+				options.check = true;
+				break;
+			case 'r':
+				options.runs = atoi(optarg);
+				break;
+			case 's':
+				if (sscanf(optarg, "%dx%d", &options.width,
+						&options.height) != 2) {
+					print_usage();
+					return 1;
+				}
+				break;
+			case 't':
+				if (!parse_threads(optarg, options.threads)) {
+					print_usage();
+					return 1;
+				}
+				threadsGiven = true;
+				break;
+			case 'o':
+				options.output = optarg;
+				break;
+			default:
+				print_usage();
+				return 1;
+		}
+	}
+
+	if (options.runs < 1 || options.width < 1 || options.height < 1) {
+		print_usage();
+		return 1;
+	}
+
+	for (int i = optind; i < argc; i++)
+		options.files.push_back(argv[i]);
+	if (options.files.empty())
+		add_corpus("corpus", options.files);
+	if (options.files.empty()) {
+		fprintf(stderr, "svgbench: no documents to measure\n");
+		return 1;
+	}
+
+	if (options.check)
+		return run_check(options, threadsGiven);
+
+	FILE* out = stdout;
+	if (options.output != NULL) {
+		out = fopen(options.output, "w");
+		if (out == NULL) {
+			fprintf(stderr, "svgbench: cannot write %s\n", options.output);
+			return 1;
+		}
+	}
+
+	fprintf(out, "{\n  \"width\": %d,\n  \"height\": %d,\n  \"runs\": %d,\n"
+		"  \"gradient_kernel\": \"%s\",\n  \"mask_kernel\": \"%s\",\n"
+		"  \"peak_memory_reset\": %s,\n  \"documents\": [\n",
+		(int)options.width, (int)options.height, (int)options.runs,
+		svg_gradient_kernel_name(svg_gradient_active_kernel()),
+		svg_mask_kernel_name(svg_mask_active_kernel()),
+		reset_peak_memory() ? "true" : "false");
+
+	int status = 0;
+	bool first = true;
+	for (size_t i = 0; i < options.files.size(); i++) {
+		reset_peak_memory();
+
+		BenchDocument document(options);
+		if (document.Load(options.files[i].c_str()) != B_OK) {
+			fprintf(stderr, "svgbench: cannot load %s\n",
+				options.files[i].c_str());
+			status = 1;
+			continue;
+		}
+
+		if (!first)
+			fprintf(out, ",\n");
+		first = false;
+		document.Run(out);
+		fflush(out);
+	}
+
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout)
+		fclose(out);
+	return status;
+}
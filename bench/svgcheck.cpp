@@ -0,0 +1,649 @@
+/*
+ * Copyright 2026, Gerasim Troeglazov, 3dEyes@gmail.com. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+// Checks that the SIMD span kernels produce exactly the same bytes as the
+// scalar ones. Every supported kernel runs on randomized rows, the mask
+// kernels also on every content alpha and mask combination, and the output
+// is compared byte by byte. The focal point gradients, which every kernel
+// shares, are compared against the closed form of the gradient instead,
+// and the plain gradients also against the formula the kernels replaced:
+//
+//	svgcheck [-n rounds] [-s seed]
+//
+// The exit status is 1 if any kernel differs from its reference.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nanosvg.h"
+
+#include "SVGGradientKernel.h"
+#include "SVGMaskKernel.h"
+
+
+static const int32 kDefaultRounds = 2000;
+// Longer than a few SIMD blocks, so that every tail length shows up
+static const int32 kMaxRowLength = 67;
+static const int32 kMaxReports = 10;
+
+
+struct CheckContext {
+	uint64					seed;
+	int32					failures;
+};
+
+
+static uint32
+next_random(CheckContext& context)
+{
+	// xorshift64*
+	context.seed ^= context.seed >> 12;
+	context.seed ^= context.seed << 25;
+	context.seed ^= context.seed >> 27;
+	return (uint32)((context.seed * 2685821657736338717ULL) >> 32);
+}
+
+
+static float
+random_unit(CheckContext& context)
+{
+	return (next_random(context) >> 8) / (float)(1 << 24);
+}
+
+
+// Mostly ordinary values, but also the ones that kernels tend to get
+// wrong: NaN, infinities, huge magnitudes and exact zeros
+static float
+random_value(CheckContext& context, float range)
+{
+	switch (next_random(context) % 32) {
+		case 0:
+			return NAN;
+		case 1:
+			return INFINITY;
+		case 2:
+			return -INFINITY;
+		case 3:
+			return 1e30f;
+		case 4:
+			return -1e30f;
+		case 5:
+			return 3e9f;
+		case 6:
+			return 0.0f;
+		default:
+			return (random_unit(context) * 2.0f - 1.0f) * range;
+	}
+}
+
+
+static void
+random_bytes(CheckContext& context, uint8* bytes, int32 length)
+{
+	for (int32 i = 0; i < length; i++)
+		bytes[i] = (uint8)next_random(context);
+}
+
+
+static bool
+compare_row(CheckContext& context, const char* test, const char* kernel,
+	const uint8* expected, const uint8* actual, int32 count)
+{
+	if (memcmp(expected, actual, count * 4) == 0)
+		return true;
+
+	if (context.failures++ < kMaxReports) {
+		for (int32 i = 0; i < count; i++) {
+			if (memcmp(expected + i * 4, actual + i * 4, 4) == 0)
+				continue;
+			const uint8* e = expected + i * 4;
+			const uint8* a = actual + i * 4;
+			fprintf(stderr, "%s/%s: pixel %d of %d is %02x%02x%02x%02x, "
+				"scalar gives %02x%02x%02x%02x\n", test, kernel, (int)i,
+				(int)count, a[0], a[1], a[2], a[3], e[0], e[1], e[2], e[3]);
+			break;
+		}
+	}
+	return false;
+}
+
+
+//	#pragma mark - gradients
+
+
+static const int8 kGradientTypes[] = {
+	NSVG_PAINT_LINEAR_GRADIENT,
+	NSVG_PAINT_RADIAL_GRADIENT
+};
+
+static const int8 kSpreadModes[] = {
+	NSVG_SPREAD_PAD,
+	NSVG_SPREAD_REFLECT,
+	NSVG_SPREAD_REPEAT
+};
+
+
+static void
+random_gradient_row(CheckContext& context, SVGGradientRow& row,
+	float* xform, int8 type, int8 spread, bool focal)
+{
+	// Gradient space spans a few periods over the row, so that every
+	// spread mode wraps
+	for (int32 i = 0; i < 6; i++)
+		xform[i] = random_value(context, i < 4 ? 0.1f : 4.0f);
+
+	row.xform = xform;
+	row.type = type;
+	row.spread = spread;
+	row.fx = 0.0f;
+	row.fy = 0.0f;
+	if (focal) {
+		row.fx = random_unit(context) * 1.6f - 0.8f;
+		row.fy = random_unit(context) * 1.2f - 0.6f;
+	}
+	row.startX = random_value(context, 500.0f);
+	row.stepX = random_value(context, 4.0f);
+	row.y = random_value(context, 500.0f);
+}
+
+
+static void
+check_gradients(CheckContext& context, int32 rounds)
+{
+	uint8 lut[256 * 4];
+	float xform[6];
+	uint8 source[kMaxRowLength * 4];
+	uint8 expected[kMaxRowLength * 4];
+	uint8 actual[kMaxRowLength * 4];
+
+	for (int32 k = SVG_GRADIENT_KERNEL_SSE2; k <= SVG_GRADIENT_KERNEL_AVX2;
+			k++) {
+		svg_gradient_kernel kernel = (svg_gradient_kernel)k;
+		const char* name = svg_gradient_kernel_name(kernel);
+		if (!svg_gradient_kernel_supported(kernel)) {
+			printf("gradient/%s: not supported, skipped\n", name);
+			continue;
+		}
+
+		int32 failures = context.failures;
+		int32 rows = 0;
+		for (size_t t = 0; t < sizeof(kGradientTypes); t++) {
+			for (size_t s = 0; s < sizeof(kSpreadModes); s++) {
+				for (int32 focal = 0; focal < 2; focal++) {
+					if (focal && kGradientTypes[t]
+							!= NSVG_PAINT_RADIAL_GRADIENT)
+						continue;
+
+					for (int32 round = 0; round < rounds; round++) {
+						SVGGradientRow row;
+						random_gradient_row(context, row, xform,
+							kGradientTypes[t], kSpreadModes[s], focal != 0);
+						random_bytes(context, lut, sizeof(lut));
+						row.lut = lut;
+						int32 count = 1 + next_random(context)
+							% kMaxRowLength;
+
+						svg_gradient_fill_row_with(SVG_GRADIENT_KERNEL_SCALAR,
+							row, expected, count);
+						svg_gradient_fill_row_with(kernel, row, actual,
+							count);
+						compare_row(context, "gradient fill", name,
+							expected, actual, count);
+
+						// Content with transparent pixels, which the apply
+						// kernels have to leave alone
+						random_bytes(context, source, count * 4);
+						for (int32 i = 0; i < count; i++) {
+							if (next_random(context) % 4 == 0)
+								source[i * 4 + 3] = 0;
+						}
+						memcpy(expected, source, count * 4);
+						memcpy(actual, source, count * 4);
+						svg_gradient_apply_row_with(
+							SVG_GRADIENT_KERNEL_SCALAR, row, expected, count);
+						svg_gradient_apply_row_with(kernel, row, actual,
+							count);
+						compare_row(context, "gradient apply", name,
+							expected, actual, count);
+						rows += 2;
+					}
+				}
+			}
+		}
+
+		printf("gradient/%s: %d rows, %s\n", name, (int)rows,
+			context.failures == failures ? "ok" : "FAILED");
+	}
+}
+
+
+// The focal point kernel evaluates the quadratic incrementally, so it is
+// checked against the closed form t = (b + sqrt(b^2 + k|D|^2)) / k instead,
+// evaluated per pixel in double precision. The plain kernels are checked
+// against the per-pixel formula the view used before them. In both cases
+// the LUT holds its own index, and the kernel may be off by at most one
+// LUT entry.
+static const int32 kMaxReferenceRowLength = 300;
+static const int32 kMaxReferenceDifference = 1;
+
+
+static void
+make_index_lut(uint8* lut)
+{
+	for (int32 i = 0; i < 256; i++) {
+		lut[i * 4 + 0] = (uint8)i;
+		lut[i * 4 + 1] = (uint8)i;
+		lut[i * 4 + 2] = (uint8)i;
+		lut[i * 4 + 3] = 255;
+	}
+}
+
+
+static int32
+index_difference(int8 spread, int32 a, int32 b)
+{
+	int32 difference = abs(a - b);
+	// Both ends of the LUT meet where a repeated gradient wraps
+	if (spread == NSVG_SPREAD_REPEAT && difference > 127)
+		difference = 255 - difference;
+	return difference;
+}
+
+
+static double
+spread_reference(int8 spread, double t)
+{
+	switch (spread) {
+		case NSVG_SPREAD_REPEAT:
+			return t - floor(t);
+
+		case NSVG_SPREAD_REFLECT:
+		{
+			t = fabs(t);
+			double period = floor(t);
+			t -= period;
+			return fmod(period, 2.0) != 0.0 ? 1.0 - t : t;
+		}
+
+		case NSVG_SPREAD_PAD:
+		default:
+			return t < 0.0 ? 0.0 : (t > 1.0 ? 1.0 : t);
+	}
+}
+
+
+static int32
+focal_reference(const SVGGradientRow& row, int32 i)
+{
+	double fx = row.fx;
+	double fy = row.fy;
+	// The same limit as the kernel. Close to the circle a change in k in
+	// the last bit of a float already moves t by several LUT entries.
+	const double limit = 0.99f;
+	double distance = sqrt(fx * fx + fy * fy);
+	if (distance > limit) {
+		fx *= limit / distance;
+		fy *= limit / distance;
+	}
+	double k = 1.0 - (fx * fx + fy * fy);
+
+	const float* m = row.xform;
+	double x = (double)row.startX + (double)i * row.stepX;
+	double dx = m[0] * x + m[2] * (double)row.y + m[4] - fx;
+	double dy = m[1] * x + m[3] * (double)row.y + m[5] - fy;
+	double b = fx * dx + fy * dy;
+	double disc = b * b + k * (dx * dx + dy * dy);
+	double t = (b + sqrt(disc > 0.0 ? disc : 0.0)) / k;
+
+	int32 index = (int32)(spread_reference(row.spread, t) * 255.0 + 0.5);
+	return index < 0 ? 0 : (index > 255 ? 255 : index);
+}
+
+
+static void
+random_reference_xform(CheckContext& context, float* xform)
+{
+	for (int32 i = 0; i < 6; i++) {
+		xform[i] = (random_unit(context) * 2.0f - 1.0f)
+			* (i < 4 ? 0.1f : 4.0f);
+	}
+}
+
+
+static void
+random_focal_row(CheckContext& context, SVGGradientRow& row, float* xform)
+{
+	random_reference_xform(context, xform);
+	row.xform = xform;
+
+	// Anywhere in the circle, at the clamping distance and beyond it. Focal
+	// points closer to the center than 0.001 take the plain radial path.
+	float angle = random_unit(context) * 6.2831853f;
+	float distance;
+	switch (next_random(context) % 4) {
+		case 0:
+			distance = 0.98f + random_unit(context) * 0.02f;
+			break;
+		case 1:
+			distance = 1.0f + random_unit(context) * 0.5f;
+			break;
+		default:
+			distance = 0.001f + random_unit(context) * 0.98f;
+			break;
+	}
+	row.fx = cosf(angle) * distance;
+	row.fy = sinf(angle) * distance;
+
+	// Mostly steps below a pixel, but also ones that cross several
+	// gradient periods per pixel
+	float step = next_random(context) % 4 == 0 ? 40.0f : 1.5f;
+	row.startX = (random_unit(context) * 2.0f - 1.0f) * 500.0f;
+	row.stepX = (random_unit(context) * 2.0f - 1.0f) * step;
+	row.y = (random_unit(context) * 2.0f - 1.0f) * 500.0f;
+}
+
+
+static void
+check_focal(CheckContext& context, int32 rounds)
+{
+	uint8 lut[256 * 4];
+	make_index_lut(lut);
+
+	float xform[6];
+	uint8 actual[kMaxReferenceRowLength * 4];
+	int32 failures = context.failures;
+	int32 rows = 0;
+	int32 worst = 0;
+
+	for (size_t s = 0; s < sizeof(kSpreadModes); s++) {
+		for (int32 round = 0; round < rounds; round++) {
+			SVGGradientRow row;
+			random_focal_row(context, row, xform);
+			row.type = NSVG_PAINT_RADIAL_GRADIENT;
+			row.spread = kSpreadModes[s];
+			row.lut = lut;
+			int32 count = 1 + next_random(context) % kMaxReferenceRowLength;
+
+			svg_gradient_fill_row_with(SVG_GRADIENT_KERNEL_SCALAR, row,
+				actual, count);
+			rows++;
+
+			for (int32 i = 0; i < count; i++) {
+				int32 expected = focal_reference(row, i);
+				int32 difference = index_difference(row.spread,
+					actual[i * 4], expected);
+				if (difference > worst)
+					worst = difference;
+				if (difference <= kMaxReferenceDifference)
+					continue;
+
+				if (context.failures++ < kMaxReports) {
+					fprintf(stderr, "focal: pixel %d of %d has index %d, "
+						"the closed form gives %d (focal point %g,%g, "
+						"step %g)\n", (int)i, (int)count, actual[i * 4],
+						(int)expected, row.fx, row.fy, row.stepX);
+				}
+				break;
+			}
+		}
+	}
+
+	printf("focal: %d rows, largest difference %d, %s\n", (int)rows,
+		(int)worst, context.failures == failures ? "ok" : "FAILED");
+}
+
+
+// The formula of BSVGView::_ApplyGradientToBuffer() before the kernels.
+// It mapped every pixel to document space on its own, where the kernels
+// step along the row, so the rounding differs.
+static int32
+legacy_reference(const float* m, int8 type, int8 spread, float left,
+	float top, float offsetX, float offsetY, float invScale, int32 px)
+{
+	float viewX = left + px;
+	float viewY = top;
+	float svgX = (viewX - offsetX) * invScale;
+	float svgY = (viewY - offsetY) * invScale;
+
+	float gx = m[0] * svgX + m[2] * svgY + m[4];
+	float gy = m[1] * svgX + m[3] * svgY + m[5];
+
+	float t;
+	if (type == NSVG_PAINT_LINEAR_GRADIENT)
+		t = gy;
+	else
+		t = sqrtf(gx * gx + gy * gy);
+
+	t = (float)spread_reference(spread, t);
+
+	int idx = (int)(t * 255.0f + 0.5f);
+	if (idx < 0)
+		idx = 0;
+	if (idx > 255)
+		idx = 255;
+	return idx;
+}
+
+
+static void
+check_legacy(CheckContext& context, int32 rounds)
+{
+	uint8 lut[256 * 4];
+	make_index_lut(lut);
+
+	float xform[6];
+	uint8 actual[kMaxReferenceRowLength * 4];
+	int32 failures = context.failures;
+	int32 rows = 0;
+	int64 pixels = 0;
+	int64 differing = 0;
+
+	for (size_t t = 0; t < sizeof(kGradientTypes); t++) {
+		for (size_t s = 0; s < sizeof(kSpreadModes); s++) {
+			for (int32 round = 0; round < rounds; round++) {
+				random_reference_xform(context, xform);
+				// Zoom levels from 1:20 to 20:1, as the view sets them up
+				float scale = expf((random_unit(context) * 2.0f - 1.0f)
+					* 3.0f);
+				float invScale = 1.0f / scale;
+				float offsetX = (random_unit(context) * 2.0f - 1.0f) * 2000.0f;
+				float offsetY = (random_unit(context) * 2.0f - 1.0f) * 2000.0f;
+				float left = (float)(next_random(context) % 2000);
+				float top = (float)(next_random(context) % 2000);
+
+				SVGGradientRow row;
+				row.lut = lut;
+				row.xform = xform;
+				row.type = kGradientTypes[t];
+				row.spread = kSpreadModes[s];
+				row.fx = 0.0f;
+				row.fy = 0.0f;
+				row.startX = (left - offsetX) * invScale;
+				row.stepX = invScale;
+				row.y = (top - offsetY) * invScale;
+				int32 count = 1 + next_random(context)
+					% kMaxReferenceRowLength;
+
+				svg_gradient_fill_row_with(SVG_GRADIENT_KERNEL_SCALAR, row,
+					actual, count);
+				rows++;
+				pixels += count;
+
+				for (int32 i = 0; i < count; i++) {
+					int32 expected = legacy_reference(xform, row.type,
+						row.spread, left, top, offsetX, offsetY, invScale, i);
+					int32 difference = index_difference(row.spread,
+						actual[i * 4], expected);
+					if (difference == 0)
+						continue;
+					differing++;
+					if (difference <= kMaxReferenceDifference)
+						continue;
+
+					if (context.failures++ < kMaxReports) {
+						fprintf(stderr, "legacy: pixel %d of %d has index "
+							"%d, the old formula gives %d (scale %g)\n",
+							(int)i, (int)count, actual[i * 4], (int)expected,
+							scale);
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	printf("legacy: %d rows, %lld of %lld pixels one entry off, %s\n",
+		(int)rows, (long long)differing, (long long)pixels,
+		context.failures == failures ? "ok" : "FAILED");
+}
+
+
+//	#pragma mark - masks
+
+
+typedef void (*mask_row_function)(svg_mask_kernel kernel, uint8* content,
+	const uint8* mask, int32 count);
+
+
+static bool
+check_mask_row(CheckContext& context, const char* test, const char* kernel,
+	mask_row_function function, svg_mask_kernel variant, const uint8* source,
+	const uint8* mask, uint8* expected, uint8* actual, int32 count)
+{
+	memcpy(expected, source, count * 4);
+	memcpy(actual, source, count * 4);
+	function(SVG_MASK_KERNEL_SCALAR, expected, mask, count);
+	function(variant, actual, mask, count);
+	return compare_row(context, test, kernel, expected, actual, count);
+}
+
+
+static void
+check_masks(CheckContext& context, int32 rounds)
+{
+	static const mask_row_function kFunctions[] = {
+		svg_mask_apply_row_with,
+		svg_mask_apply_alpha_row_with
+	};
+	static const char* kTests[] = {
+		"mask apply",
+		"mask apply alpha"
+	};
+
+	uint8 source[256 * 4];
+	uint8 mask[256 * 4];
+	uint8 expected[256 * 4];
+	uint8 actual[256 * 4];
+
+	for (int32 k = SVG_MASK_KERNEL_SSE2; k <= SVG_MASK_KERNEL_AVX2; k++) {
+		svg_mask_kernel kernel = (svg_mask_kernel)k;
+		const char* name = svg_mask_kernel_name(kernel);
+		if (!svg_mask_kernel_supported(kernel)) {
+			printf("mask/%s: not supported, skipped\n", name);
+			continue;
+		}
+
+		int32 failures = context.failures;
+		int32 rows = 0;
+		for (int32 f = 0; f < 2; f++) {
+			// Every content alpha against every mask luminance and alpha.
+			// A gray mask pixel of value v has the luminance v. The color
+			// channels vary between the pixels of a row.
+			for (int32 luminance = 0; luminance < 256; luminance++) {
+				for (int32 maskAlpha = 0; maskAlpha < 256; maskAlpha++) {
+					for (int32 i = 0; i < 256; i++) {
+						uint8* m = mask + i * 4;
+						m[0] = m[1] = m[2] = (uint8)luminance;
+						m[3] = (uint8)maskAlpha;
+
+						uint8* c = source + i * 4;
+						c[0] = (uint8)(i * 7 + maskAlpha);
+						c[1] = (uint8)(i * 13 + luminance);
+						c[2] = (uint8)next_random(context);
+						c[3] = (uint8)i;
+					}
+					check_mask_row(context, kTests[f], name, kFunctions[f],
+						kernel, source, mask, expected, actual, 256);
+					rows++;
+				}
+			}
+
+			// Colored masks and every tail length
+			for (int32 round = 0; round < rounds; round++) {
+				int32 count = 1 + next_random(context) % kMaxRowLength;
+				random_bytes(context, source, count * 4);
+				random_bytes(context, mask, count * 4);
+				for (int32 i = 0; i < count; i++) {
+					uint32 special = next_random(context) % 8;
+					if (special == 0)
+						source[i * 4 + 3] = 0;
+					else if (special == 1)
+						memset(mask + i * 4, 0xff, 4);
+				}
+				check_mask_row(context, kTests[f], name, kFunctions[f],
+					kernel, source, mask, expected, actual, count);
+				rows++;
+			}
+		}
+
+		printf("mask/%s: %d rows, %s\n", name, (int)rows,
+			context.failures == failures ? "ok" : "FAILED");
+	}
+}
+
+
+//	#pragma mark - main
+
+
+static void
+print_usage()
+{
+	fprintf(stderr, "usage: svgcheck [-n rounds] [-s seed]\n");
+}
+
+
+int
+main(int argc, char** argv)
+{
+	CheckContext context;
+	context.seed = 0x9e3779b97f4a7c15ULL;
+	context.failures = 0;
+	int32 rounds = kDefaultRounds;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (option) {
+			case 'n':
+				rounds = atoi(optarg);
+				break;
+			case 's':
+				context.seed = strtoull(optarg, NULL, 0);
+				break;
+			default:
+				print_usage();
+				return 1;
+		}
+	}
+
+	if (rounds < 1 || context.seed == 0) {
+		print_usage();
+		return 1;
+	}
+
+	check_gradients(context, rounds);
+	check_focal(context, rounds);
+	check_legacy(context, rounds);
+	check_masks(context, rounds);
+
+	if (context.failures > 0) {
+		fprintf(stderr, "svgcheck: %d rows differ from the reference\n",
+			(int)context.failures);
+		return 1;
+	}
+	return 0;
+}
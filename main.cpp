@@ -13,6 +13,7 @@
 #include <MenuItem.h>
 #include <FilePanel.h>
 #include <stdio.h>
+#include <Entry.h>
 #include <Path.h>
 
 const uint32 MSG_OPEN_FILE = 'open';
@@ -31,6 +32,9 @@ const uint32 MSG_BBOX_FRAME = 'bbfr';
 const uint32 MSG_BBOX_GRAY = 'bbgr';
 
 const uint32 MSG_TOGGLE_TRANSPARENCY = 'tgtr';
+const uint32 MSG_TOGGLE_SOFTWARE_RENDERING = 'tgsw';
+const uint32 MSG_TOGGLE_PROGRESSIVE_RENDERING = 'tgpr';
+const uint32 MSG_TOGGLE_RENDER_STATS = 'tgst';
 
 const uint32 MSG_SVG_STATUS_UPDATE = 'svgu';
 
@@ -45,7 +49,8 @@ public:
 	SVGWindow(const char* filePath = NULL)
 		: BWindow(BRect(100, 100, 800, 700), "SVG Viewer",
 				B_TITLED_WINDOW, B_ASYNCHRONOUS_CONTROLS | B_QUIT_ON_WINDOW_CLOSE),
-		fOpenPanel(NULL)
+		fOpenPanel(NULL),
+		fDocumentTitle("SVG Viewer")
 	{
 		BRect bounds = Bounds();
 
@@ -72,6 +77,9 @@ public:
 
 		viewMenu->AddSeparatorItem();
 		viewMenu->AddItem(new BMenuItem("Show Transparency Grid", new BMessage(MSG_TOGGLE_TRANSPARENCY), 'T'));
+		viewMenu->AddItem(new BMenuItem("Software Rendering", new BMessage(MSG_TOGGLE_SOFTWARE_RENDERING), 'R'));
+		viewMenu->AddItem(new BMenuItem("Progressive Rendering", new BMessage(MSG_TOGGLE_PROGRESSIVE_RENDERING)));
+		viewMenu->AddItem(new BMenuItem("Show Render Statistics", new BMessage(MSG_TOGGLE_RENDER_STATS)));
 		menuBar->AddItem(viewMenu);
 
 		BMenu* bboxMenu = new BMenu("BoundingBox");
@@ -106,6 +114,7 @@ public:
 		svgRect.top = menuBar->Bounds().bottom + 1;
 
 		fSVGView = new BSVGView(svgRect, "svg_view");
+		fSVGView->SetInteractiveScaling(true);
 		AddChild(fSVGView);
 
 		if (filePath)
@@ -126,15 +135,15 @@ public:
 			return;
 		}
 
-		status_t result = fSVGView->LoadFromFile(filePath);
+		status_t result = fSVGView->LoadFromFileAsync(filePath, BMessenger(this));
 		if (result != B_OK) {
 			BString error;
 			error.SetToFormat("Error loading SVG file: %s", filePath);
 			ShowError(error.String());
 		} else {
 			BPath path(filePath);
-			BString title("SVG Viewer - ");
-			title << path.Leaf();
+			BString title("SVG Viewer - Loading ");
+			title << path.Leaf() << B_UTF8_ELLIPSIS;
 			SetTitle(title.String());
 		}
 	}
@@ -148,6 +157,12 @@ public:
 	virtual void MessageReceived(BMessage* message)
 	{
 		switch (message->what) {
+			case SVG_MSG_LOAD_PROGRESS:
+				HandleLoadProgress(message);
+				break;
+			case SVG_MSG_LOAD_COMPLETED:
+				HandleLoadCompleted(message);
+				break;
 			case MSG_OPEN_FILE:
 				if (!fOpenPanel) {
 					fOpenPanel = new BFilePanel(B_OPEN_PANEL, NULL, NULL, 0, false);
@@ -202,6 +217,19 @@ public:
 				fSVGView->SetShowTransparency(!fSVGView->ShowTransparency());
 				_UpdateMenuStates();
 				break;
+			case MSG_TOGGLE_SOFTWARE_RENDERING:
+				fSVGView->SetRenderMode(fSVGView->RenderMode() == SVG_RENDER_AGG
+					? SVG_RENDER_NATIVE : SVG_RENDER_AGG);
+				_UpdateMenuStates();
+				break;
+			case MSG_TOGGLE_PROGRESSIVE_RENDERING:
+				fSVGView->SetProgressiveRendering(!fSVGView->ProgressiveRendering());
+				_UpdateMenuStates();
+				break;
+			case MSG_TOGGLE_RENDER_STATS:
+				fSVGView->SetShowRenderStats(!fSVGView->ShowRenderStats());
+				_UpdateMenuStates();
+				break;
 			case MSG_SHAPE_SELECTED:
 			{
 				int32 shapeIndex;
@@ -257,6 +285,53 @@ private:
 		}
 	}
 
+	void HandleLoadProgress(BMessage* message)
+	{
+		const char* filePath;
+		int32 stage;
+		int64 bytes;
+		int64 total;
+		if (message->FindString("path", &filePath) != B_OK
+			|| message->FindInt32("stage", &stage) != B_OK
+			|| message->FindInt64("bytes", &bytes) != B_OK
+			|| message->FindInt64("total", &total) != B_OK)
+			return;
+
+		BPath path(filePath);
+		BString title("SVG Viewer - ");
+		if (stage == SVG_LOAD_STAGE_READING && total > 0) {
+			title << "Loading " << path.Leaf() << " ("
+				<< (int32)(bytes * 100 / total) << "%)";
+		} else
+			title << "Parsing " << path.Leaf() << B_UTF8_ELLIPSIS;
+		SetTitle(title.String());
+	}
+
+	void HandleLoadCompleted(BMessage* message)
+	{
+		const char* filePath;
+		int32 status;
+		if (message->FindString("path", &filePath) != B_OK
+			|| message->FindInt32("status", &status) != B_OK)
+			return;
+
+		if (status != B_OK) {
+			// A file that fails to parse leaves the previous document shown
+			if (!fSVGView->IsLoaded())
+				fDocumentTitle = "SVG Viewer";
+			SetTitle(fDocumentTitle.String());
+			BString error;
+			error.SetToFormat("Error loading SVG file: %s", filePath);
+			ShowError(error.String());
+			return;
+		}
+
+		BPath path(filePath);
+		fDocumentTitle = "SVG Viewer - ";
+		fDocumentTitle << path.Leaf();
+		SetTitle(fDocumentTitle.String());
+	}
+
 	void _UpdateMenuStates()
 	{
 		BMenuBar* menuBar = KeyMenuBar();
@@ -287,6 +362,21 @@ private:
 			if (transparencyItem) {
 				transparencyItem->SetMarked(fSVGView->ShowTransparency());
 			}
+
+			BMenuItem* softwareItem = viewMenu->FindItem("Software Rendering");
+			if (softwareItem) {
+				softwareItem->SetMarked(fSVGView->RenderMode() == SVG_RENDER_AGG);
+			}
+
+			BMenuItem* progressiveItem = viewMenu->FindItem("Progressive Rendering");
+			if (progressiveItem) {
+				progressiveItem->SetMarked(fSVGView->ProgressiveRendering());
+			}
+
+			BMenuItem* statsItem = viewMenu->FindItem("Show Render Statistics");
+			if (statsItem) {
+				statsItem->SetMarked(fSVGView->ShowRenderStats());
+			}
 		}
 
 		BMenu* bboxMenu = menuBar->SubmenuAt(2);
@@ -311,15 +401,49 @@ private:
 private:
 	BSVGView* fSVGView;
 	BFilePanel* fOpenPanel;
+	BString fDocumentTitle;
 };
 
 class SVGApp : public BApplication {
 public:
-	SVGApp() : BApplication("application/x-vnd.svg-viewer"), fFilePath(NULL) {}
+	SVGApp() : BApplication("application/x-vnd.svg-viewer") {}
+
+	virtual void ArgvReceived(int32 argc, char** argv)
+	{
+		if (argc < 2)
+			return;
+
+		// Relative paths are relative to the shell that launched us, which
+		// is not our working directory if we were already running
+		BPath path;
+		const char* cwd;
+		BMessage* message = CurrentMessage();
+		if (argv[1][0] != '/' && message != NULL
+			&& message->FindString("cwd", &cwd) == B_OK)
+			path.SetTo(cwd, argv[1]);
+		else
+			path.SetTo(argv[1]);
+
+		BEntry entry(path.Path(), true);
+		if (path.InitCheck() != B_OK || entry.GetPath(&path) != B_OK) {
+			fprintf(stderr, "Cannot open %s\n", argv[1]);
+			return;
+		}
+
+		BWindow* window = WindowAt(0);
+		entry_ref ref;
+		if (window && entry.GetRef(&ref) == B_OK) {
+			BMessage refs(B_REFS_RECEIVED);
+			refs.AddRef("refs", &ref);
+			window->PostMessage(&refs);
+		} else
+			fFilePath = path.Path();
+	}
 
 	virtual void ReadyToRun()
 	{
-		SVGWindow* window = new SVGWindow(fFilePath);
+		SVGWindow* window = new SVGWindow(
+			fFilePath.IsEmpty() ? NULL : fFilePath.String());
 		window->Show();
 	}
 
@@ -332,7 +456,7 @@ public:
 	}
 
 private:
-	const char* fFilePath;
+	BString fFilePath;
 };
 
 int main(int argc, char* argv[])